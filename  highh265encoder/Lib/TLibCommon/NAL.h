@@ -60,19 +60,32 @@ struct NALUnit
 };
 
 /**
- * A single NALunit, with complete payload in EBSP format.
+ * A single NALunit, with complete payload in RBSP format. It is converted to
+ * EBSP format when it is written to the output packet buffer
  */
 struct NALUnitEBSP : public NALUnit
 {
-    uint32_t m_packetSize;
-    uint8_t *m_nalUnitData;
+    uint32_t m_packetSize;    ///< size in EBSP format, including the header, once written
+    uint32_t m_rbspSize;
+    uint8_t *m_nalUnitData;   ///< rbsp_bytes, without the NAL unit header
 
     /**
-     * convert the OutputNALUnit #nalu# into EBSP format by writing out
-     * the NALUnit header, then the rbsp_bytes including any
-     * emulation_prevention_three_byte symbols.
+     * take the bitstream of the OutputNALUnit #nalu#, which is left empty
      */
-    void init(const struct OutputNALUnit& nalu);
+    void init(struct OutputNALUnit& nalu);
+
+    /**
+     * upper bound of the size of this NAL unit in EBSP format
+     */
+    uint32_t maxPacketSize() const;
+
+    /**
+     * write out the NALUnit header, then the rbsp_bytes including any
+     * emulation_prevention_three_byte symbols, returns the size written
+     */
+    uint32_t write(uint8_t *out) const;
+
+    void destroy();
 };
 }
 
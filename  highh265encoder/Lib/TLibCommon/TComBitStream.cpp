@@ -37,6 +37,7 @@
 
 #include "TComBitStream.h"
 #include "common.h"
+#include "primitives.h"
 
 using namespace x265;
 
@@ -149,6 +150,16 @@ void TComOutputBitstream::writeAlignZero()
     m_num_held_bits = 0;
 }
 
+uint8_t* TComOutputBitstream::detachFIFO()
+{
+    uint8_t *fifo = m_fifo;
+
+    m_fifo = X265_MALLOC(uint8_t, MIN_FIFO_SIZE);
+    m_buffsize = MIN_FIFO_SIZE;
+    clear();
+    return fifo;
+}
+
 /**
  * add substream to the end of the current bitstream
  */
@@ -177,20 +188,7 @@ void TComOutputBitstream::writeByteAlignment()
 
 int TComOutputBitstream::countStartCodeEmulations()
 {
-    int numStartCodes = 0;
-    uint8_t *rbsp = getFIFO();
-    uint32_t fsize = getByteStreamLength();
-
-    for (uint32_t i = 0; i + 2 < fsize; i++)
-    {
-        if (!rbsp[i] && !rbsp[i + 1] && rbsp[i + 2] <= 3)
-        {
-            numStartCodes++;
-            i++;
-        }
-    }
-
-    return numStartCodes;
+    return (int)primitives.nal_count_escapes(getFIFO(), getByteStreamLength());
 }
 
 void TComOutputBitstream::push_back(uint8_t val)
@@ -152,6 +152,12 @@ public:
     /** Return a reference to the internal fifo */
     uint8_t* getFIFO() const { return m_fifo; }
 
+    /**
+     * Return the byte-stream buffer, which the caller must free, and reset
+     * the bitstream with a new buffer
+     */
+    uint8_t* detachFIFO();
+
     void          addSubstream(TComOutputBitstream* pcSubstream);
     void writeByteAlignment();
 
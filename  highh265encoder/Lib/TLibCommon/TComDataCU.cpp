@@ -785,7 +785,7 @@ TComDataCU* TComDataCU::getPULeft(uint32_t& lPartUnitIdx, uint32_t curPartUnitId
     lPartUnitIdx = g_rasterToZscan[absPartIdx + numPartInCUSize - 1];
 
     if ((bEnforceSliceRestriction && (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL)) ||
-        (bEnforceTileRestriction && (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL)))
+        (bEnforceTileRestriction && (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL || isDiffTile(m_cuLeft))))
     {
         return NULL;
     }
@@ -820,14 +820,30 @@ TComDataCU* TComDataCU::getPUAbove(uint32_t& aPartUnitIdx, uint32_t  curPartUnit
 
     aPartUnitIdx = g_rasterToZscan[absPartIdx + m_pic->getNumPartInCU() - numPartInCUSize];
 
-    if ((bEnforceSliceRestriction && (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL)) ||
-        (bEnforceTileRestriction && (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL)))
+    if ((bEnforceSliceRestriction && (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL || isDiffSlice(m_cuAbove))) ||
+        (bEnforceTileRestriction && (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL || isDiffTile(m_cuAbove))))
     {
         return NULL;
     }
     return m_cuAbove;
 }
 
+/* Slices are made of whole CTU rows, so only the CTUs of the row above can
+ * belong to a different slice than this CU */
+bool TComDataCU::isDiffSlice(TComDataCU* cu)
+{
+    TComPicSym* picSym = m_pic->getPicSym();
+
+    return picSym->getCUSliceIdx(cu->getAddr()) != picSym->getCUSliceIdx(m_cuAddr);
+}
+
+bool TComDataCU::isDiffTile(TComDataCU* cu)
+{
+    TComPicSym* picSym = m_pic->getPicSym();
+
+    return picSym->getTileIdxMap(cu->getAddr()) != picSym->getTileIdxMap(m_cuAddr);
+}
+
 TComDataCU* TComDataCU::getPUAboveLeft(uint32_t& alPartUnitIdx, uint32_t curPartUnitIdx, bool bEnforceSliceRestriction)
 {
     uint32_t absPartIdx       = g_zscanToRaster[curPartUnitIdx];
@@ -850,7 +866,7 @@ TComDataCU* TComDataCU::getPUAboveLeft(uint32_t& alPartUnitIdx, uint32_t curPart
             }
         }
         alPartUnitIdx = g_rasterToZscan[absPartIdx + getPic()->getNumPartInCU() - numPartInCUSize - 1];
-        if ((bEnforceSliceRestriction && (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL)))
+        if ((bEnforceSliceRestriction && (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL || isDiffSlice(m_cuAbove) || isDiffTile(m_cuAbove))))
         {
             return NULL;
         }
@@ -860,8 +876,7 @@ TComDataCU* TComDataCU::getPUAboveLeft(uint32_t& alPartUnitIdx, uint32_t curPart
     if (!RasterAddress::isZeroRow(absPartIdx, numPartInCUSize))
     {
         alPartUnitIdx = g_rasterToZscan[absPartIdx - 1];
-        if ((bEnforceSliceRestriction && (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL))
-            )
+        if ((bEnforceSliceRestriction && (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL || isDiffTile(m_cuLeft))))
         {
             return NULL;
         }
@@ -869,7 +884,8 @@ TComDataCU* TComDataCU::getPUAboveLeft(uint32_t& alPartUnitIdx, uint32_t curPart
     }
 
     alPartUnitIdx = g_rasterToZscan[m_pic->getNumPartInCU() - 1];
-    if ((bEnforceSliceRestriction && (m_cuAboveLeft == NULL || m_cuAboveLeft->getSlice() == NULL)))
+    if ((bEnforceSliceRestriction && (m_cuAboveLeft == NULL || m_cuAboveLeft->getSlice() == NULL || isDiffSlice(m_cuAboveLeft) ||
+                                      isDiffTile(m_cuAboveLeft))))
     {
         return NULL;
     }
@@ -909,7 +925,7 @@ TComDataCU* TComDataCU::getPUAboveRight(uint32_t& arPartUnitIdx, uint32_t curPar
             return NULL;
         }
         arPartUnitIdx = g_rasterToZscan[absPartIdxRT + m_pic->getNumPartInCU() - numPartInCUSize + 1];
-        if ((bEnforceSliceRestriction && (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL)))
+        if ((bEnforceSliceRestriction && (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL || isDiffSlice(m_cuAbove) || isDiffTile(m_cuAbove))))
         {
             return NULL;
         }
@@ -924,7 +940,8 @@ TComDataCU* TComDataCU::getPUAboveRight(uint32_t& arPartUnitIdx, uint32_t curPar
 
     arPartUnitIdx = g_rasterToZscan[m_pic->getNumPartInCU() - numPartInCUSize];
     if ((bEnforceSliceRestriction && (m_cuAboveRight == NULL || m_cuAboveRight->getSlice() == NULL ||
-                                      (m_cuAboveRight->getAddr()) > getAddr())))
+                                      (m_cuAboveRight->getAddr()) > getAddr() || isDiffSlice(m_cuAboveRight) ||
+                                      isDiffTile(m_cuAboveRight))))
     {
         return NULL;
     }
@@ -964,7 +981,7 @@ TComDataCU* TComDataCU::getPUBelowLeft(uint32_t& blPartUnitIdx, uint32_t curPart
             return NULL;
         }
         blPartUnitIdx = g_rasterToZscan[absPartIdxLB + numPartInCUSize * 2 - 1];
-        if ((bEnforceSliceRestriction && (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL)))
+        if ((bEnforceSliceRestriction && (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL || isDiffTile(m_cuLeft))))
         {
             return NULL;
         }
@@ -1009,7 +1026,7 @@ TComDataCU* TComDataCU::getPUBelowLeftAdi(uint32_t& blPartUnitIdx,  uint32_t cur
             return NULL;
         }
         blPartUnitIdx = g_rasterToZscan[absPartIdxLB + (1 + partUnitOffset) * numPartInCUSize - 1];
-        if (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL)
+        if (m_cuLeft == NULL || m_cuLeft->getSlice() == NULL || isDiffTile(m_cuLeft))
         {
             return NULL;
         }
@@ -1054,7 +1071,7 @@ TComDataCU* TComDataCU::getPUAboveRightAdi(uint32_t& arPartUnitIdx, uint32_t cur
             return NULL;
         }
         arPartUnitIdx = g_rasterToZscan[absPartIdxRT + m_pic->getNumPartInCU() - numPartInCUSize + partUnitOffset];
-        if (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL)
+        if (m_cuAbove == NULL || m_cuAbove->getSlice() == NULL || isDiffSlice(m_cuAbove) || isDiffTile(m_cuAbove))
         {
             return NULL;
         }
@@ -1069,7 +1086,7 @@ TComDataCU* TComDataCU::getPUAboveRightAdi(uint32_t& arPartUnitIdx, uint32_t cur
 
     arPartUnitIdx = g_rasterToZscan[m_pic->getNumPartInCU() - numPartInCUSize + partUnitOffset - 1];
     if ((m_cuAboveRight == NULL || m_cuAboveRight->getSlice() == NULL ||
-         (m_cuAboveRight->getAddr()) > getAddr()))
+         (m_cuAboveRight->getAddr()) > getAddr() || isDiffSlice(m_cuAboveRight) || isDiffTile(m_cuAboveRight)))
     {
         return NULL;
     }
@@ -1167,10 +1184,17 @@ char TComDataCU::getLastCodedQP(uint32_t absPartIdx)
         {
             return getPic()->getCU(getAddr())->getLastCodedQP(getZorderIdxInCU());
         }
-        else if (getAddr() > 0 && !(getSlice()->getPPS()->getEntropyCodingSyncEnabledFlag() &&
-                                    getAddr() % getPic()->getFrameWidthInCU() == 0))
-        {
-            return getPic()->getCU(getAddr() - 1)->getLastCodedQP(getPic()->getNumPartInCU());
+        /* the previous CU in coding order, unless this CU starts a slice, a tile
+         * or, with WPP, a CU row of a tile */
+        TComPicSym* picSym = getPic()->getPicSym();
+        uint32_t col = getAddr() % getPic()->getFrameWidthInCU();
+        bool bTileRowStart = col == picSym->getTileColBase(picSym->getColTileIdx(col));
+        uint32_t prevAddr = getAddr() ? picSym->getCUOrderMap(picSym->getInverseCUOrderMap(getAddr()) - 1) : 0;
+        if (getAddr() > 0 && picSym->getTileIdxMap(prevAddr) == picSym->getTileIdxMap(getAddr()) &&
+            !(getSlice()->getPPS()->getEntropyCodingSyncEnabledFlag() && bTileRowStart) &&
+            getAddr() != picSym->getSliceStartCUAddr(picSym->getCUSliceIdx(getAddr())))
+        {
+            return getPic()->getCU(prevAddr)->getLastCodedQP(getPic()->getNumPartInCU());
         }
         else
         {
@@ -386,6 +386,10 @@ public:
 
     TComDataCU*   getCUAboveRight() { return m_cuAboveRight; }
 
+    bool          isDiffSlice(TComDataCU* cu);
+
+    bool          isDiffTile(TComDataCU* cu);
+
     TComDataCU*   getPULeft(uint32_t& lPartUnitIdx,
                             uint32_t  curPartUnitIdx,
                             bool      bEnforceSliceRestriction = true,
@@ -66,6 +66,8 @@ TComPic::TComPic()
     , m_cuCostsForVbv(NULL)
     , m_intraCuCostsForVbv(NULL)
 {
+    m_reconColCount = NULL;
+    m_releasePlanes = NULL;
     m_reconRowCount.set(0);
     m_countRefEncoders = 0;
     memset(&m_lowres, 0, sizeof(m_lowres));
@@ -76,6 +78,7 @@ TComPic::TComPic()
     m_SSDV = 0;
     m_ssim = 0;
     m_ssimCnt = 0;
+    m_bMetricsSampled = false;
     m_frameTime = 0.0;
     m_elapsedCompressTime = 0.0;
     m_qpaAq = 0;
@@ -103,11 +106,21 @@ bool TComPic::create(Encoder* cfg)
         return false;
 
     bool ok = true;
-    ok &= m_picSym->create(cfg->param->sourceWidth, cfg->param->sourceHeight, cfg->param->internalCsp, g_maxCUSize, g_maxCUDepth);
+    ok &= m_picSym->create(cfg->param->sourceWidth, cfg->param->sourceHeight, cfg->param->internalCsp, g_maxCUSize, g_maxCUDepth, cfg->param->maxSlices,
+                           cfg->param->tileColumns, cfg->m_tileColumnWidth, cfg->param->tileRows, cfg->m_tileRowHeight);
     ok &= m_origPicYuv->create(cfg->param->sourceWidth, cfg->param->sourceHeight, cfg->param->internalCsp, g_maxCUSize, g_maxCUDepth);
     ok &= m_reconPicYuv->create(cfg->param->sourceWidth, cfg->param->sourceHeight, cfg->param->internalCsp, g_maxCUSize,g_maxCUDepth);
+    if (ok && cfg->param->bEnableHpelCache)
+        ok &= m_reconPicYuv->createHpelPlanes();
+
+    /* the exhaustive search bounds SADs with the summed area table, which is
+     * accumulated a CTU row at a time and thus not ready for CTU ref sync */
+    if (ok && cfg->param->searchMethod == X265_FULL_SEARCH && !(cfg->param->bEnableCtuRefSync && cfg->param->frameNumThreads > 1))
+        ok &= m_reconPicYuv->createIntegralPlane();
     ok &= m_lowres.create(m_origPicYuv, cfg->param->bframes, !!cfg->param->rc.aqMode);
 
+    m_reconColCount = new ThreadSafeInteger[m_picSym->getFrameHeightInCU()];
+
     bool isVbv = cfg->param->rc.vbvBufferSize > 0 && cfg->param->rc.vbvMaxBitrate > 0;
     if (ok && (isVbv || cfg->param->rc.aqMode))
     {
@@ -160,6 +173,34 @@ void TComPic::reInit(Encoder* cfg)
         memset(m_qpaAq, 0,  m_picSym->getFrameHeightInCU() * sizeof(double));
 }
 
+void TComPic::resetReconProgress()
+{
+    m_reconRowCount.set(0);
+    for (uint32_t row = 0; row < m_picSym->getFrameHeightInCU(); row++)
+    {
+        m_reconColCount[row].set(0);
+    }
+}
+
+void TComPic::moveToNode(int node)
+{
+    m_origPicYuv->moveToNode(node);
+    m_reconPicYuv->moveToNode(node);
+}
+
+void TComPic::releaseOrigPlanes()
+{
+    if (m_origPicYuv && m_origPicYuv->m_extBuf)
+    {
+        pixel *buf = m_origPicYuv->detachPlanes();
+
+        if (m_releasePlanes)
+            m_releasePlanes(buf, m_userData);
+        else
+            x265_free(buf);
+    }
+}
+
 void TComPic::destroy()
 {
     if (m_picSym)
@@ -171,6 +212,7 @@ void TComPic::destroy()
 
     if (m_origPicYuv)
     {
+        releaseOrigPlanes();
         m_origPicYuv->destroy();
         delete m_origPicYuv;
         m_origPicYuv = NULL;
@@ -184,6 +226,9 @@ void TComPic::destroy()
     }
     m_lowres.destroy();
 
+    delete[] m_reconColCount;
+    m_reconColCount = NULL;
+
     X265_FREE(m_rowDiagQp);
     X265_FREE(m_rowDiagQScale);
     X265_FREE(m_rowDiagSatd);
@@ -78,8 +78,10 @@ public:
 
     //** Frame Parallelism - notification between FrameEncoders of available motion reference rows **
     ThreadSafeInteger     m_reconRowCount;      // count of CTU rows completely reconstructed and extended for motion reference
+    ThreadSafeInteger*    m_reconColCount;      // per CTU row, count of CTUs reconstructed, filtered and extended for motion reference
     volatile uint32_t     m_countRefEncoders;   // count of FrameEncoder threads monitoring m_reconRowCount
     void*                 m_userData;           // user provided pointer passed in with this picture
+    void                  (*m_releasePlanes)(void*, void*); // user callback releasing a zero-copy input buffer
 
     int64_t               m_pts;                // user provided presentation time stamp
     int64_t               m_reorderedPts;
@@ -95,6 +97,7 @@ public:
     uint64_t              m_SSDV;
     double                m_ssim;
     int                   m_ssimCnt;
+    bool                  m_bMetricsSampled;    // PSNR and SSIM are measured for this picture
 
     double                m_elapsedCompressTime; // elapsed time spent in worker threads
     double                m_frameTime;           // wall time from frame start to finish
@@ -124,6 +127,15 @@ public:
     virtual void  destroy();
     void          reInit(Encoder* cfg);
 
+    // reset the motion reference progress counters before the picture is reused
+    void          resetReconProgress();
+
+    // migrate the source and recon pictures to the given NUMA node
+    void          moveToNode(int node);
+
+    // hand a zero-copy input buffer back to the user, if one is attached
+    void          releaseOrigPlanes();
+
     bool          getUsedByCurr()           { return m_bUsedByCurr; }
 
     void          setUsedByCurr(bool bUsed) { m_bUsedByCurr = bUsed; }
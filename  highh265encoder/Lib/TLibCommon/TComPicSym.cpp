@@ -59,9 +59,21 @@ TComPicSym::TComPicSym()
     , m_numCUsInFrame(0)
     , m_slice(NULL)
     , m_cuData(NULL)
+    , m_numSlices(1)
+    , m_sliceBaseRow(NULL)
+    , m_rowSliceIdx(NULL)
+    , m_numTileCols(1)
+    , m_numTileRows(1)
+    , m_tileColBase(NULL)
+    , m_tileRowBase(NULL)
+    , m_colTileIdx(NULL)
+    , m_rowTileIdx(NULL)
+    , m_cuOrderMap(NULL)
+    , m_inverseCUOrderMap(NULL)
 {}
 
-bool TComPicSym::create(int picWidth, int picHeight, int picCsp, uint32_t maxCUSize, uint32_t maxDepth)
+bool TComPicSym::create(int picWidth, int picHeight, int picCsp, uint32_t maxCUSize, uint32_t maxDepth, int numSlices,
+                        int numTileCols, const uint32_t* tileColWidth, int numTileRows, const uint32_t* tileRowHeight)
 {
     uint32_t i;
 
@@ -86,6 +98,71 @@ bool TComPicSym::create(int picWidth, int picHeight, int picCsp, uint32_t maxCUS
     if (!m_slice || !m_cuData)
         return false;
 
+    m_numTileCols = numTileCols;
+    m_numTileRows = numTileRows;
+    m_tileColBase = new uint32_t[m_numTileCols + 1];
+    m_tileRowBase = new uint32_t[m_numTileRows + 1];
+    m_colTileIdx = new uint32_t[m_widthInCU];
+    m_rowTileIdx = new uint32_t[m_heightInCU];
+    m_tileColBase[0] = m_tileRowBase[0] = 0;
+    for (int tileCol = 0; tileCol < m_numTileCols; tileCol++)
+    {
+        m_tileColBase[tileCol + 1] = m_tileColBase[tileCol] + tileColWidth[tileCol];
+        for (uint32_t col = m_tileColBase[tileCol]; col < m_tileColBase[tileCol + 1]; col++)
+        {
+            m_colTileIdx[col] = tileCol;
+        }
+    }
+
+    for (int tileRow = 0; tileRow < m_numTileRows; tileRow++)
+    {
+        m_tileRowBase[tileRow + 1] = m_tileRowBase[tileRow] + tileRowHeight[tileRow];
+        for (uint32_t row = m_tileRowBase[tileRow]; row < m_tileRowBase[tileRow + 1]; row++)
+        {
+            m_rowTileIdx[row] = tileRow;
+        }
+    }
+
+    /* CUs are coded tile by tile, in raster order within each tile */
+    m_cuOrderMap = new uint32_t[m_numCUsInFrame];
+    m_inverseCUOrderMap = new uint32_t[m_numCUsInFrame];
+    uint32_t tileScanAddr = 0;
+    for (int tileRow = 0; tileRow < m_numTileRows; tileRow++)
+    {
+        for (int tileCol = 0; tileCol < m_numTileCols; tileCol++)
+        {
+            for (uint32_t row = m_tileRowBase[tileRow]; row < m_tileRowBase[tileRow + 1]; row++)
+            {
+                for (uint32_t col = m_tileColBase[tileCol]; col < m_tileColBase[tileCol + 1]; col++)
+                {
+                    m_cuOrderMap[tileScanAddr] = row * m_widthInCU + col;
+                    m_inverseCUOrderMap[row * m_widthInCU + col] = tileScanAddr;
+                    tileScanAddr++;
+                }
+            }
+        }
+    }
+
+    /* split the CTU rows as evenly as possible between the slices. With tiles
+     * each slice is made of whole tile rows */
+    int numRowUnits = hasTiles() ? m_numTileRows : (int)m_heightInCU;
+    m_numSlices = Clip3(1, numRowUnits, numSlices);
+    m_sliceBaseRow = new uint32_t[m_numSlices + 1];
+    m_rowSliceIdx = new uint32_t[m_heightInCU];
+    for (int s = 0; s <= m_numSlices; s++)
+    {
+        uint32_t unit = (uint32_t)(((uint64_t)s * numRowUnits) / m_numSlices);
+        m_sliceBaseRow[s] = hasTiles() ? m_tileRowBase[unit] : unit;
+    }
+
+    for (int s = 0; s < m_numSlices; s++)
+    {
+        for (uint32_t row = m_sliceBaseRow[s]; row < m_sliceBaseRow[s + 1]; row++)
+        {
+            m_rowSliceIdx[row] = s;
+        }
+    }
+
     for (i = 0; i < m_numCUsInFrame; i++)
     {
         m_cuData[i] = new TComDataCU;
@@ -112,6 +189,23 @@ void TComPicSym::destroy()
     delete [] m_cuData;
     m_cuData = NULL;
 
+    delete [] m_sliceBaseRow;
+    m_sliceBaseRow = NULL;
+    delete [] m_rowSliceIdx;
+    m_rowSliceIdx = NULL;
+    delete [] m_tileColBase;
+    m_tileColBase = NULL;
+    delete [] m_tileRowBase;
+    m_tileRowBase = NULL;
+    delete [] m_colTileIdx;
+    m_colTileIdx = NULL;
+    delete [] m_rowTileIdx;
+    m_rowTileIdx = NULL;
+    delete [] m_cuOrderMap;
+    m_cuOrderMap = NULL;
+    delete [] m_inverseCUOrderMap;
+    m_inverseCUOrderMap = NULL;
+
     if (m_saoParam)
     {
         TComSampleAdaptiveOffset::freeSaoParam(m_saoParam);
@@ -120,6 +214,35 @@ void TComPicSym::destroy()
     }
 }
 
+/* Substreams are numbered by the CTU row and tile column of their first CU. With
+ * WPP each CTU row of a tile is a substream, otherwise a substream covers all the
+ * CTU rows of a tile within a slice */
+uint32_t TComPicSym::getSubstreamIdx(uint32_t cuAddr, bool bWaveFrontsynchro) const
+{
+    uint32_t row = cuAddr / m_widthInCU;
+
+    if (!bWaveFrontsynchro)
+        row = X265_MAX(m_sliceBaseRow[m_rowSliceIdx[row]], m_tileRowBase[m_rowTileIdx[row]]);
+    return row * m_numTileCols + m_colTileIdx[cuAddr % m_widthInCU];
+}
+
+/* Lists the substreams of a slice in coding order, returns their count */
+int TComPicSym::getSliceSubstreams(int sliceIdx, bool bWaveFrontsynchro, uint32_t* substreams) const
+{
+    uint32_t startAddr = m_inverseCUOrderMap[getSliceStartCUAddr(sliceIdx)];
+    uint32_t endAddr = startAddr + (m_sliceBaseRow[sliceIdx + 1] - m_sliceBaseRow[sliceIdx]) * m_widthInCU;
+    int count = 0;
+
+    for (uint32_t tileScanAddr = startAddr; tileScanAddr < endAddr; tileScanAddr++)
+    {
+        uint32_t substream = getSubstreamIdx(m_cuOrderMap[tileScanAddr], bWaveFrontsynchro);
+        if (!count || substreams[count - 1] != substream)
+            substreams[count++] = substream;
+    }
+
+    return count;
+}
+
 void TComPicSym::allocSaoParam(TComSampleAdaptiveOffset *sao)
 {
     m_saoParam = new SAOParam;
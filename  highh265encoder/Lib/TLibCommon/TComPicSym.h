@@ -76,11 +76,29 @@ private:
     TComSlice*    m_slice;
     TComDataCU**  m_cuData;
 
+    /* slices are whole CTU rows, slice i covers rows [m_sliceBaseRow[i], m_sliceBaseRow[i + 1]) */
+    int           m_numSlices;
+    uint32_t*     m_sliceBaseRow;
+    uint32_t*     m_rowSliceIdx;
+
+    /* tile column i covers CTU columns [m_tileColBase[i], m_tileColBase[i + 1]), tile row j
+     * covers CTU rows [m_tileRowBase[j], m_tileRowBase[j + 1]). Tiles are numbered in raster
+     * order. The CU order maps convert between tile scan and raster scan CU addresses */
+    int           m_numTileCols;
+    int           m_numTileRows;
+    uint32_t*     m_tileColBase;
+    uint32_t*     m_tileRowBase;
+    uint32_t*     m_colTileIdx;
+    uint32_t*     m_rowTileIdx;
+    uint32_t*     m_cuOrderMap;
+    uint32_t*     m_inverseCUOrderMap;
+
     SAOParam*     m_saoParam;
 
 public:
 
-    bool        create(int picWidth, int picHeight, int picCsp, uint32_t maxCUSize, uint32_t maxDepth);
+    bool        create(int picWidth, int picHeight, int picCsp, uint32_t maxCUSize, uint32_t maxDepth, int numSlices,
+                       int numTileCols, const uint32_t* tileColWidth, int numTileRows, const uint32_t* tileRowHeight);
     void        destroy();
 
     TComPicSym();
@@ -103,6 +121,44 @@ public:
 
     uint32_t    getNumPartInCUSize() const { return m_numPartInCUSize; }
 
+    int         getNumSlices() const      { return m_numSlices; }
+
+    uint32_t    getSliceBaseRow(int sliceIdx) const { return m_sliceBaseRow[sliceIdx]; }
+
+    uint32_t    getSliceStartCUAddr(int sliceIdx) const { return m_sliceBaseRow[sliceIdx] * m_widthInCU; }
+
+    int         getRowSliceIdx(uint32_t row) const { return m_rowSliceIdx[row]; }
+
+    int         getCUSliceIdx(uint32_t cuAddr) const { return m_rowSliceIdx[cuAddr / m_widthInCU]; }
+
+    bool        isSliceStartRow(uint32_t row) const { return m_sliceBaseRow[m_rowSliceIdx[row]] == row; }
+
+    int         getNumTileCols() const    { return m_numTileCols; }
+
+    int         getNumTileRows() const    { return m_numTileRows; }
+
+    bool        hasTiles() const          { return m_numTileCols * m_numTileRows > 1; }
+
+    uint32_t    getTileColBase(int tileCol) const { return m_tileColBase[tileCol]; }
+
+    uint32_t    getTileRowBase(int tileRow) const { return m_tileRowBase[tileRow]; }
+
+    int         getColTileIdx(uint32_t col) const { return m_colTileIdx[col]; }
+
+    int         getRowTileIdx(uint32_t row) const { return m_rowTileIdx[row]; }
+
+    int         getTileIdxMap(uint32_t cuAddr) const { return m_rowTileIdx[cuAddr / m_widthInCU] * m_numTileCols + m_colTileIdx[cuAddr % m_widthInCU]; }
+
+    bool        isTileRowStart(uint32_t row) const { return m_tileRowBase[m_rowTileIdx[row]] == row; }
+
+    uint32_t    getCUOrderMap(uint32_t tileScanAddr) const { return m_cuOrderMap[tileScanAddr]; }
+
+    uint32_t    getInverseCUOrderMap(uint32_t cuAddr) const { return m_inverseCUOrderMap[cuAddr]; }
+
+    uint32_t    getSubstreamIdx(uint32_t cuAddr, bool bWaveFrontsynchro) const;
+
+    int         getSliceSubstreams(int sliceIdx, bool bWaveFrontsynchro, uint32_t* substreams) const;
+
     void allocSaoParam(TComSampleAdaptiveOffset *sao);
 
     SAOParam *getSaoParam()               { return m_saoParam; }
@@ -54,6 +54,20 @@ TComPicYuv::TComPicYuv()
     m_picOrgU = NULL;
     m_picOrgV = NULL;
 
+    m_ownBufY = NULL;
+    m_ownBufU = NULL;
+    m_ownBufV = NULL;
+    m_extBuf = NULL;
+
+    for (int i = 0; i < 3; i++)
+    {
+        m_hpelBuf[i] = NULL;
+        m_hpelOrg[i] = NULL;
+    }
+
+    m_integralBuf = NULL;
+    m_integralOrg = NULL;
+
     m_cuOffsetY = NULL;
     m_cuOffsetC = NULL;
     m_buOffsetY = NULL;
@@ -64,7 +78,7 @@ TComPicYuv::~TComPicYuv()
 {
 }
 
-bool TComPicYuv::create(int picWidth, int picHeight, int picCsp, uint32_t maxCUSize, uint32_t maxCUDepth)
+void TComPicYuv::initLayout(int picWidth, int picHeight, int picCsp, uint32_t maxCUSize)
 {
     m_picWidth  = picWidth;
     m_picHeight = picHeight;
@@ -86,15 +100,17 @@ bool TComPicYuv::create(int picWidth, int picHeight, int picCsp, uint32_t maxCUS
     m_chromaMarginY = m_lumaMarginY >> m_vChromaShift;
 
     m_strideC = ((m_numCuInWidth * g_maxCUSize) >> m_hChromaShift) + (m_chromaMarginX * 2);
-    int maxHeight = m_numCuInHeight * g_maxCUSize;
+}
 
-    CHECKED_MALLOC(m_picBufY, pixel, m_stride * (maxHeight + (m_lumaMarginY * 2)));
-    CHECKED_MALLOC(m_picBufU, pixel, m_strideC * ((maxHeight >> m_vChromaShift) + (m_chromaMarginY * 2)));
-    CHECKED_MALLOC(m_picBufV, pixel, m_strideC * ((maxHeight >> m_vChromaShift) + (m_chromaMarginY * 2)));
+bool TComPicYuv::create(int picWidth, int picHeight, int picCsp, uint32_t maxCUSize, uint32_t maxCUDepth)
+{
+    initLayout(picWidth, picHeight, picCsp, maxCUSize);
 
-    m_picOrgY = m_picBufY + m_lumaMarginY   * getStride()  + m_lumaMarginX;
-    m_picOrgU = m_picBufU + m_chromaMarginY * getCStride() + m_chromaMarginX;
-    m_picOrgV = m_picBufV + m_chromaMarginY * getCStride() + m_chromaMarginX;
+    CHECKED_MALLOC(m_picBufY, pixel, getLumaBufSize());
+    CHECKED_MALLOC(m_picBufU, pixel, getChromaBufSize());
+    CHECKED_MALLOC(m_picBufV, pixel, getChromaBufSize());
+
+    setPlaneOrigins();
 
     /* TODO: these four buffers are the same for every TComPicYuv in the encoder */
     CHECKED_MALLOC(m_cuOffsetY, int, m_numCuInWidth * m_numCuInHeight);
@@ -127,15 +143,134 @@ fail:
 
 void TComPicYuv::destroy()
 {
+    // an attached caller buffer is released by the owning TComPic
+    if (m_extBuf)
+        detachPlanes();
+
     X265_FREE(m_picBufY);
     X265_FREE(m_picBufU);
     X265_FREE(m_picBufV);
+    for (int i = 0; i < 3; i++)
+        X265_FREE(m_hpelBuf[i]);
+    X265_FREE(m_integralBuf);
     X265_FREE(m_cuOffsetY);
     X265_FREE(m_cuOffsetC);
     X265_FREE(m_buOffsetY);
     X265_FREE(m_buOffsetC);
 }
 
+void TComPicYuv::moveToNode(int node)
+{
+    x265_move_to_node(m_picBufY, sizeof(pixel) * getLumaBufSize(), node);
+    x265_move_to_node(m_picBufU, sizeof(pixel) * getChromaBufSize(), node);
+    x265_move_to_node(m_picBufV, sizeof(pixel) * getChromaBufSize(), node);
+    for (int i = 0; i < 3 && m_hpelBuf[0]; i++)
+        x265_move_to_node(m_hpelBuf[i], sizeof(pixel) * getLumaBufSize(), node);
+    if (m_integralBuf)
+        x265_move_to_node(m_integralBuf, sizeof(uint32_t) * getLumaBufSize(), node);
+}
+
+bool TComPicYuv::createHpelPlanes()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        CHECKED_MALLOC(m_hpelBuf[i], pixel, getLumaBufSize());
+        m_hpelOrg[i] = m_hpelBuf[i] + m_lumaMarginY * getStride() + m_lumaMarginX;
+    }
+
+    return true;
+
+fail:
+    return false;
+}
+
+bool TComPicYuv::createIntegralPlane()
+{
+    CHECKED_MALLOC(m_integralBuf, uint32_t, getLumaBufSize());
+    m_integralOrg = m_integralBuf + m_lumaMarginY * getStride() + m_lumaMarginX;
+
+    /* the first row, the sums above the plane, is never written */
+    memset(m_integralBuf, 0, getStride() * sizeof(uint32_t));
+
+    return true;
+
+fail:
+    return false;
+}
+
+void TComPicYuv::setPlaneOrigins()
+{
+    m_picOrgY = m_picBufY + m_lumaMarginY   * getStride()  + m_lumaMarginX;
+    m_picOrgU = m_picBufU + m_chromaMarginY * getCStride() + m_chromaMarginX;
+    m_picOrgV = m_picBufV + m_chromaMarginY * getCStride() + m_chromaMarginX;
+}
+
+/* Zero-copy input buffers hold the three plane buffers, each with the same
+ * margins and stride as the internal planes, one after the other. The plane
+ * offsets are rounded up to keep the alignment of the allocation */
+size_t TComPicYuv::getLumaBufSize() const
+{
+    int maxHeight = m_numCuInHeight * g_maxCUSize;
+
+    return (size_t)m_stride * (maxHeight + (m_lumaMarginY * 2));
+}
+
+size_t TComPicYuv::getChromaBufSize() const
+{
+    int maxHeight = m_numCuInHeight * g_maxCUSize;
+
+    return (size_t)m_strideC * ((maxHeight >> m_vChromaShift) + (m_chromaMarginY * 2));
+}
+
+static size_t alignPlaneSize(size_t size)
+{
+    return (size + 31) & ~(size_t)31;
+}
+
+size_t TComPicYuv::getPlanesBufSize() const
+{
+    return alignPlaneSize(getLumaBufSize()) + 2 * alignPlaneSize(getChromaBufSize());
+}
+
+pixel* TComPicYuv::getPlanesBufOrigin(pixel *buf, int plane) const
+{
+    size_t offsetU = alignPlaneSize(getLumaBufSize());
+    size_t offsetV = offsetU + alignPlaneSize(getChromaBufSize());
+
+    if (plane == 0)
+        return buf + m_lumaMarginY * m_stride + m_lumaMarginX;
+    else
+        return buf + (plane == 1 ? offsetU : offsetV) + m_chromaMarginY * m_strideC + m_chromaMarginX;
+}
+
+void TComPicYuv::attachPlanes(pixel *buf)
+{
+    assert(!m_extBuf);
+
+    m_ownBufY = m_picBufY;
+    m_ownBufU = m_picBufU;
+    m_ownBufV = m_picBufV;
+    m_extBuf = buf;
+
+    m_picBufY = buf;
+    m_picBufU = buf + alignPlaneSize(getLumaBufSize());
+    m_picBufV = m_picBufU + alignPlaneSize(getChromaBufSize());
+    setPlaneOrigins();
+}
+
+pixel* TComPicYuv::detachPlanes()
+{
+    pixel *buf = m_extBuf;
+
+    m_picBufY = m_ownBufY;
+    m_picBufU = m_ownBufU;
+    m_picBufV = m_ownBufV;
+    m_extBuf = NULL;
+    setPlaneOrigins();
+
+    return buf;
+}
+
 uint32_t TComPicYuv::getCUHeight(int rowNum)
 {
     uint32_t height;
@@ -147,37 +282,43 @@ uint32_t TComPicYuv::getCUHeight(int rowNum)
     return height;
 }
 
+namespace {
+/* Split the interleaved u+v plane of a semi-planar input picture, shifting
+ * and masking samples to the internal depth */
+template<typename T>
+void deinterleaveChroma(pixel *dstu, pixel *dstv, intptr_t dstStride, const T *src, intptr_t srcStride,
+                        int width, int height, int lShift, int rShift, int mask)
+{
+    for (int r = 0; r < height; r++, dstu += dstStride, dstv += dstStride, src += srcStride)
+    {
+        for (int c = 0; c < width; c++)
+        {
+            dstu[c] = (pixel)(((src[2 * c] << lShift) >> rShift) & mask);
+            dstv[c] = (pixel)(((src[2 * c + 1] << lShift) >> rShift) & mask);
+        }
+    }
+}
+}
+
 /* Copy pixels from an x265_picture into internal TComPicYuv instance.
- * Shift pixels as necessary, mask off bits above X265_DEPTH for safety. */
+ * Shift pixels as necessary, mask off bits above X265_DEPTH for safety.
+ * Semi-planar (NV12, NV16) chroma is deinterleaved and 8bit packed RGB is
+ * converted to the internal color space as it is copied */
 void TComPicYuv::copyFromPicture(const x265_picture& pic, int32_t *pad)
 {
-    /* m_picWidth is the width that is being encoded, padx indicates how many
-     * of those pixels are padding to reach multiple of MinCU(4) size.
-     *
-     * Internally, we need to extend rows out to a multiple of 16 for lowres
-     * downscale and other operations. But those padding pixels are never
-     * encoded.
-     *
-     * The same applies to m_picHeight and pady */
-
-    int padx = pad[0];
-    int pady = pad[1];
-
     /* width and height - without padsize (input picture raw width and height) */
-    int width = m_picWidth - padx;
-    int height = m_picHeight - pady;
+    int width = m_picWidth - pad[0];
+    int height = m_picHeight - pad[1];
 
-    /* internal pad to multiple of 16x16 blocks */
-    uint8_t rem = width & 15;
-
-    padx = rem ? 16 - rem : padx;
-    rem = height & 15;
-    pady = rem ? 16 - rem : pady;
+    if (pic.colorSpace >= X265_CSP_BGR)
+    {
+        primitives.rgb2yuv[pic.colorSpace - X265_CSP_BGR][m_picCsp](getLumaAddr(), getStride(), getCbAddr(), getCrAddr(), getCStride(),
+                                                                     (uint8_t*)pic.planes[0], pic.stride[0], width, height);
+        padPicture(pad);
+        return;
+    }
 
-    /* add one more row and col of pad for downscale interpolation, fixes
-     * warnings from valgrind about using uninitialized pixels */
-    padx++;
-    pady++;
+    bool bSemiPlanar = pic.colorSpace == X265_CSP_NV12 || pic.colorSpace == X265_CSP_NV16;
 
     if (pic.bitDepth < X265_DEPTH)
     {
@@ -191,8 +332,14 @@ void TComPicYuv::copyFromPicture(const x265_picture& pic, int32_t *pad)
         int shift = X265_MAX(0, X265_DEPTH - pic.bitDepth);
 
         primitives.planecopy_cp(yChar, pic.stride[0] / sizeof(*yChar), yPixel, getStride(), width, height, shift);
-        primitives.planecopy_cp(uChar, pic.stride[1] / sizeof(*uChar), uPixel, getCStride(), width >> m_hChromaShift, height >> m_vChromaShift, shift);
-        primitives.planecopy_cp(vChar, pic.stride[2] / sizeof(*vChar), vPixel, getCStride(), width >> m_hChromaShift, height >> m_vChromaShift, shift);
+        if (bSemiPlanar)
+            deinterleaveChroma(uPixel, vPixel, getCStride(), uChar, pic.stride[1] / sizeof(*uChar),
+                               width >> m_hChromaShift, height >> m_vChromaShift, shift, 0, (1 << X265_DEPTH) - 1);
+        else
+        {
+            primitives.planecopy_cp(uChar, pic.stride[1] / sizeof(*uChar), uPixel, getCStride(), width >> m_hChromaShift, height >> m_vChromaShift, shift);
+            primitives.planecopy_cp(vChar, pic.stride[2] / sizeof(*vChar), vPixel, getCStride(), width >> m_hChromaShift, height >> m_vChromaShift, shift);
+        }
     }
     else if (pic.bitDepth == 8)
     {
@@ -206,27 +353,50 @@ void TComPicYuv::copyFromPicture(const x265_picture& pic, int32_t *pad)
 
         for (int r = 0; r < height; r++)
         {
+#if HIGH_BIT_DEPTH
             for (int c = 0; c < width; c++)
             {
                 yPixel[c] = (pixel)yChar[c];
             }
 
+#else
+            memcpy(yPixel, yChar, width);
+#endif
             yPixel += getStride();
             yChar += pic.stride[0] / sizeof(*yChar);
         }
 
-        for (int r = 0; r < height >> m_vChromaShift; r++)
+        if (bSemiPlanar)
         {
-            for (int c = 0; c < width >> m_hChromaShift; c++)
+#if HIGH_BIT_DEPTH
+            deinterleaveChroma(uPixel, vPixel, getCStride(), uChar, pic.stride[1] / sizeof(*uChar),
+                               width >> m_hChromaShift, height >> m_vChromaShift, 0, 0, 0xff);
+#else
+            primitives.plane_copy_deinterleave_c(uPixel, getCStride(), vPixel, getCStride(), (pixel*)uChar, pic.stride[1] / sizeof(*uChar),
+                                                 width >> m_hChromaShift, height >> m_vChromaShift);
+#endif
+        }
+        else
+        {
+            for (int r = 0; r < height >> m_vChromaShift; r++)
             {
-                uPixel[c] = (pixel)uChar[c];
-                vPixel[c] = (pixel)vChar[c];
+#if HIGH_BIT_DEPTH
+                for (int c = 0; c < width >> m_hChromaShift; c++)
+                {
+                    uPixel[c] = (pixel)uChar[c];
+                    vPixel[c] = (pixel)vChar[c];
+                }
+
+#else
+                memcpy(uPixel, uChar, width >> m_hChromaShift);
+                memcpy(vPixel, vChar, width >> m_hChromaShift);
+#endif
+
+                uPixel += getCStride();
+                vPixel += getCStride();
+                uChar += pic.stride[1] / sizeof(*uChar);
+                vChar += pic.stride[2] / sizeof(*vChar);
             }
-
-            uPixel += getCStride();
-            vPixel += getCStride();
-            uChar += pic.stride[1] / sizeof(*uChar);
-            vChar += pic.stride[2] / sizeof(*vChar);
         }
     }
     else /* pic.bitDepth > 8 */
@@ -246,10 +416,51 @@ void TComPicYuv::copyFromPicture(const x265_picture& pic, int32_t *pad)
         /* shift and mask pixels to final size */
 
         primitives.planecopy_sp(yShort, pic.stride[0] / sizeof(*yShort), yPixel, getStride(), width, height, shift, mask);
-        primitives.planecopy_sp(uShort, pic.stride[1] / sizeof(*uShort), uPixel, getCStride(), width >> m_hChromaShift, height >> m_vChromaShift, shift, mask);
-        primitives.planecopy_sp(vShort, pic.stride[2] / sizeof(*vShort), vPixel, getCStride(), width >> m_hChromaShift, height >> m_vChromaShift, shift, mask);
+        if (bSemiPlanar)
+            deinterleaveChroma(uPixel, vPixel, getCStride(), uShort, pic.stride[1] / sizeof(*uShort),
+                               width >> m_hChromaShift, height >> m_vChromaShift, 0, shift, mask);
+        else
+        {
+            primitives.planecopy_sp(uShort, pic.stride[1] / sizeof(*uShort), uPixel, getCStride(), width >> m_hChromaShift, height >> m_vChromaShift, shift, mask);
+            primitives.planecopy_sp(vShort, pic.stride[2] / sizeof(*vShort), vPixel, getCStride(), width >> m_hChromaShift, height >> m_vChromaShift, shift, mask);
+        }
     }
 
+    padPicture(pad);
+}
+
+/* Extend the input picture into the pad area in place, this is all that is
+ * required of zero-copy input pictures */
+void TComPicYuv::padPicture(int32_t *pad)
+{
+    /* m_picWidth is the width that is being encoded, padx indicates how many
+     * of those pixels are padding to reach multiple of MinCU(4) size.
+     *
+     * Internally, we need to extend rows out to a multiple of 16 for lowres
+     * downscale and other operations. But those padding pixels are never
+     * encoded.
+     *
+     * The same applies to m_picHeight and pady */
+
+    int padx = pad[0];
+    int pady = pad[1];
+
+    /* width and height - without padsize (input picture raw width and height) */
+    int width = m_picWidth - padx;
+    int height = m_picHeight - pady;
+
+    /* internal pad to multiple of 16x16 blocks */
+    uint8_t rem = width & 15;
+
+    padx = rem ? 16 - rem : padx;
+    rem = height & 15;
+    pady = rem ? 16 - rem : pady;
+
+    /* add one more row and col of pad for downscale interpolation, fixes
+     * warnings from valgrind about using uninitialized pixels */
+    padx++;
+    pady++;
+
     /* extend the right edge if width was not multiple of the minimum CU size */
     if (padx)
     {
@@ -72,6 +72,17 @@ public:
     pixel*  m_picOrgU;
     pixel*  m_picOrgV;
 
+    pixel*  m_ownBufY;          ///< internal plane buffers, while a zero-copy input buffer is attached
+    pixel*  m_ownBufU;
+    pixel*  m_ownBufV;
+    pixel*  m_extBuf;           ///< attached zero-copy input buffer, or NULL
+
+    pixel*  m_hpelBuf[3];       ///< half-pel interpolated luma planes (H, V, HV) including margin, or NULL
+    pixel*  m_hpelOrg[3];
+
+    uint32_t* m_integralBuf;    ///< summed area table of the luma plane including margin, or NULL
+    uint32_t* m_integralOrg;
+
     // ------------------------------------------------------------------------------------------------
     //  Parameter for general YUV buffer usage
     // ------------------------------------------------------------------------------------------------
@@ -107,6 +118,18 @@ public:
     bool  create(int picWidth, int picHeight, int csp, uint32_t maxCUSize, uint32_t maxCUDepth);
     void  destroy();
 
+    // allocate the half-pel plane cache, filled by the FrameFilter
+    bool  createHpelPlanes();
+
+    // allocate the summed area table of the luma plane, filled by the FrameFilter
+    bool  createIntegralPlane();
+
+    // set the dimensions, margins and strides of the planes without allocating them
+    void  initLayout(int picWidth, int picHeight, int csp, uint32_t maxCUSize);
+
+    // migrate the plane buffers to the given NUMA node
+    void  moveToNode(int node);
+
     // ------------------------------------------------------------------------------------------------
     //  Get information of picture
     // ------------------------------------------------------------------------------------------------
@@ -161,6 +184,32 @@ public:
     uint32_t getCUHeight(int rowNum);
 
     void  copyFromPicture(const x265_picture&, int32_t *pad);
+
+    void  padPicture(int32_t *pad);
+
+    // ------------------------------------------------------------------------------------------------
+    //  Zero-copy input buffers
+    // ------------------------------------------------------------------------------------------------
+
+    size_t getLumaBufSize() const;
+
+    size_t getChromaBufSize() const;
+
+    // size in pixels of a buffer holding all three planes with their margins
+    size_t getPlanesBufSize() const;
+
+    // address of the first pixel of a plane within such a buffer
+    pixel* getPlanesBufOrigin(pixel *buf, int plane) const;
+
+    // encode from the planes of the buffer instead of the internal planes
+    void   attachPlanes(pixel *buf);
+
+    // restore the internal planes, returns the attached buffer
+    pixel* detachPlanes();
+
+protected:
+
+    void   setPlaneOrigins();
 }; // END CLASS DEFINITION TComPicYuv
 
 void updateChecksum(const pixel* plane, uint32_t& checksumVal, uint32_t height, uint32_t width, uint32_t stride, int row, uint32_t cuHeight);
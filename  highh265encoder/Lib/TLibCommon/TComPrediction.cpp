@@ -429,6 +429,12 @@ void TComPrediction::xPredInterLumaBlk(TComDataCU *cu, TComPicYuv *refPic, uint3
     {
         primitives.luma_copy_pp[partEnum](dst, dstStride, src, srcStride);
     }
+    else if (!((yFrac | xFrac) & 1) && refPic->m_hpelOrg[0])
+    {
+        /* half-pel position, copy from the cached interpolated plane */
+        int hpel = ((yFrac & 2) | (xFrac >> 1)) - 1;
+        primitives.luma_copy_pp[partEnum](dst, dstStride, refPic->m_hpelOrg[hpel] + (src - refPic->getLumaAddr()), srcStride);
+    }
     else if (yFrac == 0)
     {
         primitives.luma_hpp[partEnum](src, srcStride, dst, dstStride, xFrac);
@@ -68,6 +68,7 @@ TComSlice::TComSlice()
     , m_pic(NULL)
     , m_colFromL0Flag(1)
     , m_colRefIdx(0)
+    , m_sliceCurStartCUAddr(0)
     , m_sliceCurEndCUAddr(0)
     , m_nextSlice(false)
     , m_sliceBits(0)
@@ -138,7 +139,7 @@ bool TComSlice::getRapPicFlag()
 void  TComSlice::allocSubstreamSizes(uint32_t numSubstreams)
 {
     delete[] m_substreamSizes;
-    m_substreamSizes = new uint32_t[numSubstreams > 0 ? numSubstreams - 1 : 0];
+    m_substreamSizes = new uint32_t[numSubstreams];
 }
 
 TComPic* TComSlice::xGetRefPic(PicList& picList, int poc)
@@ -623,6 +624,9 @@ TComPPS::TComPPS()
     , m_useTransformSkip(false)
     , m_entropyCodingSyncEnabledFlag(false)
     , m_loopFilterAcrossTilesEnabledFlag(true)
+    , m_numTileColumnsMinus1(0)
+    , m_numTileRowsMinus1(0)
+    , m_tileUniformSpacingFlag(true)
     , m_signHideFlag(0)
     , m_cabacInitPresentFlag(false)
     , m_encCABACTableIdx(I_SLICE)
@@ -631,6 +635,8 @@ TComPPS::TComPPS()
     , m_numExtraSliceHeaderBits(0)
 {
     m_scalingList = new TComScalingList;
+    ::memset(m_tileColumnWidth, 0, sizeof(m_tileColumnWidth));
+    ::memset(m_tileRowHeight, 0, sizeof(m_tileRowHeight));
 }
 
 TComPPS::~TComPPS()
@@ -1088,6 +1088,11 @@ private:
     bool     m_entropyCodingSyncEnabledFlag; //!< Indicates the presence of wavefronts
 
     bool     m_loopFilterAcrossTilesEnabledFlag;
+    int      m_numTileColumnsMinus1;
+    int      m_numTileRowsMinus1;
+    bool     m_tileUniformSpacingFlag;
+    uint32_t m_tileColumnWidth[X265_MAX_TILE_COLUMNS]; // in CUs
+    uint32_t m_tileRowHeight[X265_MAX_TILE_ROWS];      // in CUs
 
     int      m_signHideFlag;
 
@@ -1188,6 +1193,28 @@ public:
 
     bool    getLoopFilterAcrossTilesEnabledFlag()      { return m_loopFilterAcrossTilesEnabledFlag; }
 
+    bool    getTilesEnabledFlag() const                { return m_numTileColumnsMinus1 > 0 || m_numTileRowsMinus1 > 0; }
+
+    void    setNumTileColumnsMinus1(int i)             { m_numTileColumnsMinus1 = i; }
+
+    int     getNumTileColumnsMinus1() const            { return m_numTileColumnsMinus1; }
+
+    void    setNumTileRowsMinus1(int i)                { m_numTileRowsMinus1 = i; }
+
+    int     getNumTileRowsMinus1() const               { return m_numTileRowsMinus1; }
+
+    void    setTileUniformSpacingFlag(bool b)          { m_tileUniformSpacingFlag = b; }
+
+    bool    getTileUniformSpacingFlag() const          { return m_tileUniformSpacingFlag; }
+
+    void    setTileColumnWidth(int i, uint32_t width)  { m_tileColumnWidth[i] = width; }
+
+    uint32_t getTileColumnWidth(int i) const           { return m_tileColumnWidth[i]; }
+
+    void    setTileRowHeight(int i, uint32_t height)   { m_tileRowHeight[i] = height; }
+
+    uint32_t getTileRowHeight(int i) const             { return m_tileRowHeight[i]; }
+
     bool    getEntropyCodingSyncEnabledFlag() const    { return m_entropyCodingSyncEnabledFlag; }
 
     void    setEntropyCodingSyncEnabledFlag(bool val)  { m_entropyCodingSyncEnabledFlag = val; }
@@ -1326,6 +1353,7 @@ private:
     uint32_t    m_colRefIdx;
     uint32_t    m_maxNumMergeCand;
 
+    uint32_t    m_sliceCurStartCUAddr;
     uint32_t    m_sliceCurEndCUAddr;
     bool        m_nextSlice;
     uint32_t    m_sliceBits;
@@ -1507,6 +1535,10 @@ public:
 
     uint32_t getMaxNumMergeCand()                  { return m_maxNumMergeCand; }
 
+    void setSliceCurStartCUAddr(uint32_t addr)     { m_sliceCurStartCUAddr = addr; }
+
+    uint32_t getSliceCurStartCUAddr()              { return m_sliceCurStartCUAddr; }
+
     void setSliceCurEndCUAddr(uint32_t uiAddr)     { m_sliceCurEndCUAddr = uiAddr; }
 
     uint32_t getSliceCurEndCUAddr()                { return m_sliceCurEndCUAddr; }
@@ -151,6 +151,12 @@ public:
 
     bool getUseScalingList() { return m_scalingListEnabledFlag; }
 
+    void setUseRDOQ(bool bUseRDOQ, bool bUseRDOQTS) { m_useRDOQ = bUseRDOQ; m_useRDOQTS = bUseRDOQTS; }
+
+    bool getUseRDOQ() const { return m_useRDOQ; }
+
+    bool getUseRDOQTS() const { return m_useRDOQTS; }
+
     void setFlatScalingList();
     void xsetFlatScalingList(uint32_t list, uint32_t size, uint32_t qp);
     void xSetScalingListEnc(TComScalingList *scalingList, uint32_t list, uint32_t size, uint32_t qp);
@@ -32,6 +32,7 @@
  */
 
 #include "common.h"
+#include "primitives.h"
 #include "TLibCommon/NAL.h"
 #include "TLibCommon/TComBitStream.h"
 #include "NALwrite.h"
@@ -40,25 +41,27 @@ namespace x265 {
 //! \ingroup TLibEncoder
 //! \{
 
-static const char emulation_prevention_three_byte[] = { 3 };
+/**
+ * The NAL unit header is two bytes, and at most one
+ * emulation_prevention_three_byte is inserted for every two rbsp_bytes, plus
+ * one cabac_zero_word terminating byte
+ */
+uint32_t NALUnitEBSP::maxPacketSize() const
+{
+    return 2 + m_rbspSize + m_rbspSize / 2 + 1;
+}
 
 /**
  * write nalu to bytestream out, performing RBSP anti startcode
- * emulation as required.  nalu.m_RBSPayload must be byte aligned.
- * caller is responsible for freeing returned allocated pointer
+ * emulation as required.  out must have room for maxPacketSize() bytes
  */
-uint8_t *write(const OutputNALUnit& nalu, uint32_t &packetSize)
+uint32_t NALUnitEBSP::write(uint8_t *out) const
 {
-    packetSize = 0;
-    TComOutputBitstream bsNALUHeader;
-    bsNALUHeader.write(0, 1);                        // forbidden_zero_bit
-    bsNALUHeader.write(nalu.m_nalUnitType, 6);       // nal_unit_type
-    bsNALUHeader.write(nalu.m_reservedZero6Bits, 6); // nuh_reserved_zero_6bits
-    bsNALUHeader.write(nalu.m_temporalId + 1, 3);    // nuh_temporal_id_plus1
+    // forbidden_zero_bit, nal_unit_type, nuh_reserved_zero_6bits, nuh_temporal_id_plus1
+    out[0] = (uint8_t)((m_nalUnitType << 1) | (m_reservedZero6Bits >> 5));
+    out[1] = (uint8_t)(((m_reservedZero6Bits & 31) << 3) | (m_temporalId + 1));
 
-    packetSize += bsNALUHeader.getByteStreamLength();
-    uint8_t *out = (uint8_t*)malloc(packetSize);
-    ::memcpy(out, bsNALUHeader.getByteStream(), packetSize);
+    uint32_t packetSize = 2;
 
     /* write out rsbp_byte's, inserting any required
      * emulation_prevention_three_byte's */
@@ -81,51 +84,68 @@ uint8_t *write(const OutputNALUnit& nalu, uint32_t &packetSize)
      *  - 0x00000302
      *  - 0x00000303
      */
-    uint32_t fsize = nalu.m_bitstream.getByteStreamLength();
-    uint8_t* fifo = nalu.m_bitstream.getFIFO();
-    uint32_t emulationSize = fsize / 2;
-    uint8_t* emulation = X265_MALLOC(uint8_t, fsize + emulationSize);
-    uint32_t nalsize = 0;
+    packetSize += primitives.nal_escape(out + packetSize, m_nalUnitData, m_rbspSize);
+
+    /* 7.4.1.1
+     * ... when the last byte of the RBSP data is equal to 0x00 (which can
+     * only occur when the RBSP ends in a cabac_zero_word), a final byte equal
+     * to 0x03 is appended to the end of the data.
+     */
+    if (out[packetSize - 1] == 0x00)
+        out[packetSize++] = 0x03;
+
+    return packetSize;
+}
+
+void NALUnitEBSP::destroy()
+{
+    X265_FREE(m_nalUnitData);
+    m_nalUnitData = NULL;
+}
 
-    if (emulation)
+/**
+ * Write count NAL units to out as Annex-B byte stream NAL units, start codes
+ * and emulation prevention bytes included, and describe them with nals. out
+ * must have room for 4 + maxPacketSize() bytes per NAL unit. Returns the
+ * number of bytes written
+ */
+uint32_t writeAnnexB(uint8_t *out, x265_nal *nals, NALUnitEBSP **nalunits, int count, bool bAccessUnitStart)
+{
+    static const uint8_t start_code_prefix[] = { 0, 0, 0, 1 };
+    uint32_t bytes = 0;
+
+    for (int i = 0; i < count; i++)
     {
-        for (int count = 0; count < fsize; count++)
+        NALUnitEBSP& nalu = *nalunits[i];
+        uint32_t size; /* size of annexB unit in bytes */
+
+        if ((!i && bAccessUnitStart) || nalu.m_nalUnitType == NAL_UNIT_SPS || nalu.m_nalUnitType == NAL_UNIT_PPS)
         {
-            uint8_t val = fifo[count];
-            if (count > 3 && !emulation[nalsize - 2] && !emulation[nalsize - 3] && emulation[nalsize - 1] <= 0x03)
-            {
-                uint8_t tmp = emulation[nalsize - 1];
-                emulation[nalsize - 1] = emulation_prevention_three_byte[0];
-                emulation[nalsize] = tmp;
-                emulation[nalsize + 1] = val;
-                nalsize++;
-            }
-            else
-            {
-                emulation[nalsize] = val;
-            }
-            nalsize++;
+            /* From AVC, When any of the following conditions are fulfilled, the
+             * zero_byte syntax element shall be present:
+             *  - the nal_unit_type within the nal_unit() is equal to 7 (sequence
+             *    parameter set) or 8 (picture parameter set),
+             *  - the byte stream NAL unit syntax structure contains the first NAL
+             *    unit of an access unit in decoding order, as specified by subclause
+             *    7.4.1.2.3.
+             */
+            ::memcpy(out + bytes, start_code_prefix, 4);
+            size = 4;
         }
-
-        uint32_t i = packetSize;
-        out = (uint8_t*)realloc(out, nalsize + 4);
-        memcpy(out + packetSize, emulation, nalsize);
-        packetSize += nalsize;
-
-        /* 7.4.1.1
-         * ... when the last byte of the RBSP data is equal to 0x00 (which can
-         * only occur when the RBSP ends in a cabac_zero_word), a final byte equal
-         * to 0x03 is appended to the end of the data.
-         */
-        if (out[packetSize - 1] == 0x00)
+        else
         {
-            out[i] = 3;
-            packetSize += 1;
+            ::memcpy(out + bytes, start_code_prefix + 1, 3);
+            size = 3;
         }
-        X265_FREE(emulation);
+        nalu.m_packetSize = nalu.write(out + bytes + size);
+
+        nals[i].type = nalu.m_nalUnitType;
+        nals[i].sizeBytes = size + nalu.m_packetSize;
+        nals[i].payload = out + bytes;
+        bytes += nals[i].sizeBytes;
     }
 
-    return out;
+    return bytes;
 }
 
 /**
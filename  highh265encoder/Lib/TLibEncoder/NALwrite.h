@@ -34,6 +34,7 @@
 #ifndef X265_NALWRITE_H
 #define X265_NALWRITE_H
 
+#include "x265.h"
 #include "TLibCommon/TypeDef.h"
 #include "TLibCommon/TComBitStream.h"
 #include "TLibCommon/NAL.h"
@@ -66,15 +67,18 @@ struct OutputNALUnit : public NALUnit
     TComOutputBitstream m_bitstream;
 };
 
-uint8_t *write(const OutputNALUnit& nalu, uint32_t& packetSize);
 void writeRBSPTrailingBits(TComOutputBitstream& bs);
 
-void inline NALUnitEBSP::init(const OutputNALUnit& nalu)
+uint32_t writeAnnexB(uint8_t *out, x265_nal *nals, NALUnitEBSP **nalunits, int count, bool bAccessUnitStart);
+
+void inline NALUnitEBSP::init(OutputNALUnit& nalu)
 {
     m_nalUnitType = nalu.m_nalUnitType;
     m_temporalId = nalu.m_temporalId;
     m_reservedZero6Bits = nalu.m_reservedZero6Bits;
-    m_nalUnitData = write(nalu, m_packetSize);
+    m_rbspSize = nalu.m_bitstream.getByteStreamLength();
+    m_nalUnitData = nalu.m_bitstream.detachFIFO();
+    m_packetSize = 0;
 }
 }
 
@@ -1067,8 +1067,11 @@ void TEncCu::finishCU(TComDataCU* cu, uint32_t absPartIdx, uint32_t depth)
     //Calculate end address
     uint32_t cuAddr = cu->getSCUAddr() + absPartIdx;
 
-    uint32_t internalAddress = (slice->getSliceCurEndCUAddr() - 1) % pic->getNumPartInCU();
-    uint32_t externalAddress = (slice->getSliceCurEndCUAddr() - 1) / pic->getNumPartInCU();
+    // Slices end at a CTU row boundary
+    int sliceIdx = pic->getPicSym()->getCUSliceIdx(cu->getAddr());
+    uint32_t sliceEndCUAddr = pic->getPicSym()->getSliceStartCUAddr(sliceIdx + 1) * pic->getNumPartInCU();
+    uint32_t internalAddress = (sliceEndCUAddr - 1) % pic->getNumPartInCU();
+    uint32_t externalAddress = (sliceEndCUAddr - 1) / pic->getNumPartInCU();
     uint32_t posx = (externalAddress % pic->getFrameWidthInCU()) * g_maxCUSize + g_rasterToPelX[g_zscanToRaster[internalAddress]];
     uint32_t posy = (externalAddress / pic->getFrameWidthInCU()) * g_maxCUSize + g_rasterToPelY[g_zscanToRaster[internalAddress]];
     uint32_t width = slice->getSPS()->getPicWidthInLumaSamples();
@@ -1267,8 +1270,14 @@ void TEncCu::xCheckRDCostMerge2Nx2N(TComDataCU*& outBestCU, TComDataCU*& outTemp
         for (uint32_t mergeCand = 0; mergeCand < numValidMergeCand; ++mergeCand)
         {
             if (m_param->frameNumThreads > 1 &&
-                (mvFieldNeighbours[0 + 2 * mergeCand].mv.y >= (m_param->searchRange + 1) * 4 ||
-                 mvFieldNeighbours[1 + 2 * mergeCand].mv.y >= (m_param->searchRange + 1) * 4))
+                (mvFieldNeighbours[0 + 2 * mergeCand].mv.y >= (m_search->getSearchRange() + 1) * 4 ||
+                 mvFieldNeighbours[1 + 2 * mergeCand].mv.y >= (m_search->getSearchRange() + 1) * 4))
+            {
+                continue;
+            }
+            if (m_param->frameNumThreads > 1 && m_param->bEnableCtuRefSync &&
+                (mvFieldNeighbours[0 + 2 * mergeCand].mv.x >= (m_search->getSearchRange() + 1) * 4 ||
+                 mvFieldNeighbours[1 + 2 * mergeCand].mv.x >= (m_search->getSearchRange() + 1) * 4))
             {
                 continue;
             }
@@ -155,6 +155,8 @@ public:
 
     void setBitCounter(TComBitCounter* pcBitCounter) { m_bitCounter = pcBitCounter; }
 
+    void setParam(x265_param* param) { m_param = param; }
+
 protected:
 
     void finishCU(TComDataCU* cu, uint32_t absPartIdx, uint32_t depth);
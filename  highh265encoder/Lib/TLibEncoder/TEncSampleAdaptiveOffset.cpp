@@ -1425,11 +1425,12 @@ void TEncSampleAdaptiveOffset::rdoSaoUnitRow(SAOParam *saoParam, int idxY)
             int allowMergeUp   = 1;
             uint32_t rate;
             double bestCost, mergeCost;
-            if (idxX == 0)
+            TComPicSym* picSym = m_pic->getPicSym();
+            if (idxX == 0 || picSym->getTileIdxMap(addr) != picSym->getTileIdxMap(addrLeft))
             {
                 allowMergeLeft = 0;
             }
-            if (idxY == 0)
+            if (picSym->isSliceStartRow(idxY) || picSym->getTileIdxMap(addr) != picSym->getTileIdxMap(addrUp))
             {
                 allowMergeUp = 0;
             }
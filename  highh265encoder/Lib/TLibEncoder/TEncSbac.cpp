@@ -537,8 +537,27 @@ void TEncSbac::codePPS(TComPPS* pps)
     WRITE_FLAG(pps->getUseWP() ? 1 : 0,                    "weighted_pred_flag");   // Use of Weighting Prediction (P_SLICE)
     WRITE_FLAG(pps->getWPBiPred() ? 1 : 0,                 "weighted_bipred_flag");  // Use of Weighting Bi-Prediction (B_SLICE)
     WRITE_FLAG(pps->getTransquantBypassEnableFlag() ? 1 : 0, "transquant_bypass_enable_flag");
-    WRITE_FLAG(0,                                          "tiles_enabled_flag");
+    WRITE_FLAG(pps->getTilesEnabledFlag() ? 1 : 0,         "tiles_enabled_flag");
     WRITE_FLAG(pps->getEntropyCodingSyncEnabledFlag() ? 1 : 0, "entropy_coding_sync_enabled_flag");
+    if (pps->getTilesEnabledFlag())
+    {
+        WRITE_UVLC(pps->getNumTileColumnsMinus1(),         "num_tile_columns_minus1");
+        WRITE_UVLC(pps->getNumTileRowsMinus1(),            "num_tile_rows_minus1");
+        WRITE_FLAG(pps->getTileUniformSpacingFlag() ? 1 : 0, "uniform_spacing_flag");
+        if (!pps->getTileUniformSpacingFlag())
+        {
+            for (int i = 0; i < pps->getNumTileColumnsMinus1(); i++)
+            {
+                WRITE_UVLC(pps->getTileColumnWidth(i) - 1, "column_width_minus1");
+            }
+
+            for (int i = 0; i < pps->getNumTileRowsMinus1(); i++)
+            {
+                WRITE_UVLC(pps->getTileRowHeight(i) - 1,   "row_height_minus1");
+            }
+        }
+        WRITE_FLAG(pps->getLoopFilterAcrossTilesEnabledFlag() ? 1 : 0, "loop_filter_across_tiles_enabled_flag");
+    }
     WRITE_FLAG(1,                                          "loop_filter_across_slices_enabled_flag");
 
     // TODO: Here have some time sequence problem, we set below field in initEncSlice(), but use them in getStreamHeaders() early
@@ -993,7 +1012,7 @@ void TEncSbac::codeSliceHeader(TComSlice* slice)
     }
 
     //write slice address
-    int sliceSegmentAddress = 0;
+    int sliceSegmentAddress = slice->getSliceCurStartCUAddr() / slice->getPic()->getNumPartInCU();
 
     WRITE_FLAG(sliceSegmentAddress == 0, "first_slice_segment_in_pic_flag");
     if (slice->getRapPicFlag())
@@ -1270,23 +1289,24 @@ void TEncSbac::codeSliceHeader(TComSlice* slice)
  */
 void  TEncSbac::codeTilesWPPEntryPoint(TComSlice* slice)
 {
-    if (!slice->getPPS()->getEntropyCodingSyncEnabledFlag())
+    if (!slice->getPPS()->getTilesEnabledFlag() && !slice->getPPS()->getEntropyCodingSyncEnabledFlag())
     {
         return;
     }
     uint32_t numEntryPointOffsets = 0, offsetLenMinus1 = 0, maxOffset = 0;
     uint32_t *entryPointOffset = NULL;
-    if (slice->getPPS()->getEntropyCodingSyncEnabledFlag())
     {
+        // every substream of the slice but the last needs an entry point
         uint32_t* substreamSizes          = slice->getSubstreamSizes();
         int maxNumParts                   = slice->getPic()->getNumPartInCU();
-        int numZeroSubstreamsAtEndOfSlice = slice->getPic()->getFrameHeightInCU() - 1 - ((slice->getSliceCurEndCUAddr() - 1) / maxNumParts / slice->getPic()->getFrameWidthInCU());
-        numEntryPointOffsets              = slice->getPic()->getFrameHeightInCU() - numZeroSubstreamsAtEndOfSlice - 1;
+        TComPicSym* picSym                = slice->getPic()->getPicSym();
+        int sliceIdx                      = picSym->getCUSliceIdx(slice->getSliceCurStartCUAddr() / maxNumParts);
+        entryPointOffset                  = new uint32_t[picSym->getFrameHeightInCU() * picSym->getNumTileCols()];
+        numEntryPointOffsets              = picSym->getSliceSubstreams(sliceIdx, slice->getPPS()->getEntropyCodingSyncEnabledFlag(), entryPointOffset) - 1;
         slice->setNumEntryPointOffsets(numEntryPointOffsets);
-        entryPointOffset = new uint32_t[numEntryPointOffsets];
-        for (int idx = 0; idx < numEntryPointOffsets; idx++)
+        for (uint32_t idx = 0; idx < numEntryPointOffsets; idx++)
         {
-            entryPointOffset[idx] = (substreamSizes[idx] >> 3);
+            entryPointOffset[idx] = (substreamSizes[entryPointOffset[idx]] >> 3);
             if (entryPointOffset[idx] > maxOffset)
             {
                 maxOffset = entryPointOffset[idx];
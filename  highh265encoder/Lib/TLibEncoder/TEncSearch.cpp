@@ -104,6 +104,19 @@ TEncSearch::~TEncSearch()
     m_qtTempTransformSkipYuv.destroy();
 }
 
+void TEncSearch::setSearchRange(int searchRange, const int* ctuSearchRange)
+{
+    m_searchRange = searchRange;
+    m_ctuSearchRange = ctuSearchRange;
+
+    /* When frame parallelism is active, only 'refLagPixels' of reference frames will be guaranteed
+     * available for motion reference.  See refLagRows in FrameEncoder::compressCTURows() */
+    m_refLagPixels = m_cfg->param->frameNumThreads > 1 ? searchRange : m_cfg->param->sourceHeight;
+
+    /* With CTU granular reference sync, the same holds to the right of the CTU */
+    m_refLagPixelsX = m_cfg->param->frameNumThreads > 1 && m_cfg->param->bEnableCtuRefSync ? searchRange : m_cfg->param->sourceWidth;
+}
+
 bool TEncSearch::init(Encoder* cfg, TComRdCost* rdCost, TComTrQuant* trQuant)
 {
     m_cfg     = cfg;
@@ -113,10 +126,9 @@ bool TEncSearch::init(Encoder* cfg, TComRdCost* rdCost, TComTrQuant* trQuant)
     initTempBuff(cfg->param->internalCsp);
     m_me.setSearchMethod(cfg->param->searchMethod);
     m_me.setSubpelRefine(cfg->param->subpelRefine);
+    m_me.setCandidateStart(!!cfg->param->bEnableLowresMvc);
 
-    /* When frame parallelism is active, only 'refLagPixels' of reference frames will be guaranteed
-     * available for motion reference.  See refLagRows in FrameEncoder::compressCTURows() */
-    m_refLagPixels = cfg->param->frameNumThreads > 1 ? cfg->param->searchRange : cfg->param->sourceHeight;
+    setSearchRange(cfg->param->searchRange, NULL);
 
     const uint32_t numLayersToAllocate = cfg->m_quadtreeTULog2MaxSize - cfg->m_quadtreeTULog2MinSize + 1;
     m_qtTempCoeffY  = new coeff_t*[numLayersToAllocate];
@@ -430,7 +442,7 @@ void TEncSearch::xIntraCodingLumaBlk(TComDataCU* cu,
 
     //===== transform and quantization =====
     //--- init rate estimation arrays for RDOQ ---
-    if (useTransformSkip ? m_cfg->bEnableRDOQTS : m_cfg->bEnableRDOQ)
+    if (useTransformSkip ? m_trQuant->getUseRDOQTS() : m_trQuant->getUseRDOQ())
     {
         m_entropyCoder->estimateBit(m_trQuant->m_estBitsSbac, width, TEXT_LUMA);
     }
@@ -543,7 +555,7 @@ void TEncSearch::xIntraCodingChromaBlk(TComDataCU* cu,
     //===== transform and quantization =====
     {
         //--- init rate estimation arrays for RDOQ ---
-        if (useTransformSkipChroma ? m_cfg->bEnableRDOQTS : m_cfg->bEnableRDOQ)
+        if (useTransformSkipChroma ? m_trQuant->getUseRDOQTS() : m_trQuant->getUseRDOQ())
         {
             m_entropyCoder->estimateBit(m_trQuant->m_estBitsSbac, width, ttype);
         }
@@ -2102,8 +2114,14 @@ uint32_t TEncSearch::xMergeEstimation(TComDataCU* cu, int puIdx, MergeData& m)
     {
         /* Prevent TMVP candidates from using unavailable reference pixels */
         if (m_cfg->param->frameNumThreads > 1 &&
-            (m.mvFieldNeighbours[0 + 2 * mergeCand].mv.y >= (m_cfg->param->searchRange + 1) * 4 ||
-             m.mvFieldNeighbours[1 + 2 * mergeCand].mv.y >= (m_cfg->param->searchRange + 1) * 4))
+            (m.mvFieldNeighbours[0 + 2 * mergeCand].mv.y >= (m_searchRange + 1) * 4 ||
+             m.mvFieldNeighbours[1 + 2 * mergeCand].mv.y >= (m_searchRange + 1) * 4))
+        {
+            continue;
+        }
+        if (m_refLagPixelsX < m_cfg->param->sourceWidth &&
+            (m.mvFieldNeighbours[0 + 2 * mergeCand].mv.x >= (m_searchRange + 1) * 4 ||
+             m.mvFieldNeighbours[1 + 2 * mergeCand].mv.x >= (m_searchRange + 1) * 4))
         {
             continue;
         }
@@ -2207,7 +2225,15 @@ bool TEncSearch::predInterSearch(TComDataCU* cu, TComYuv* predYuv, bool bMergeOn
 
         xGetBlkBits(partSize, cu->getSlice()->isInterP(), partIdx, lastMode, listSelBits);
 
-        // Uni-directional prediction
+        // Uni-directional prediction, the searches of all the references are
+        // prepared first so their integer searches can run in lockstep
+        MotionEstimate::RefSearch search[2 * MAX_NUM_REF];
+        MotionData searchData[2 * MAX_NUM_REF];
+        int searchList[2 * MAX_NUM_REF];
+        MV mvc[2 * MAX_NUM_REF][AMVP_MAX_NUM_CANDS + MAX_LOWRES_MVC];
+        int numSearch = 0;
+        int searchRange[2 * MAX_NUM_REF];
+
         for (int l = 0; l < numPredDir; l++)
         {
             for (int ref = 0; ref < cu->getSlice()->getNumRefIdx(l); ref++)
@@ -2223,7 +2249,6 @@ bool TEncSearch::predInterSearch(TComDataCU* cu, TComYuv* predYuv, bool bMergeOn
                 cu->fillMvpCand(partIdx, partAddr, l, ref, &amvpInfo[l][ref]);
 
                 // Pick the best possible MVP from AMVP candidates based on least residual
-                MV mvc[AMVP_MAX_NUM_CANDS];
                 uint32_t bestCost = MAX_INT;
                 int mvpIdx = 0;
                 int numMvc = 0;
@@ -2231,7 +2256,7 @@ bool TEncSearch::predInterSearch(TComDataCU* cu, TComYuv* predYuv, bool bMergeOn
                 {
                     MV mvCand = amvpInfo[l][ref].m_mvCand[i];
                     if (mvCand.notZero())
-                        mvc[numMvc++] = mvCand;
+                        mvc[numSearch][numMvc++] = mvCand;
 
                     // TODO: skip mvCand if Y is > merange and -FN>1
                     cu->clipMv(mvCand);
@@ -2247,28 +2272,85 @@ bool TEncSearch::predInterSearch(TComDataCU* cu, TComYuv* predYuv, bool bMergeOn
                     }
                 }
 
-                MV mvmin, mvmax, outmv, mvp = amvpInfo[l][ref].m_mvCand[mvpIdx];
-
-                int merange = m_cfg->param->searchRange;
-                xSetSearchRange(cu, mvp, merange, mvmin, mvmax);
-                int satdCost = m_me.motionEstimate(m_mref[l][ref], mvmin, mvmax, mvp, numMvc, mvc, merange, outmv);
+                MV mvp = amvpInfo[l][ref].m_mvCand[mvpIdx];
 
-                /* Get total cost of partition, but only include MV bit cost once */
-                bits += m_me.bitcost(outmv);
-                uint32_t cost = (satdCost - m_me.mvcost(outmv)) + m_rdCost->getCost(bits);
+                if (m_cfg->param->bEnableLowresMvc)
+                    numMvc += xGetLowresMvc(cu, pu - fenc->getLumaAddr(), roiWidth, roiHeight, l, ref, mvc[numSearch] + numMvc);
 
-                /* Refine MVP selection, updates: mvp, mvpIdx, bits, cost */
-                xCheckBestMVP(&amvpInfo[l][ref], outmv, mvp, mvpIdx, bits, cost);
+                MotionEstimate::RefSearch& rs = search[numSearch];
+                rs.ref = m_mref[l][ref];
+                rs.qmvp = mvp;
+                rs.numCandidates = numMvc;
+                rs.mvc = mvc[numSearch];
 
-                if (cost < list[l].cost)
+                /* the adaptive range of the CTU bounds the motion itself, the
+                 * window around the MVP must reach that far from any MVP */
+                searchRange[numSearch] = m_searchRange;
+                if (m_ctuSearchRange)
                 {
-                    list[l].mv = outmv;
-                    list[l].mvp = mvp;
-                    list[l].mvpIdx = mvpIdx;
-                    list[l].ref = ref;
-                    list[l].cost = cost;
-                    list[l].bits = bits;
+                    int mvpDist = (X265_MAX(abs(mvp.x), abs(mvp.y)) + 3) >> 2;
+                    searchRange[numSearch] = X265_MIN(m_ctuSearchRange[cu->getAddr()] + mvpDist, m_cfg->param->searchRange);
                 }
+                xSetSearchRange(cu, mvp, searchRange[numSearch], rs.mvmin, rs.mvmax);
+
+                searchData[numSearch].mvp = mvp;
+                searchData[numSearch].mvpIdx = mvpIdx;
+                searchData[numSearch].ref = ref;
+                searchData[numSearch].bits = bits;
+                searchList[numSearch] = l;
+                numSearch++;
+            }
+        }
+
+        for (int s = 0; s < numSearch; s += MotionEstimate::MAX_SEARCH_REFS)
+        {
+            int count = X265_MIN(numSearch - s, MotionEstimate::MAX_SEARCH_REFS);
+            int groupRange = 0;
+            for (int i = 0; i < count; i++)
+            {
+                m_me.searchStart(search[s + i]);
+                groupRange = X265_MAX(groupRange, searchRange[s + i]);
+            }
+            m_me.searchRefs(search + s, count, groupRange);
+        }
+
+        /* references whose integer search cost, with the bits of signaling the
+         * reference, exceeds the best one of their list by more than a margin
+         * are not refined at subpel, see --ref-early-exit */
+        uint32_t intCost[2 * MAX_NUM_REF];
+        uint32_t bestIntCost[2] = { MAX_UINT, MAX_UINT };
+        for (int s = 0; s < numSearch; s++)
+        {
+            intCost[s] = X265_MIN(search[s].bcost, search[s].bprecost) + m_rdCost->getCost(searchData[s].bits);
+            bestIntCost[searchList[s]] = X265_MIN(bestIntCost[searchList[s]], intCost[s]);
+        }
+
+        for (int s = 0; s < numSearch; s++)
+        {
+            int l = searchList[s];
+            if (m_cfg->param->bEnableRefEarlyExit && intCost[s] > bestIntCost[l] + (bestIntCost[l] >> REF_EXIT_MARGIN_SHIFT))
+                continue;
+
+            MV outmv;
+            int satdCost = m_me.finishSearch(search[s], outmv);
+
+            /* Get total cost of partition, but only include MV bit cost once */
+            MV mvp = searchData[s].mvp;
+            int mvpIdx = searchData[s].mvpIdx;
+            uint32_t bits = searchData[s].bits + m_me.bitcost(outmv);
+            uint32_t cost = (satdCost - m_me.mvcost(outmv)) + m_rdCost->getCost(bits);
+
+            /* Refine MVP selection, updates: mvp, mvpIdx, bits, cost */
+            xCheckBestMVP(&amvpInfo[l][searchData[s].ref], outmv, mvp, mvpIdx, bits, cost);
+
+            if (cost < list[l].cost)
+            {
+                list[l].mv = outmv;
+                list[l].mvp = mvp;
+                list[l].mvpIdx = mvpIdx;
+                list[l].ref = searchData[s].ref;
+                list[l].cost = cost;
+                list[l].bits = bits;
             }
         }
 
@@ -2527,6 +2609,54 @@ void TEncSearch::xSetSearchRange(TComDataCU* cu, MV mvp, int merange, MV& mvmin,
     /* conditional clipping for frame parallelism */
     mvmin.y = X265_MIN(mvmin.y, m_refLagPixels);
     mvmax.y = X265_MIN(mvmax.y, m_refLagPixels);
+    mvmin.x = X265_MIN(mvmin.x, m_refLagPixelsX);
+    mvmax.x = X265_MIN(mvmax.x, m_refLagPixelsX);
+}
+
+/* Collect the lookahead's motion vectors of the lowres blocks under the center
+ * and the corners of the PU, scaled to full resolution, as motion candidates.
+ * The lookahead estimated them against the picture at the same distance in
+ * the same direction. Returns the number of distinct candidates written */
+int TEncSearch::xGetLowresMvc(TComDataCU* cu, intptr_t puOffset, int width, int height, int list, int ref, MV* mvc)
+{
+    TComPic *pic = cu->getSlice()->getPic();
+    Lowres& lowres = pic->m_lowres;
+    int dist = pic->getPOC() - cu->getSlice()->getRefPic(list, ref)->getPOC();
+    int dir = dist > 0 ? 0 : 1;
+    dist = abs(dist);
+    if (!dist || dist > lowres.bframes + 1)
+        return 0;
+
+    const MV *mvs = lowres.lowresMvs[dir][dist - 1];
+    if (mvs[0].x == 0x7FFF)
+        return 0; // not estimated by the lookahead
+
+    const int widthInCU = ((m_cfg->param->sourceWidth / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+    const int heightInCU = ((m_cfg->param->sourceHeight / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+    const int stride = pic->getPicYuvOrg()->getStride();
+    const int puX = (int)(puOffset % stride);
+    const int puY = (int)(puOffset / stride);
+    const int points[MAX_LOWRES_MVC][2] =
+    {
+        { width >> 1, height >> 1 }, { 0, 0 }, { width - 1, 0 }, { 0, height - 1 }, { width - 1, height - 1 }
+    };
+
+    int num = 0;
+    for (int i = 0; i < MAX_LOWRES_MVC; i++)
+    {
+        /* each lowres block covers 16x16 full resolution pixels */
+        int cuX = X265_MIN((puX + points[i][0]) >> (X265_LOWRES_CU_BITS + 1), widthInCU - 1);
+        int cuY = X265_MIN((puY + points[i][1]) >> (X265_LOWRES_CU_BITS + 1), heightInCU - 1);
+        MV mv = mvs[cuY * widthInCU + cuX] * 2;
+
+        bool bDuplicate = false;
+        for (int j = 0; j < num && !bDuplicate; j++)
+            bDuplicate = mvc[j] == mv;
+        if (!bDuplicate)
+            mvc[num++] = mv;
+    }
+
+    return num;
 }
 
 /** encode residual and calculate rate-distortion for a CU block
@@ -2981,7 +3111,7 @@ void TEncSearch::xEstimateResidualQT(TComDataCU*    cu,
             cu->setTransformSkipSubParts(0, TEXT_CHROMA_V, absPartIdx, cu->getDepth(0) + trModeC);
         }
 
-        if (m_cfg->bEnableRDOQ && curuseRDOQ)
+        if (m_trQuant->getUseRDOQ() && curuseRDOQ)
         {
             m_entropyCoder->estimateBit(m_trQuant->m_estBitsSbac, trWidth, TEXT_LUMA);
         }
@@ -2996,7 +3126,7 @@ void TEncSearch::xEstimateResidualQT(TComDataCU*    cu,
 
         if (bCodeChroma)
         {
-            if (m_cfg->bEnableRDOQ && curuseRDOQ)
+            if (m_trQuant->getUseRDOQ() && curuseRDOQ)
             {
                 m_entropyCoder->estimateBit(m_trQuant->m_estBitsSbac, trWidthC, TEXT_CHROMA);
             }
@@ -3272,7 +3402,7 @@ void TEncSearch::xEstimateResidualQT(TComDataCU*    cu,
 
             cu->setTransformSkipSubParts(1, TEXT_LUMA, absPartIdx, depth);
 
-            if (m_cfg->bEnableRDOQTS)
+            if (m_trQuant->getUseRDOQTS())
             {
                 m_entropyCoder->estimateBit(m_trQuant->m_estBitsSbac, trWidth, TEXT_LUMA);
             }
@@ -3351,7 +3481,7 @@ void TEncSearch::xEstimateResidualQT(TComDataCU*    cu,
             cu->setTransformSkipSubParts(1, TEXT_CHROMA_U, absPartIdx, cu->getDepth(0) + trModeC);
             cu->setTransformSkipSubParts(1, TEXT_CHROMA_V, absPartIdx, cu->getDepth(0) + trModeC);
 
-            if (m_cfg->bEnableRDOQTS)
+            if (m_trQuant->getUseRDOQTS())
             {
                 m_entropyCoder->estimateBit(m_trQuant->m_estBitsSbac, trWidthC, TEXT_CHROMA);
             }
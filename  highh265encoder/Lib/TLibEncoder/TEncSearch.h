@@ -52,6 +52,8 @@
 #include "motion.h"
 
 #define MVP_IDX_BITS 1
+#define MAX_LOWRES_MVC 5 // lowres motion candidates per PU, see xGetLowresMvc()
+#define REF_EXIT_MARGIN_SHIFT 3 // --ref-early-exit margin, 1/8 of the best integer search cost
 
 //! \ingroup TLibEncoder
 //! \{
@@ -138,6 +140,12 @@ protected:
 
     // ME parameters
     int             m_refLagPixels;
+    int             m_refLagPixelsX;
+
+    /* search range of the frame and, when the range adapts to the lookahead's
+     * motion, of each of its CTUs. See setSearchRange() */
+    int             m_searchRange;
+    const int*      m_ctuSearchRange;
 
     // Color space parameters
     uint32_t        m_section;
@@ -156,6 +164,12 @@ public:
 
     void setQPLambda(int QP, double lambdaLuma, double lambdaChroma);
 
+    /* Set the search range of the frame, which bounds the reference lag of
+     * frame parallelism, and optionally a smaller range for each CTU */
+    void setSearchRange(int searchRange, const int* ctuSearchRange);
+
+    int getSearchRange() const { return m_searchRange; }
+
     TEncSearch();
     virtual ~TEncSearch();
 
@@ -254,6 +268,8 @@ protected:
 
     void xSetSearchRange(TComDataCU* cu, MV mvp, int merange, MV& mvmin, MV& mvmax);
 
+    int xGetLowresMvc(TComDataCU* cu, intptr_t puOffset, int width, int height, int list, int ref, MV* mvc);
+
     // -------------------------------------------------------------------------------------------------------------------
     // T & Q & Q-1 & T-1
     // -------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,114 @@
+/*****************************************************************************
+ * Copyright (C) 2013 x265 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@multicorewareinc.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "primitives.h"
+
+namespace {
+// x265 private namespace
+
+/* Runs the emulation prevention of count RBSP bytes, continuing the run of
+ * zeros preceding them. An emulation_prevention_three_byte goes before any
+ * byte <= 0x03 which follows two zero bytes. Copies the escaped bytes to dst
+ * unless it is NULL and returns the number of escapes inserted */
+inline uint32_t escapeRun(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t& zeros)
+{
+    uint32_t escapes = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint8_t val = src[i];
+
+        if (zeros >= 2 && val <= 0x03)
+        {
+            if (dst)
+                *dst++ = 0x03;
+            escapes++;
+            zeros = 0;
+        }
+
+        if (dst)
+            *dst++ = val;
+        zeros = val ? 0 : zeros + 1;
+    }
+
+    return escapes;
+}
+
+/* Copy size RBSP bytes to dst, escaping them. Returns the number of bytes
+ * written, dst must have room for size + size / 2 bytes */
+uint32_t nalEscape_c(uint8_t *dst, const uint8_t *src, uint32_t size)
+{
+    uint32_t zeros = 0;
+
+    return size + escapeRun(dst, src, size, zeros);
+}
+
+/* Returns the number of emulation_prevention_three_bytes nal_escape would
+ * insert into these size bytes */
+uint32_t nalCountEscapes_c(const uint8_t *src, uint32_t size)
+{
+    uint32_t zeros = 0;
+
+    return escapeRun(NULL, src, size, zeros);
+}
+}
+
+namespace x265 {
+// x265 private namespace
+
+/* An escape can only be required at a byte <= 0x03 which follows two zero
+ * bytes of the RBSP, so the blocks in which candidates() finds no such byte
+ * are copied (or skipped) whole and the others are escaped byte by byte.
+ * Escapes only reset the zero run, so the candidates found in the RBSP are a
+ * superset of the bytes which need escaping. Returns the number of bytes of
+ * the escaped RBSP, which is only written when dst is not NULL */
+uint32_t nalEscapeBlocks(uint8_t *dst, const uint8_t *src, uint32_t size, nal_escape_candidates_t candidates, uint32_t blockSize)
+{
+    uint32_t zeros = 0;
+
+    // the first two bytes can never be escaped, and candidates() reads the
+    // two bytes before the block
+    uint32_t i = X265_MIN(size, 2);
+    uint32_t bytes = i + escapeRun(dst, src, i, zeros);
+
+    for (; i + blockSize <= size; i += blockSize)
+    {
+        if (candidates(src + i))
+            bytes += blockSize + escapeRun(dst ? dst + bytes : NULL, src + i, blockSize, zeros);
+        else
+        {
+            if (dst)
+                memcpy(dst + bytes, src + i, blockSize);
+            bytes += blockSize;
+            zeros = src[i + blockSize - 1] ? 0 : src[i + blockSize - 2] ? 1 : 2;
+        }
+    }
+
+    return bytes + (size - i) + escapeRun(dst ? dst + bytes : NULL, src + i, size - i, zeros);
+}
+
+void Setup_C_BitstreamPrimitives(EncoderPrimitives &p)
+{
+    p.nal_escape = nalEscape_c;
+    p.nal_count_escapes = nalCountEscapes_c;
+}
+}
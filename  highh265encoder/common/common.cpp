@@ -35,6 +35,11 @@
 #include <sys/time.h>
 #endif
 
+#if HAVE_LIBNUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
 int64_t x265_mdate(void)
 {
 #if _WIN32
@@ -87,6 +92,30 @@ void x265_free(void *ptr)
 
 #endif // if _WIN32
 
+/* Migrate the pages backing an allocation to the given NUMA node, and prefer
+ * that node for any of its pages which are not yet resident. Pages which the
+ * allocation shares with its neighbors are left where they are */
+void x265_move_to_node(void *ptr, size_t size, int node)
+{
+#if HAVE_LIBNUMA
+    if (!ptr || node < 0 || node >= (int)sizeof(unsigned long) * 8 || numa_available() < 0)
+        return;
+
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)ptr + pageSize - 1) & ~(pageSize - 1);
+    uintptr_t end = ((uintptr_t)ptr + size) & ~(pageSize - 1);
+    if (end > start)
+    {
+        unsigned long nodeMask = 1UL << node;
+        mbind((void*)start, end - start, MPOL_PREFERRED, &nodeMask, sizeof(nodeMask) * 8, MPOL_MF_MOVE);
+    }
+#else
+    (void)ptr;
+    (void)size;
+    (void)node;
+#endif
+}
+
 /* Not a general-purpose function; multiplies input by -1/6 to convert
  * qp to qscale. */
 int x265_exp2fix8(double x)
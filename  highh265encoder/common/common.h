@@ -120,7 +120,8 @@ typedef int32_t  coeff_t;      // transform coefficient
 #define X265_LOWRES_CU_SIZE   8
 #define X265_LOWRES_CU_BITS   3
 
-#define MAX_NAL_UNITS 12
+#define MAX_SLICES    64
+#define MAX_NAL_UNITS (12 + MAX_SLICES)
 #define MIN_FIFO_SIZE 1000
 
 #define X265_MALLOC(type, count)    (type*)x265_malloc(sizeof(type) * (count))
@@ -149,6 +150,7 @@ void x265_log(x265_param *param, int level, const char *fmt, ...);
 int x265_exp2fix8(double x);
 void *x265_malloc(size_t size);
 void x265_free(void *ptr);
+void x265_move_to_node(void *ptr, size_t size, int node);
 
 double x265_ssim2dB(double ssim);
 double x265_qScale2qp(double qScale);
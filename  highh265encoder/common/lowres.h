@@ -39,6 +39,10 @@ struct ReferencePlanes
 
     pixel* fpelPlane;
     pixel* lowresPlane[4];
+    pixel* hpelPlane[4];  /* cached full resolution half-pel planes, indexed like
+                           * lowresPlane. NULL if the reference has no cache */
+    uint32_t* integralPlane; /* summed area table of fpelPlane, at the same
+                              * offsets. NULL if the reference has none */
 
     bool isWeighted;
     bool isLowres;
@@ -99,8 +99,16 @@ void x265_param_default(x265_param *param)
     param->cpuid = x265::cpu_detect();
     param->logLevel = X265_LOG_INFO;
     param->bEnableWavefront = 1;
+    param->maxSlices = 1;
+    param->tileColumns = 1;
+    param->tileRows = 1;
+    param->bLoopFilterAcrossTiles = 1;
     param->frameNumThreads = 0;
+    param->bEnableCtuRefSync = 0;
     param->poolNumThreads = 0;
+    param->numaPools = 0;
+    param->threadPool = NULL;
+    param->poolWeight = 1;
     param->csvfn = NULL;
 
     /* Source specifications */
@@ -129,7 +137,11 @@ void x265_param_default(x265_param *param)
     /* Inter Coding tools */
     param->searchMethod = X265_HEX_SEARCH;
     param->subpelRefine = 2;
+    param->bEnableHpelCache = 0;
+    param->bEnableLowresMvc = 1;
+    param->bEnableRefEarlyExit = 0;
     param->searchRange = 57;
+    param->bEnableAdaptiveMeRange = 0;
     param->maxNumMergeCand = 2;
     param->bEnableWeightedPred = 1;
     param->bEnableWeightedBiPred = 0;
@@ -160,6 +172,7 @@ void x265_param_default(x265_param *param)
     param->rc.vbvMaxBitrate = 0;
     param->rc.vbvBufferSize = 0;
     param->rc.vbvBufferInit = 0.9;
+    param->rc.vbvBufferEnd = 0;
     param->rc.rfConstant = 28;
     param->rc.bitrate = 0;
     param->rc.rateTolerance = 1.0;
@@ -176,6 +189,7 @@ void x265_param_default(x265_param *param)
     /* Quality Measurement Metrics */
     param->bEnablePsnr = 0;
     param->bEnableSsim = 0;
+    param->metricsInterval = 1;
 
     /* Video Usability Information (VUI) */
     param->vui.aspectRatioIdc = 0;
@@ -312,6 +326,7 @@ int x265_param_default_preset(x265_param *param, const char *preset, const char
             param->lookaheadDepth = 15;
             param->bEnableRectInter = 0;
             param->bEnableAMP = 0;
+            param->bEnableRefEarlyExit = 1;
         }
         else if (!strcmp(preset, "medium"))
         {
@@ -322,6 +337,7 @@ int x265_param_default_preset(x265_param *param, const char *preset, const char
             param->lookaheadDepth = 25;
             param->rdLevel = 4;
             param->subpelRefine = 3;
+            param->bEnableHpelCache = 1;
             param->maxNumMergeCand = 3;
             param->searchMethod = X265_STAR_SEARCH;
         }
@@ -333,6 +349,7 @@ int x265_param_default_preset(x265_param *param, const char *preset, const char
             param->tuQTMaxIntraDepth = 2;
             param->rdLevel = 6;
             param->subpelRefine = 3;
+            param->bEnableHpelCache = 1;
             param->maxNumMergeCand = 3;
             param->searchMethod = X265_STAR_SEARCH;
         }
@@ -344,6 +361,7 @@ int x265_param_default_preset(x265_param *param, const char *preset, const char
             param->tuQTMaxIntraDepth = 3;
             param->rdLevel = 6;
             param->subpelRefine = 4;
+            param->bEnableHpelCache = 1;
             param->maxNumMergeCand = 4;
             param->searchMethod = X265_STAR_SEARCH;
             param->maxNumReferences = 5;
@@ -357,6 +375,7 @@ int x265_param_default_preset(x265_param *param, const char *preset, const char
             param->tuQTMaxIntraDepth = 4;
             param->rdLevel = 6;
             param->subpelRefine = 5;
+            param->bEnableHpelCache = 1;
             param->maxNumMergeCand = 5;
             param->searchMethod = X265_STAR_SEARCH;
             param->bEnableTransformSkip = 1;
@@ -424,6 +443,30 @@ static double x265_atof(const char *str, bool& bError)
     return v;
 }
 
+/* parse a comma separated list of tile sizes, returns the number of sizes or
+ * sets bError if the list is malformed or too long */
+static int parseTileSizes(const char *arg, int *sizes, int maxCount, bool& bError)
+{
+    int count = 0;
+
+    while (*arg)
+    {
+        char *end;
+        long v = strtol(arg, &end, 0);
+        if (end == arg || v < 1 || count == maxCount || (*end && *end != ','))
+        {
+            bError = true;
+            return 0;
+        }
+        sizes[count++] = (int)v;
+        arg = *end ? end + 1 : end;
+    }
+
+    if (!count)
+        bError = true;
+    return count;
+}
+
 static int parseName(const char *arg, const char * const * names, bool& bError)
 {
     for (int i = 0; names[i]; i++)
@@ -521,7 +564,10 @@ int x265_param_parse(x265_param *p, const char *name, const char *value)
     }
     OPT("csv") p->csvfn = value;
     OPT("threads") p->poolNumThreads = atoi(value);
+    OPT("numa-pools") p->numaPools = atoi(value);
+    OPT("pool-weight") p->poolWeight = atoi(value);
     OPT("frame-threads") p->frameNumThreads = atoi(value);
+    OPT("ctu-ref-sync") p->bEnableCtuRefSync = atobool(value);
     OPT2("log-level", "log")
     {
         p->logLevel = atoi(value);
@@ -533,11 +579,48 @@ int x265_param_parse(x265_param *p, const char *name, const char *value)
     }
     OPT("repeat-headers") p->bRepeatHeaders = atobool(value);
     OPT("wpp") p->bEnableWavefront = atobool(value);
+    OPT("slices") p->maxSlices = atoi(value);
+    OPT("tile-columns")
+    {
+        p->tileColumns = atoi(value);
+        p->tileColumnWidth[0] = 0;
+    }
+    OPT("tile-rows")
+    {
+        p->tileRows = atoi(value);
+        p->tileRowHeight[0] = 0;
+    }
+    OPT("tile-column-widths")
+    {
+        /* the last column takes the remaining width */
+        int widths[X265_MAX_TILE_COLUMNS];
+        int count = parseTileSizes(value, widths, X265_MAX_TILE_COLUMNS - 1, bError);
+        if (!bError)
+        {
+            memcpy(p->tileColumnWidth, widths, count * sizeof(int));
+            p->tileColumns = count + 1;
+        }
+    }
+    OPT("tile-row-heights")
+    {
+        int heights[X265_MAX_TILE_ROWS];
+        int count = parseTileSizes(value, heights, X265_MAX_TILE_ROWS - 1, bError);
+        if (!bError)
+        {
+            memcpy(p->tileRowHeight, heights, count * sizeof(int));
+            p->tileRows = count + 1;
+        }
+    }
+    OPT("loop-filter-across-tiles") p->bLoopFilterAcrossTiles = atobool(value);
     OPT("ctu") p->maxCUSize = (uint32_t)atoi(value);
     OPT("tu-intra-depth") p->tuQTMaxIntraDepth = (uint32_t)atoi(value);
     OPT("tu-inter-depth") p->tuQTMaxInterDepth = (uint32_t)atoi(value);
     OPT("subme") p->subpelRefine = atoi(value);
+    OPT("hpel-cache") p->bEnableHpelCache = atobool(value);
+    OPT("lowres-mvc") p->bEnableLowresMvc = atobool(value);
+    OPT("ref-early-exit") p->bEnableRefEarlyExit = atobool(value);
     OPT("merange") p->searchRange = atoi(value);
+    OPT("adaptive-merange") p->bEnableAdaptiveMeRange = atobool(value);
     OPT("rect") p->bEnableRectInter = atobool(value);
     OPT("amp") p->bEnableAMP = atobool(value);
     OPT("max-merge") p->maxNumMergeCand = (uint32_t)atoi(value);
@@ -595,6 +678,7 @@ int x265_param_parse(x265_param *p, const char *name, const char *value)
     OPT("sao-lcu-opt") p->saoLcuBasedOptimization = atoi(value);
     OPT("ssim") p->bEnableSsim = atobool(value);
     OPT("psnr") p->bEnablePsnr = atobool(value);
+    OPT("metrics-interval") p->metricsInterval = atoi(value);
     OPT("hash") p->decodedPictureHashSEI = atoi(value);
     OPT("aud") p->bEnableAccessUnitDelimiters = atobool(value);
     OPT("b-pyramid") p->bBPyramid = atobool(value);
@@ -603,6 +687,8 @@ int x265_param_parse(x265_param *p, const char *name, const char *value)
     OPT("vbv-maxrate") p->rc.vbvMaxBitrate = atoi(value);
     OPT("vbv-bufsize") p->rc.vbvBufferSize = atoi(value);
     OPT("vbv-init")    p->rc.vbvBufferInit = atof(value);
+    OPT("vbv-end")     p->rc.vbvBufferEnd = atof(value);
+    OPT("frames")      p->totalFrames = atoi(value);
     OPT("crf-max")     p->rc.rfConstantMax = atof(value);
     OPT("crf")
     {
@@ -917,6 +1003,12 @@ int x265_check_params(x265_param *param)
           "Aq-Strength is out of range");
 
     CHECK(param->bEnableWavefront < 0, "WaveFrontSynchro cannot be negative");
+    CHECK(param->maxSlices < 1 || param->maxSlices > MAX_SLICES,
+          "maxSlices (--slices) must be between 1 and 64");
+    CHECK(param->tileColumns < 1 || param->tileColumns > X265_MAX_TILE_COLUMNS,
+          "tileColumns (--tile-columns) must be between 1 and 20");
+    CHECK(param->tileRows < 1 || param->tileRows > X265_MAX_TILE_ROWS,
+          "tileRows (--tile-rows) must be between 1 and 22");
     CHECK((param->vui.aspectRatioIdc < 0
            || param->vui.aspectRatioIdc > 16)
           && param->vui.aspectRatioIdc != X265_EXTENDED_SAR,
@@ -970,6 +1062,8 @@ int x265_check_params(x265_param *param)
           "Valid penalty for 32x32 intra TU in non-I slices. 0:disabled 1:RD-penalty 2:maximum"); 
     CHECK(param->keyframeMax < -1,
           "Invalid max IDR period in frames. value should be greater than -1"); 
+    CHECK(param->metricsInterval < 1,
+          "Metrics interval must be 1 or greater");
     CHECK(param->decodedPictureHashSEI < 0 || param->decodedPictureHashSEI > 3,
           "Invalid hash option. Decoded Picture Hash SEI 0: disabled, 1: MD5, 2: CRC, 3: Checksum");
     CHECK(param->rc.vbvBufferSize < 0,
@@ -978,9 +1072,15 @@ int x265_check_params(x265_param *param)
           "Maximum local bit rate can not be less than zero");
     CHECK(param->rc.vbvBufferInit < 0,
           "Valid initial VBV buffer occupancy must be a fraction 0 - 1, or size in kbits");
+    CHECK(param->rc.vbvBufferEnd < 0,
+          "Valid final VBV buffer occupancy must be a fraction 0 - 1, or size in kbits");
+    CHECK(param->totalFrames < 0,
+          "Total frame count can not be less than zero");
     CHECK(param->rc.bitrate < 0,
           "Target bitrate can not be less than zero");
     CHECK(param->bFrameBias < 0, "Bias towards B frame decisions must be 0 or greater");
+    CHECK(param->poolWeight < 1 || param->poolWeight > 256,
+          "Thread pool weight must be between 1 and 256");
     return check_failed;
 }
 
@@ -1124,13 +1224,21 @@ char *x265_param2string(x265_param *p)
     s += sprintf(s, " %s", (param) ? cliopt : "no-"cliopt);
 
     BOOL(p->bEnableWavefront, "wpp");
+    BOOL(p->bEnableCtuRefSync, "ctu-ref-sync");
+    s += sprintf(s, " slices=%d", p->maxSlices);
+    s += sprintf(s, " tile-columns=%d tile-rows=%d", p->tileColumns, p->tileRows);
+    BOOL(p->bLoopFilterAcrossTiles, "loop-filter-across-tiles");
     s += sprintf(s, " fps=%d/%d", p->fpsNum, p->fpsDenom);
     s += sprintf(s, " ctu=%d", p->maxCUSize);
     s += sprintf(s, " tu-intra-depth=%d", p->tuQTMaxIntraDepth);
     s += sprintf(s, " tu-inter-depth=%d", p->tuQTMaxInterDepth);
     s += sprintf(s, " me=%d", p->searchMethod);
     s += sprintf(s, " subme=%d", p->subpelRefine);
+    BOOL(p->bEnableHpelCache, "hpel-cache");
+    BOOL(p->bEnableLowresMvc, "lowres-mvc");
+    BOOL(p->bEnableRefEarlyExit, "ref-early-exit");
     s += sprintf(s, " merange=%d", p->searchRange);
+    BOOL(p->bEnableAdaptiveMeRange, "adaptive-merange");
     BOOL(p->bEnableRectInter, "rect");
     BOOL(p->bEnableAMP, "amp");
     s += sprintf(s, " max-merge=%d", p->maxNumMergeCand);
@@ -723,6 +723,56 @@ void plane_copy_deinterleave_chroma(pixel *dstu, intptr_t dstuStride, pixel *dst
     }
 }
 
+/* BT.601 limited range, 8bit RGB to 8bit YUV */
+inline int rgbToY(int r, int g, int b) { return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16; }
+inline int rgbToU(int r, int g, int b) { return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128; }
+inline int rgbToV(int r, int g, int b) { return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128; }
+
+/* Packed RGB with bpp bytes per pixel, red at byte rIdx and blue at bIdx, to
+ * planar YUV. Subsampled chroma is converted from the rounded average of the
+ * RGB components of the block of pixels it covers */
+template<int bpp, int rIdx, int bIdx, int hShift, int vShift>
+void rgb2yuv_c(pixel *dsty, intptr_t dstyStride, pixel *dstu, pixel *dstv, intptr_t dstcStride,
+               const uint8_t *src, intptr_t srcStride, int w, int h)
+{
+    const int shift = X265_DEPTH - 8;
+    const int log2Count = hShift + vShift;
+    const int round = (1 << log2Count) >> 1;
+
+    for (int y = 0; y < h; y++, dsty += dstyStride)
+    {
+        const uint8_t *row = src + y * srcStride;
+        for (int x = 0; x < w; x++, row += bpp)
+        {
+            dsty[x] = (pixel)(rgbToY(row[rIdx], row[1], row[bIdx]) << shift);
+        }
+    }
+
+    for (int y = 0; y < h >> vShift; y++, dstu += dstcStride, dstv += dstcStride)
+    {
+        for (int x = 0; x < w >> hShift; x++)
+        {
+            int r = 0, g = 0, b = 0;
+            for (int j = 0; j <= vShift; j++)
+            {
+                const uint8_t *pel = src + ((y << vShift) + j) * srcStride + (x << hShift) * bpp;
+                for (int i = 0; i <= hShift; i++, pel += bpp)
+                {
+                    r += pel[rIdx];
+                    g += pel[1];
+                    b += pel[bIdx];
+                }
+            }
+
+            r = (r + round) >> log2Count;
+            g = (g + round) >> log2Count;
+            b = (b + round) >> log2Count;
+            dstu[x] = (pixel)(rgbToU(r, g, b) << shift);
+            dstv[x] = (pixel)(rgbToV(r, g, b) << shift);
+        }
+    }
+}
+
 template<int bx, int by>
 void blockcopy_pp_c(pixel *a, intptr_t stridea, pixel *b, intptr_t strideb)
 {
@@ -1112,6 +1162,15 @@ void Setup_C_PixelPrimitives(EncoderPrimitives &p)
     p.var[BLOCK_32x32] = pixel_var<32>;
     p.var[BLOCK_64x64] = pixel_var<64>;
     p.plane_copy_deinterleave_c = plane_copy_deinterleave_chroma;
+
+#define SETUP_RGB2YUV(csp, bpp, r, b) \
+    p.rgb2yuv[csp - X265_CSP_BGR][X265_CSP_I420] = rgb2yuv_c<bpp, r, b, 1, 1>; \
+    p.rgb2yuv[csp - X265_CSP_BGR][X265_CSP_I422] = rgb2yuv_c<bpp, r, b, 1, 0>; \
+    p.rgb2yuv[csp - X265_CSP_BGR][X265_CSP_I444] = rgb2yuv_c<bpp, r, b, 0, 0>;
+
+    SETUP_RGB2YUV(X265_CSP_BGR,  3, 2, 0);
+    SETUP_RGB2YUV(X265_CSP_BGRA, 4, 2, 0);
+    SETUP_RGB2YUV(X265_CSP_RGB,  3, 0, 2);
     p.planecopy_cp = planecopy_cp_c;
     p.planecopy_sp = planecopy_sp_c;
 }
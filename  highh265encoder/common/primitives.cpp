@@ -58,6 +58,7 @@ void Setup_C_DCTPrimitives(EncoderPrimitives &p);
 void Setup_C_IPFilterPrimitives(EncoderPrimitives &p);
 void Setup_C_IPredPrimitives(EncoderPrimitives &p);
 void Setup_C_LoopFilterPrimitives(EncoderPrimitives &p);
+void Setup_C_BitstreamPrimitives(EncoderPrimitives &p);
 
 void Setup_C_Primitives(EncoderPrimitives &p)
 {
@@ -66,6 +67,7 @@ void Setup_C_Primitives(EncoderPrimitives &p)
     Setup_C_IPFilterPrimitives(p);   // ipfilter.cpp
     Setup_C_IPredPrimitives(p);      // intrapred.cpp
     Setup_C_LoopFilterPrimitives(p); // loopfilter.cpp
+    Setup_C_BitstreamPrimitives(p);  // bitstream.cpp
 }
 }
 using namespace x265;
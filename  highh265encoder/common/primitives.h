@@ -89,6 +89,9 @@ enum IDcts
     NUM_IDCTS
 };
 
+// Packed RGB input color spaces, indexed by colorSpace - X265_CSP_BGR
+enum { NUM_RGB_CSPS = X265_CSP_MAX - X265_CSP_BGR };
+
 // Returns a LumaPartitions enum for the given size, always expected to return a valid enum
 inline int partitionFromSizes(int width, int height)
 {
@@ -142,6 +145,8 @@ typedef void (*ssim_4x4x2_core_t)(const pixel *pix1, intptr_t stride1, const pix
 typedef float (*ssim_end4_t)(int sum0[5][4], int sum1[5][4], int width);
 typedef uint64_t (*var_t)(pixel *pix, intptr_t stride);
 typedef void (*plane_copy_deinterleave_t)(pixel *dstu, intptr_t dstuStride, pixel *dstv, intptr_t dstvStride, pixel *src,  intptr_t srcStride, int w, int h);
+typedef void (*rgb2yuv_t)(pixel *dsty, intptr_t dstyStride, pixel *dstu, pixel *dstv, intptr_t dstcStride,
+                          const uint8_t *src, intptr_t srcStride, int w, int h);
 
 typedef void (*filter_pp_t) (pixel *src, intptr_t srcStride, pixel *dst, intptr_t dstStride, int coeffIdx);
 typedef void (*filter_hps_t) (pixel *src, intptr_t srcStride, int16_t *dst, intptr_t dstStride, int coeffIdx, int isRowExt);
@@ -164,6 +169,13 @@ typedef void (*saoCuOrgE0_t)(pixel * rec, int8_t * offsetEo, int lcuWidth, int8_
 typedef void (*planecopy_cp_t) (uint8_t *src, intptr_t srcStride, pixel *dst, intptr_t dstStride, int width, int height, int shift);
 typedef void (*planecopy_sp_t) (uint16_t *src, intptr_t srcStride, pixel *dst, intptr_t dstStride, int width, int height, int shift, uint16_t mask);
 
+typedef uint32_t (*nal_escape_t)(uint8_t *dst, const uint8_t *src, uint32_t size);
+typedef uint32_t (*nal_count_escapes_t)(const uint8_t *src, uint32_t size);
+
+/* bitmask of the positions within a block of src which follow two zero bytes
+ * and are <= 0x03, src[-2] and src[-1] must be readable */
+typedef uint32_t (*nal_escape_candidates_t)(const uint8_t *src);
+
 /* Define a structure containing function pointers to optimized encoder
  * primitives.  Each pointer can reference either an assembly routine,
  * a vectorized primitive, or a C function. */
@@ -230,12 +242,17 @@ struct EncoderPrimitives
 
     downscale_t     frame_init_lowres_core;
     plane_copy_deinterleave_t plane_copy_deinterleave_c;
+    rgb2yuv_t       rgb2yuv[NUM_RGB_CSPS][X265_CSP_COUNT]; // 8bit packed RGB input to internal csp
     extendCURowBorder_t extendRowBorder;
     // sao primitives
     saoCuOrgE0_t      saoCuOrgE0;
     planecopy_cp_t    planecopy_cp;
     planecopy_sp_t    planecopy_sp;
 
+    // NAL serialization, emulation prevention
+    nal_escape_t        nal_escape;
+    nal_count_escapes_t nal_count_escapes;
+
     struct
     {
         filter_pp_t     filter_vpp[NUM_LUMA_PARTITIONS];
@@ -256,6 +273,10 @@ struct EncoderPrimitives
 
 void extendPicBorder(pixel* recon, int stride, int width, int height, int marginX, int marginY);
 
+/* the emulation prevention of nal_escape and nal_count_escapes, vectorized by
+ * the escape candidates search of each block, see common/bitstream.cpp */
+uint32_t nalEscapeBlocks(uint8_t *dst, const uint8_t *src, uint32_t size, nal_escape_candidates_t candidates, uint32_t blockSize);
+
 /* This copy of the table is what gets used by the encoder.
  * It must be initialized before the encoder begins. */
 extern EncoderPrimitives primitives;
@@ -56,7 +56,13 @@
 #define ATOMIC_CAS32(ptr, oldval, newval)   __sync_val_compare_and_swap(ptr, oldval, newval)
 #define ATOMIC_INC(ptr)                     __sync_add_and_fetch((volatile int32_t*)ptr, 1)
 #define ATOMIC_DEC(ptr)                     __sync_add_and_fetch((volatile int32_t*)ptr, -1)
+#define ATOMIC_ADD(ptr, val)                __sync_add_and_fetch(ptr, val)
 #define GIVE_UP_TIME()                      usleep(0)
+#if X265_ARCH_X86
+#define CPU_PAUSE()                         __asm__ __volatile__ ("pause" ::: "memory")
+#else
+#define CPU_PAUSE()                         __asm__ __volatile__ ("" ::: "memory")
+#endif
 
 #elif defined(_MSC_VER)                 /* Windows atomic intrinsics */
 
@@ -109,7 +115,9 @@ inline int _BitScanForward64(DWORD *id, uint64_t x64) // fake 64bit CLZ
 #define ATOMIC_CAS32(ptr, oldval, newval)   (uint64_t)_InterlockedCompareExchange((volatile LONG*)ptr, newval, oldval)
 #define ATOMIC_INC(ptr)                     InterlockedIncrement((volatile LONG*)ptr)
 #define ATOMIC_DEC(ptr)                     InterlockedDecrement((volatile LONG*)ptr)
+#define ATOMIC_ADD(ptr, val)                InterlockedExchangeAdd64((volatile LONG64*)ptr, val)
 #define GIVE_UP_TIME()                      Sleep(0)
+#define CPU_PAUSE()                         YieldProcessor()
 
 #endif // ifdef __GNUC__
 
@@ -117,6 +125,11 @@ inline int _BitScanForward64(DWORD *id, uint64_t x64) // fake 64bit CLZ
 namespace x265 {
 // x265 private namespace
 
+/* Number of times a short-lived wait polls its condition before blocking on
+ * the OS. Waits which are expected to last longer than a context switch
+ * should block immediately */
+#define X265_SPIN_COUNT 1000
+
 #ifdef _WIN32
 
 typedef HANDLE ThreadHandle;
@@ -207,13 +220,18 @@ public:
         XP_CONDITION_VAR_FREE(&m_cv);
     }
 
-    int waitForChange(int prev)
+    /* Poll up to spinCount times for the value to change before blocking */
+    int waitForChange(int prev, int spinCount = 0)
     {
+        for (int i = 0; i < spinCount && m_val == prev; i++)
+            CPU_PAUSE();
+
         EnterCriticalSection(&m_cs);
         if (m_val == prev)
             SleepConditionVariableCS(&m_cv, &m_cs, INFINITE);
+        int ret = m_val;
         LeaveCriticalSection(&m_cs);
-        return m_val;
+        return ret;
     }
 
     int get()
@@ -244,7 +262,7 @@ protected:
 
     CRITICAL_SECTION   m_cs;
     CONDITION_VARIABLE m_cv;
-    int                m_val;
+    volatile int       m_val;
 };
 
 #else /* POSIX / pthreads */
@@ -383,13 +401,18 @@ public:
         pthread_mutex_destroy(&m_mutex);
     }
 
-    int waitForChange(int prev)
+    /* Poll up to spinCount times for the value to change before blocking */
+    int waitForChange(int prev, int spinCount = 0)
     {
+        for (int i = 0; i < spinCount && m_val == prev; i++)
+            CPU_PAUSE();
+
         pthread_mutex_lock(&m_mutex);
         if (m_val == prev)
             pthread_cond_wait(&m_cond, &m_mutex);
+        int ret = m_val;
         pthread_mutex_unlock(&m_mutex);
-        return m_val;
+        return ret;
     }
 
     int get()
@@ -420,7 +443,7 @@ protected:
 
     pthread_mutex_t m_mutex;
     pthread_cond_t  m_cond;
-    int             m_val;
+    volatile int    m_val;
 };
 
 #endif // ifdef _WIN32
@@ -34,11 +34,66 @@
 #include <sys/sysctl.h>
 #endif
 
+#if HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
 namespace x265 {
 // x265 private namespace
 
 class ThreadPoolImpl;
 
+/* Worker time is charged to clients in units of 1/65536 us times the inverse
+ * of their weight. A client is favored while it trails the client with the
+ * least charged time by less than the equivalent of 2ms of worker time */
+#define CLIENT_TIME_SHIFT 16
+#define CLIENT_TIME_SLACK (2000LL << CLIENT_TIME_SHIFT)
+
+class PoolClient : public ThreadPool
+{
+private:
+
+    ThreadPoolImpl &m_pool;
+
+    PoolClient& operator =(const PoolClient&);
+
+    virtual ~PoolClient() {}
+
+public:
+
+    int64_t          m_timeScale;    // charge per microsecond of worker time
+
+    volatile int64_t m_time;         // charged worker time
+
+    int              m_numProviders; // enqueued providers, under the pool's write lock
+
+    PoolClient(ThreadPoolImpl& pool, int weight);
+
+    void charge(int64_t elapsed)     { ATOMIC_ADD(&m_time, elapsed * m_timeScale); }
+
+    void enqueueJobProvider(JobProvider &);
+
+    void dequeueJobProvider(JobProvider &);
+
+    void flushProviderList();
+
+    void pokeIdleThread(int node);
+
+    ThreadPool *attachClient(int weight);
+
+    void release();
+
+    int getThreadCount() const;
+
+    int getNodeCount() const;
+
+    bool isNumaBound() const;
+
+    int64_t getIdleWaitTime();
+
+    int64_t getFlushWaitTime();
+};
+
 class PoolThread : public Thread
 {
 private:
@@ -49,7 +104,9 @@ private:
 
     int            m_id;
 
-    bool           m_dirty;
+    int            m_node;
+
+    volatile bool  m_dirty;
 
     bool           m_exited;
 
@@ -57,9 +114,10 @@ private:
 
 public:
 
-    PoolThread(ThreadPoolImpl& pool, int id)
+    PoolThread(ThreadPoolImpl& pool, int id, int node)
         : m_pool(pool)
         , m_id(id)
+        , m_node(node)
         , m_dirty(false)
         , m_exited(false)
     {
@@ -69,6 +127,8 @@ public:
 
     void markDirty()      { m_dirty = true; }
 
+    void clearDirty()     { m_dirty = false; }
+
     bool isExited() const { return m_exited; }
 
     void poke()           { m_wakeEvent.trigger(); }
@@ -83,18 +143,37 @@ class ThreadPoolImpl : public ThreadPool
 private:
 
     bool         m_ok;
-    int          m_referenceCount;
+    volatile int32_t m_referenceCount;
     int          m_numThreads;
     int          m_numSleepMapWords;
+    int          m_numNodes;
+    bool         m_bNumaBound;
     PoolThread  *m_threads;
     volatile uint64_t *m_sleepMap;
 
+    /* per worker group masks of the sleep bitmap, m_numSleepMapWords
+     * words for each node */
+    uint64_t    *m_nodeSleepMask;
+
     /* Lock for write access to the provider lists.  Threads are
      * always allowed to read m_firstProvider and follow the
      * linked list.  Providers must zero their m_nextProvider
      * pointers before removing themselves from this list */
     Lock         m_writeLock;
 
+    /* Incremented when a worker thread goes to sleep while another thread is
+     * waiting for all workers to become idle (m_numStateWaiters > 0), and
+     * when a worker finishes a pass through the provider list after it was
+     * marked dirty. Threads in waitForAllIdle() and FlushProviderList()
+     * block on it */
+    ThreadSafeInteger m_stateChange;
+    volatile int32_t  m_numStateWaiters;
+
+    /* wall time (us) spent in waitForAllIdle() and FlushProviderList() */
+    Lock         m_waitTimeLock;
+    int64_t      m_idleWaitTime;
+    int64_t      m_flushWaitTime;
+
 public:
 
     static ThreadPoolImpl *instance;
@@ -104,23 +183,33 @@ public:
 
 public:
 
-    ThreadPoolImpl(int numthreads);
+    ThreadPoolImpl(int numthreads, int numNodes);
 
     virtual ~ThreadPoolImpl();
 
     ThreadPoolImpl *AddReference()
     {
-        m_referenceCount++;
+        ATOMIC_INC(&m_referenceCount);
 
         return this;
     }
 
     void markThreadAsleep(int id);
 
+    void markThreadClean(PoolThread& thread);
+
     void waitForAllIdle();
 
     int getThreadCount() const { return m_numThreads; }
 
+    int getNodeCount() const   { return m_numNodes; }
+
+    bool isNumaBound() const   { return m_bNumaBound; }
+
+    int64_t getIdleWaitTime()  { ScopedLock l(m_waitTimeLock); return m_idleWaitTime; }
+
+    int64_t getFlushWaitTime() { ScopedLock l(m_waitTimeLock); return m_flushWaitTime; }
+
     void release();
 
     void Stop();
@@ -136,9 +225,19 @@ public:
 
     void FlushProviderList();
 
-    void pokeIdleThread();
+    void flushProviderList() { FlushProviderList(); }
+
+    void pokeIdleThread(int node);
+
+    ThreadPool *attachClient(int weight);
+
+    bool getClientTimeLimit(int64_t& limit);
 };
 
+/* Protects ThreadPoolImpl::instance, so encoders may be opened and closed
+ * concurrently */
+static Lock s_instanceLock;
+
 void PoolThread::threadMain()
 {
 #if _WIN32
@@ -147,22 +246,44 @@ void PoolThread::threadMain()
     __attribute__((unused)) int val = nice(10);
 #endif
 
+    if (m_pool.isNumaBound())
+        setThreadNodeAffinity(m_node);
+
     while (m_pool.IsValid())
     {
-        /* Walk list of job providers, looking for work */
-        JobProvider *cur = m_pool.m_firstProvider;
-        while (cur)
+        /* Walk list of job providers in priority order, looking for work.
+         * Providers bound to another worker group are skipped. When several
+         * clients share the pool, a first pass only visits the providers of
+         * clients which are not ahead of their share of worker time */
+        JobProvider *cur = NULL;
+        int64_t limit = 0;
+        int pass = m_pool.getClientTimeLimit(limit) ? 0 : 1;
+        for (; pass < 2 && !cur; pass++)
         {
-            // FindJob() may perform actual work and return true.  If
-            // it does we restart the job search
-            if (cur->findJob() == true)
-                break;
+            int64_t startTime = x265_mdate();
 
-            cur = cur->m_nextProvider;
+            cur = m_pool.m_firstProvider;
+            while (cur)
+            {
+                // FindJob() may perform actual work and return true.  If
+                // it does we restart the job search from the highest priority
+                // provider
+                if ((cur->m_node < 0 || cur->m_node == m_node) &&
+                    (pass || !cur->m_client || cur->m_client->m_time <= limit) &&
+                    cur->findJob() == true)
+                {
+                    if (cur->m_client)
+                        cur->m_client->charge(x265_mdate() - startTime);
+                    break;
+                }
+
+                cur = cur->m_nextProvider;
+            }
         }
 
         // this thread has reached the end of the provider list
-        m_dirty = false;
+        if (m_dirty)
+            m_pool.markThreadClean(*this);
 
         if (cur == NULL)
         {
@@ -180,19 +301,32 @@ void ThreadPoolImpl::markThreadAsleep(int id)
     uint64_t bit = 1LL << (id & 63);
 
     ATOMIC_OR(&m_sleepMap[word], bit);
+
+    // ATOMIC_OR is a full barrier, either the waiter sees our sleep bit or
+    // we see the waiter count
+    if (m_numStateWaiters)
+        m_stateChange.incr();
+}
+
+void ThreadPoolImpl::markThreadClean(PoolThread& thread)
+{
+    thread.clearDirty();
+    m_stateChange.incr();
 }
 
-void ThreadPoolImpl::pokeIdleThread()
+void ThreadPoolImpl::pokeIdleThread(int node)
 {
     /* Find a bit in the sleeping thread bitmap and poke it awake, do
      * not give up until a thread is awakened or all of them are awake */
+    const uint64_t *nodeMask = node >= 0 && node < m_numNodes ? m_nodeSleepMask + node * m_numSleepMapWords : NULL;
     for (int i = 0; i < m_numSleepMapWords; i++)
     {
+        uint64_t mask = nodeMask ? nodeMask[i] : ~0ULL;
         uint64_t oldval = m_sleepMap[i];
-        while (oldval)
+        while (oldval & mask)
         {
             unsigned long id;
-            CTZ64(id, oldval);
+            CTZ64(id, oldval & mask);
 
             uint64_t newval = oldval & ~(1LL << id);
             if (ATOMIC_CAS(&m_sleepMap[i], oldval, newval) == oldval)
@@ -209,15 +343,35 @@ void ThreadPoolImpl::pokeIdleThread()
 ThreadPoolImpl *ThreadPoolImpl::instance;
 
 /* static */
-ThreadPool *ThreadPool::allocThreadPool(int numthreads)
+ThreadPool *ThreadPool::allocThreadPool(int numthreads, int numNodes)
 {
+    ScopedLock l(s_instanceLock);
+
     if (ThreadPoolImpl::instance)
+    {
+        if (numNodes > 1 && numNodes != ThreadPoolImpl::instance->getNodeCount())
+            x265_log(NULL, X265_LOG_WARNING, "thread pool already allocated with %d NUMA node groups, ignoring request for %d\n",
+                     ThreadPoolImpl::instance->getNodeCount(), numNodes);
         return ThreadPoolImpl::instance->AddReference();
+    }
 
-    ThreadPoolImpl::instance = new ThreadPoolImpl(numthreads);
+    ThreadPoolImpl::instance = new ThreadPoolImpl(numthreads, numNodes);
     return ThreadPoolImpl::instance;
 }
 
+/* static */
+ThreadPool *ThreadPool::createThreadPool(int numthreads, int numNodes)
+{
+    ThreadPoolImpl *pool = new ThreadPoolImpl(numthreads, numNodes);
+    if (!pool->IsValid())
+    {
+        pool->release();
+        return NULL;
+    }
+
+    return pool;
+}
+
 ThreadPool *ThreadPool::getThreadPool()
 {
     assert(ThreadPoolImpl::instance);
@@ -226,42 +380,144 @@ ThreadPool *ThreadPool::getThreadPool()
 
 void ThreadPoolImpl::release()
 {
-    if (--m_referenceCount == 0)
     {
-        assert(this == ThreadPoolImpl::instance);
-        ThreadPoolImpl::instance = NULL;
-        this->Stop();
-        delete this;
+        // the global pool must not be handed out while it is being destroyed
+        ScopedLock l(s_instanceLock);
+
+        if (ATOMIC_DEC(&m_referenceCount) != 0)
+            return;
+
+        if (this == ThreadPoolImpl::instance)
+            ThreadPoolImpl::instance = NULL;
+    }
+
+    this->Stop();
+    delete this;
+}
+
+ThreadPool *ThreadPoolImpl::attachClient(int weight)
+{
+    AddReference();
+    return new PoolClient(*this, weight);
+}
+
+/* Returns false unless providers of more than one client are enqueued, else
+ * the charged time up to which clients are favored by worker threads */
+bool ThreadPoolImpl::getClientTimeLimit(int64_t& limit)
+{
+    PoolClient *first = NULL;
+    bool bShared = false;
+    int64_t minTime = 0;
+
+    for (JobProvider *p = m_firstProvider; p; p = p->m_nextProvider)
+    {
+        PoolClient *client = p->m_client;
+        if (!client)
+            continue;
+
+        int64_t time = client->m_time;
+        if (!first)
+        {
+            first = client;
+            minTime = time;
+        }
+        else
+        {
+            bShared |= client != first;
+            minTime = X265_MIN(minTime, time);
+        }
     }
+
+    limit = minTime + CLIENT_TIME_SLACK;
+    return bShared;
+}
+
+PoolClient::PoolClient(ThreadPoolImpl& pool, int weight)
+    : m_pool(pool)
+    , m_time(0)
+    , m_numProviders(0)
+{
+    weight = Clip3(1, (int)MAX_CLIENT_WEIGHT, weight);
+    m_timeScale = (1LL << CLIENT_TIME_SHIFT) / weight;
+}
+
+void PoolClient::enqueueJobProvider(JobProvider &p)
+{
+    p.m_client = this;
+    m_pool.enqueueJobProvider(p);
+}
+
+void PoolClient::dequeueJobProvider(JobProvider &p)
+{
+    m_pool.dequeueJobProvider(p);
 }
 
-ThreadPoolImpl::ThreadPoolImpl(int numThreads)
+void PoolClient::flushProviderList()       { m_pool.FlushProviderList(); }
+
+void PoolClient::pokeIdleThread(int node)  { m_pool.pokeIdleThread(node); }
+
+ThreadPool *PoolClient::attachClient(int weight) { return m_pool.attachClient(weight); }
+
+int PoolClient::getThreadCount() const     { return m_pool.getThreadCount(); }
+
+int PoolClient::getNodeCount() const       { return m_pool.getNodeCount(); }
+
+bool PoolClient::isNumaBound() const       { return m_pool.isNumaBound(); }
+
+int64_t PoolClient::getIdleWaitTime()      { return m_pool.getIdleWaitTime(); }
+
+int64_t PoolClient::getFlushWaitTime()     { return m_pool.getFlushWaitTime(); }
+
+void PoolClient::release()
+{
+    ThreadPoolImpl &pool = m_pool;
+
+    delete this;
+    pool.release();
+}
+
+ThreadPoolImpl::ThreadPoolImpl(int numThreads, int numNodes)
     : m_ok(false)
     , m_referenceCount(1)
+    , m_numStateWaiters(0)
+    , m_idleWaitTime(0)
+    , m_flushWaitTime(0)
     , m_firstProvider(NULL)
     , m_lastProvider(NULL)
 {
     if (numThreads == 0)
         numThreads = getCpuCount();
+
+    // every worker group must have at least one thread
+    m_numNodes = X265_MIN(X265_MAX(numNodes, 1), numThreads);
+    m_bNumaBound = m_numNodes > 1 && m_numNodes <= getNumaNodeCount();
+
     m_numSleepMapWords = (numThreads + 63) >> 6;
     m_sleepMap = X265_MALLOC(uint64_t, m_numSleepMapWords);
+    m_nodeSleepMask = X265_MALLOC(uint64_t, m_numSleepMapWords * m_numNodes);
 
     char *buffer = (char*)X265_MALLOC(PoolThread, numThreads);
     m_threads = reinterpret_cast<PoolThread*>(buffer);
     m_numThreads = numThreads;
 
-    if (m_threads && m_sleepMap)
+    if (m_threads && m_sleepMap && m_nodeSleepMask)
     {
         for (int i = 0; i < m_numSleepMapWords; i++)
         {
             m_sleepMap[i] = 0;
         }
 
+        memset(m_nodeSleepMask, 0, sizeof(uint64_t) * m_numSleepMapWords * m_numNodes);
+
         m_ok = true;
         int i;
         for (i = 0; i < numThreads; i++)
         {
-            new (buffer)PoolThread(*this, i);
+            // threads are divided into contiguous, evenly sized node groups
+            int node = i * m_numNodes / numThreads;
+            m_nodeSleepMask[node * m_numSleepMapWords + (i >> 6)] |= 1ULL << (i & 63);
+
+            new (buffer)PoolThread(*this, i, node);
             buffer += sizeof(PoolThread);
             if (!m_threads[i].start())
             {
@@ -291,21 +547,26 @@ void ThreadPoolImpl::waitForAllIdle()
     if (!m_ok)
         return;
 
+    int64_t startTime = x265_mdate();
+    ATOMIC_INC(&m_numStateWaiters);
+
     int id = 0;
-    do
+    for (;;)
     {
-        int word = id >> 6;
-        uint64_t bit = 1LL << (id & 63);
-        if (m_sleepMap[word] & bit)
-        {
+        int state = m_stateChange.get();
+        while (id < m_numThreads && (m_sleepMap[id >> 6] & (1LL << (id & 63))))
             id++;
-        }
-        else
-        {
-            GIVE_UP_TIME();
-        }
+
+        if (id == m_numThreads)
+            break;
+
+        m_stateChange.waitForChange(state, X265_SPIN_COUNT);
     }
-    while (id < m_numThreads);
+
+    ATOMIC_DEC(&m_numStateWaiters);
+
+    ScopedLock l(m_waitTimeLock);
+    m_idleWaitTime += x265_mdate() - startTime;
 }
 
 void ThreadPoolImpl::Stop()
@@ -327,6 +588,7 @@ void ThreadPoolImpl::Stop()
 ThreadPoolImpl::~ThreadPoolImpl()
 {
     X265_FREE((void*)m_sleepMap);
+    X265_FREE(m_nodeSleepMask);
 
     if (m_threads)
     {
@@ -345,12 +607,53 @@ void ThreadPoolImpl::enqueueJobProvider(JobProvider &p)
     // only one list writer at a time
     ScopedLock l(m_writeLock);
 
-    p.m_nextProvider = NULL;
-    p.m_prevProvider = m_lastProvider;
-    m_lastProvider = &p;
+    PoolClient *client = p.m_client;
+    if (client && !client->m_numProviders++)
+    {
+        /* A client which had no work queued gets no credit for the time it
+         * was idle, it resumes level with the least served client */
+        int64_t minTime = client->m_time;
+        bool bFound = false;
+        for (JobProvider *cur = m_firstProvider; cur; cur = cur->m_nextProvider)
+        {
+            if (cur->m_client && cur->m_client != client)
+            {
+                int64_t time = cur->m_client->m_time;
+                minTime = bFound ? X265_MIN(minTime, time) : time;
+                bFound = true;
+            }
+        }
 
-    if (p.m_prevProvider)
-        p.m_prevProvider->m_nextProvider = &p;
+        int64_t oldTime = client->m_time;
+        while (bFound && oldTime < minTime)
+        {
+            int64_t prevTime = ATOMIC_CAS(&client->m_time, oldTime, minTime);
+            if (prevTime == oldTime)
+                break;
+            oldTime = prevTime;
+        }
+    }
+
+    /* The provider list is kept sorted by priority. A new provider is inserted
+     * after all providers of equal or higher priority, so providers of the same
+     * priority are serviced in enqueue order (older frames before newer) */
+    JobProvider *prev = m_lastProvider;
+    while (prev && prev->m_priority > p.m_priority)
+        prev = prev->m_prevProvider;
+
+    JobProvider *next = prev ? prev->m_nextProvider : m_firstProvider;
+
+    // fully link the new node before making it visible to worker threads
+    p.m_nextProvider = next;
+    p.m_prevProvider = prev;
+
+    if (next)
+        next->m_prevProvider = &p;
+    else
+        m_lastProvider = &p;
+
+    if (prev)
+        prev->m_nextProvider = &p;
     else
         m_firstProvider = &p;
 }
@@ -360,6 +663,10 @@ void ThreadPoolImpl::dequeueJobProvider(JobProvider &p)
     // only one list writer at a time
     ScopedLock l(m_writeLock);
 
+    bool bQueued = p.m_nextProvider || p.m_prevProvider || m_firstProvider == &p;
+    if (bQueued && p.m_client)
+        p.m_client->m_numProviders--;
+
     // update pool entry pointers first
     if (m_firstProvider == &p)
         m_firstProvider = p.m_nextProvider;
@@ -382,40 +689,45 @@ void ThreadPoolImpl::dequeueJobProvider(JobProvider &p)
  * dequeued providers are safe for deletion. */
 void ThreadPoolImpl::FlushProviderList()
 {
+    int64_t startTime = x265_mdate();
+
     for (int i = 0; i < m_numThreads; i++)
     {
         m_threads[i].markDirty();
         m_threads[i].poke();
     }
 
-    int i;
-    do
+    int i = 0;
+    for (;;)
     {
-        for (i = 0; i < m_numThreads; i++)
-        {
-            if (m_threads[i].isDirty())
-            {
-                GIVE_UP_TIME();
-                break;
-            }
-        }
+        int state = m_stateChange.get();
+        while (i < m_numThreads && !m_threads[i].isDirty())
+            i++;
+
+        if (i == m_numThreads)
+            break;
+
+        m_stateChange.waitForChange(state, X265_SPIN_COUNT);
     }
-    while (i < m_numThreads);
+
+    ScopedLock l(m_waitTimeLock);
+    m_flushWaitTime += x265_mdate() - startTime;
 }
 
 void JobProvider::flush()
 {
     if (m_nextProvider || m_prevProvider)
         dequeue();
-    dynamic_cast<ThreadPoolImpl*>(m_pool)->FlushProviderList();
+    m_pool->flushProviderList();
 }
 
 void JobProvider::enqueue()
 {
-    // Add this provider to the end of the thread pool's job provider list
+    // Add this provider to the thread pool's job provider list, behind all
+    // providers of the same or higher priority
     assert(!m_nextProvider && !m_prevProvider && m_pool);
     m_pool->enqueueJobProvider(*this);
-    m_pool->pokeIdleThread();
+    m_pool->pokeIdleThread(m_node);
 }
 
 void JobProvider::dequeue()
@@ -423,7 +735,7 @@ void JobProvider::dequeue()
     // Remove this provider from the thread pool's job provider list
     m_pool->dequeueJobProvider(*this);
     // Ensure no jobs were missed while the provider was being removed
-    m_pool->pokeIdleThread();
+    m_pool->pokeIdleThread(m_node);
 }
 
 int getCpuCount()
@@ -456,4 +768,23 @@ int getCpuCount()
     return 2; // default to 2 threads, everywhere else
 #endif // if _WIN32
 }
+
+int getNumaNodeCount()
+{
+#if HAVE_LIBNUMA
+    if (numa_available() >= 0)
+        return X265_MAX(numa_max_node() + 1, 1);
+#endif
+    return 1;
+}
+
+void setThreadNodeAffinity(int node)
+{
+#if HAVE_LIBNUMA
+    if (numa_available() >= 0)
+        numa_run_on_node(node);
+#else
+    (void)node;
+#endif
+}
 } // end namespace x265
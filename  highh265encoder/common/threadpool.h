@@ -32,9 +32,16 @@ namespace x265 {
 // x265 private namespace
 
 class ThreadPool;
+class PoolClient;
 
 int getCpuCount();
 
+// Returns the number of NUMA nodes in the system, 1 if unknown
+int getNumaNodeCount();
+
+// Restrict the calling thread to the CPUs of the given NUMA node
+void setThreadNodeAffinity(int node);
+
 // Any class that wants to distribute work to the thread pool must
 // derive from JobProvider and implement FindJob().
 class JobProvider
@@ -46,14 +53,44 @@ protected:
     JobProvider  *m_nextProvider;
     JobProvider  *m_prevProvider;
 
+    // Scheduling priority, lower values are serviced first by worker threads.
+    // Providers of equal priority are serviced in the order they were enqueued
+    int           m_priority;
+
+    // Worker group (NUMA node) which services this provider, -1 for any
+    int           m_node;
+
+    // Pool client the provider was enqueued through, which is charged the
+    // worker time spent in its jobs. NULL if enqueued on the pool directly
+    PoolClient   *m_client;
+
 public:
 
-    JobProvider(ThreadPool *p) : m_pool(p), m_nextProvider(0), m_prevProvider(0) {}
+    // Provider priorities. The lookahead gates the frame encoders so its cost
+    // estimates always take precedence over CTU row encodes
+    enum
+    {
+        PRIORITY_LOOKAHEAD = 0,
+        PRIORITY_FRAME     = 1,
+        PRIORITY_LOW       = 2,
+    };
+
+    JobProvider(ThreadPool *p) : m_pool(p), m_nextProvider(0), m_prevProvider(0), m_priority(PRIORITY_FRAME), m_node(-1), m_client(0) {}
 
     virtual ~JobProvider() {}
 
     void setThreadPool(ThreadPool *p) { m_pool = p; }
 
+    // May only be called while the provider is not enqueued
+    void setPriority(int priority)    { m_priority = priority; }
+
+    int  getPriority() const          { return m_priority; }
+
+    // May only be called while the provider is not enqueued
+    void setNode(int node)            { m_node = node; }
+
+    int  getNode() const              { return m_node; }
+
     // Register this job provider with the thread pool, jobs are available
     void enqueue();
 
@@ -71,12 +108,14 @@ public:
 
     friend class ThreadPoolImpl;
     friend class PoolThread;
+    friend class PoolClient;
 };
 
 // Abstract interface to ThreadPool.  Each encoder instance should call
-// AllocThreadPool() to get a handle to the singleton object and then make
-// it available to their job provider structures (wave-front frame encoders,
-// etc).
+// AllocThreadPool() to get a handle to the singleton object, or be given a
+// pool created by CreateThreadPool(), and attach itself as a client of the
+// pool. The client handle is then made available to their job provider
+// structures (wave-front frame encoders, etc).
 class ThreadPool
 {
 protected:
@@ -88,15 +127,40 @@ protected:
 
     virtual void dequeueJobProvider(JobProvider &) = 0;
 
+    // Ensure all threads have made a full pass through the provider list
+    virtual void flushProviderList() = 0;
+
 public:
 
-    // When numthreads == 0, a default thread count is used. A request may grow
-    // an existing pool but it will never shrink.
-    static ThreadPool *allocThreadPool(int numthreads = 0);
+    // Largest client weight accepted by attachClient()
+    enum { MAX_CLIENT_WEIGHT = 256 };
+
+    // Returns a reference to the process global pool, creating it on the first
+    // call. When numthreads == 0, a default thread count is used. When
+    // numNodes > 1 the worker threads are split into that many groups, one
+    // per NUMA node. Groups are bound to their node's CPUs if the system has
+    // at least numNodes nodes. Once the pool exists, later calls get the pool
+    // as it is and their numthreads and numNodes are ignored, with a warning
+    // if they asked for a different NUMA node count
+    static ThreadPool *allocThreadPool(int numthreads = 0, int numNodes = 0);
+
+    // Create a pool which is separate from the process global pool returned
+    // by allocThreadPool(), with one reference held by the caller. Returns
+    // NULL if the worker threads could not be started
+    static ThreadPool *createThreadPool(int numthreads = 0, int numNodes = 0);
 
     static ThreadPool *getThreadPool();
 
-    virtual void pokeIdleThread() = 0;
+    // Returns a handle to this pool for one encoder. When several clients
+    // have jobs queued, worker threads favor the job providers of the client
+    // which has received the least worker time relative to its weight, so a
+    // large encode cannot starve smaller ones. The handle holds a reference
+    // on the pool and must be released
+    virtual ThreadPool *attachClient(int weight = 1) = 0;
+
+    // Wake a sleeping worker thread of the given worker group, or of any
+    // group if node is negative
+    virtual void pokeIdleThread(int node = -1) = 0;
 
     // The pool is reference counted so all calls to AllocThreadPool() should be
     // followed by a call to Release()
@@ -104,6 +168,18 @@ public:
 
     virtual int  getThreadCount() const = 0;
 
+    // Number of worker groups, 1 unless the pool was split per NUMA node
+    virtual int  getNodeCount() const = 0;
+
+    // True if worker groups are bound to the CPUs of their NUMA node
+    virtual bool isNumaBound() const = 0;
+
+    // Wall time in microseconds callers have spent blocked waiting for all
+    // worker threads to become idle, and for provider list flushes
+    virtual int64_t getIdleWaitTime() = 0;
+
+    virtual int64_t getFlushWaitTime() = 0;
+
     friend class JobProvider;
 };
 } // end namespace x265
@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * Copyright (C) 2013 x265 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@multicorewareinc.com.
+ *****************************************************************************/
+
+#include "primitives.h"
+#include <emmintrin.h> // SSE2
+
+namespace {
+// bitmask of the positions within src[0..15] which follow two zero bytes and
+// are <= 0x03. src[-2] and src[-1] must be readable
+uint32_t escapeCandidates(const uint8_t *src)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i three = _mm_set1_epi8(3);
+
+    __m128i cur = _mm_loadu_si128((__m128i const*)src);
+    __m128i z2 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(src - 2)), zero);
+    __m128i z1 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(src - 1)), zero);
+    __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(cur, three), cur);
+
+    return (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(z2, z1), low));
+}
+
+uint32_t nalEscape(uint8_t *dst, const uint8_t *src, uint32_t size)
+{
+    return x265::nalEscapeBlocks(dst, src, size, escapeCandidates, 16);
+}
+
+uint32_t nalCountEscapes(const uint8_t *src, uint32_t size)
+{
+    return x265::nalEscapeBlocks(NULL, src, size, escapeCandidates, 16) - size;
+}
+}
+
+namespace x265 {
+void Setup_Vec_BitstreamPrimitives_sse2(EncoderPrimitives &p)
+{
+    p.nal_escape = nalEscape;
+    p.nal_count_escapes = nalCountEscapes;
+}
+}
@@ -0,0 +1,295 @@
+/*****************************************************************************
+ * Copyright (C) 2013 x265 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@multicorewareinc.com.
+ *****************************************************************************/
+
+#include "primitives.h"
+#include <emmintrin.h> // SSE2
+#include <tmmintrin.h> // SSSE3
+
+namespace {
+// Input colorspace conversions: semi-planar chroma deinterleave and packed
+// RGB to planar YUV. Both must match the C references in pixel.cpp exactly
+
+#if HIGH_BIT_DEPTH
+void planeCopyDeinterleave(pixel *dstu, intptr_t dstuStride, pixel *dstv, intptr_t dstvStride,
+                           pixel *src, intptr_t srcStride, int w, int h)
+{
+    for (int y = 0; y < h; y++, dstu += dstuStride, dstv += dstvStride, src += srcStride)
+    {
+        int x = 0;
+        for (; x + 8 <= w; x += 8)
+        {
+            // u0 v0 u1 v1 u2 v2 u3 v3 -> u0 u1 u2 u3 v0 v1 v2 v3
+            __m128i a = _mm_loadu_si128((__m128i const*)(src + 2 * x));
+            __m128i b = _mm_loadu_si128((__m128i const*)(src + 2 * x + 8));
+            a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+            b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+            a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+            b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+
+            _mm_storeu_si128((__m128i*)(dstu + x), _mm_unpacklo_epi64(a, b));
+            _mm_storeu_si128((__m128i*)(dstv + x), _mm_unpackhi_epi64(a, b));
+        }
+
+        for (; x < w; x++)
+        {
+            dstu[x] = src[2 * x];
+            dstv[x] = src[2 * x + 1];
+        }
+    }
+}
+
+#else // if HIGH_BIT_DEPTH
+void planeCopyDeinterleave(pixel *dstu, intptr_t dstuStride, pixel *dstv, intptr_t dstvStride,
+                           pixel *src, intptr_t srcStride, int w, int h)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0xff);
+
+    for (int y = 0; y < h; y++, dstu += dstuStride, dstv += dstvStride, src += srcStride)
+    {
+        int x = 0;
+        for (; x + 16 <= w; x += 16)
+        {
+            __m128i a = _mm_loadu_si128((__m128i const*)(src + 2 * x));
+            __m128i b = _mm_loadu_si128((__m128i const*)(src + 2 * x + 16));
+            __m128i u = _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes));
+            __m128i v = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+
+            _mm_storeu_si128((__m128i*)(dstu + x), u);
+            _mm_storeu_si128((__m128i*)(dstv + x), v);
+        }
+
+        for (; x < w; x++)
+        {
+            dstu[x] = src[2 * x];
+            dstv[x] = src[2 * x + 1];
+        }
+    }
+}
+
+#endif // if HIGH_BIT_DEPTH
+
+inline int rgbToY(int r, int g, int b) { return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16; }
+inline int rgbToU(int r, int g, int b) { return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128; }
+inline int rgbToV(int r, int g, int b) { return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128; }
+
+// store 16 8bit samples, held in two vectors of 16bit lanes
+inline void storeSamples(pixel *dst, __m128i lo, __m128i hi)
+{
+#if HIGH_BIT_DEPTH
+    _mm_storeu_si128((__m128i*)dst, _mm_slli_epi16(lo, X265_DEPTH - 8));
+    _mm_storeu_si128((__m128i*)(dst + 8), _mm_slli_epi16(hi, X265_DEPTH - 8));
+#else
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+#endif
+}
+
+// store 8 8bit samples, held in a vector of 16bit lanes
+inline void storeSamples(pixel *dst, __m128i val)
+{
+#if HIGH_BIT_DEPTH
+    _mm_storeu_si128((__m128i*)dst, _mm_slli_epi16(val, X265_DEPTH - 8));
+#else
+    _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(val, val));
+#endif
+}
+
+// The RGB components of 8 packed pixels, in 16bit lanes. Pixels 0..3 are
+// gathered from the first 16 bytes and pixels 4..7 from the last 16 bytes of
+// the 8 * bpp bytes, so nothing past the pixels is read
+template<int bpp, int rIdx, int bIdx>
+struct RGBLoader
+{
+    __m128i lo[3], hi[3];
+
+    RGBLoader()
+    {
+        const int comp[3] = { rIdx, 1, bIdx };
+        ALIGN_VAR_16(int8_t, mask[16]);
+
+        for (int c = 0; c < 3; c++)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                mask[2 * i] = i < 4 ? (int8_t)(bpp * i + comp[c]) : (int8_t)-1;
+                mask[2 * i + 1] = -1;
+            }
+            lo[c] = _mm_load_si128((__m128i const*)mask);
+
+            for (int i = 0; i < 8; i++)
+            {
+                mask[2 * i] = i < 4 ? (int8_t)-1 : (int8_t)(bpp * i + comp[c] - (8 * bpp - 16));
+                mask[2 * i + 1] = -1;
+            }
+            hi[c] = _mm_load_si128((__m128i const*)mask);
+        }
+    }
+
+    inline void load(const uint8_t *src, __m128i& r, __m128i& g, __m128i& b) const
+    {
+        __m128i first = _mm_loadu_si128((__m128i const*)src);
+        __m128i last = _mm_loadu_si128((__m128i const*)(src + 8 * bpp - 16));
+
+        r = _mm_or_si128(_mm_shuffle_epi8(first, lo[0]), _mm_shuffle_epi8(last, hi[0]));
+        g = _mm_or_si128(_mm_shuffle_epi8(first, lo[1]), _mm_shuffle_epi8(last, hi[1]));
+        b = _mm_or_si128(_mm_shuffle_epi8(first, lo[2]), _mm_shuffle_epi8(last, hi[2]));
+    }
+};
+
+// luma of 8 pixels, the sum is at most 56228 so it is computed unsigned
+inline __m128i lumaOf(__m128i r, __m128i g, __m128i b)
+{
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+    sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+    return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+// chroma of 8 (averaged) pixels, each sum fits in signed 16bits
+inline __m128i chromaOf(__m128i r, __m128i g, __m128i b, int cr, int cg, int cb)
+{
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)), _mm_mullo_epi16(g, _mm_set1_epi16(cg)));
+
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(cb)));
+    sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+    return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+// sums of horizontally adjacent pairs of 16 components
+inline __m128i pairSums(__m128i lo, __m128i hi)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+
+    return _mm_packs_epi32(_mm_madd_epi16(lo, ones), _mm_madd_epi16(hi, ones));
+}
+
+template<int bpp, int rIdx, int bIdx>
+inline void lumaTail(pixel *dsty, const uint8_t *src, int x, int w)
+{
+    for (src += x * bpp; x < w; x++, src += bpp)
+        dsty[x] = (pixel)(rgbToY(src[rIdx], src[1], src[bIdx]) << (X265_DEPTH - 8));
+}
+
+// Luma and chroma are converted in one pass over the packed pixels, 16 pixels
+// (of two rows for 4:2:0) at a time
+template<int bpp, int rIdx, int bIdx, int hShift, int vShift>
+void rgb2yuv(pixel *dsty, intptr_t dstyStride, pixel *dstu, pixel *dstv, intptr_t dstcStride,
+             const uint8_t *src, intptr_t srcStride, int w, int h)
+{
+    const RGBLoader<bpp, rIdx, bIdx> loader;
+    const int log2Count = hShift + vShift;
+    const __m128i round = _mm_set1_epi16((1 << log2Count) >> 1);
+
+    for (int y = 0; y < h >> vShift; y++)
+    {
+        const uint8_t *row0 = src + (y << vShift) * srcStride;
+        const uint8_t *row1 = row0 + srcStride;
+        pixel *y0 = dsty + (y << vShift) * dstyStride;
+        pixel *y1 = y0 + dstyStride;
+        pixel *u = dstu + y * dstcStride;
+        pixel *v = dstv + y * dstcStride;
+
+        int x = 0;
+        for (; x + 16 <= w; x += 16)
+        {
+            __m128i r0, g0, b0, r1, g1, b1;
+
+            loader.load(row0 + x * bpp, r0, g0, b0);
+            loader.load(row0 + (x + 8) * bpp, r1, g1, b1);
+            storeSamples(y0 + x, lumaOf(r0, g0, b0), lumaOf(r1, g1, b1));
+
+            if (!hShift)
+            {
+                storeSamples(u + x, chromaOf(r0, g0, b0, -38, -74, 112), chromaOf(r1, g1, b1, -38, -74, 112));
+                storeSamples(v + x, chromaOf(r0, g0, b0, 112, -94, -18), chromaOf(r1, g1, b1, 112, -94, -18));
+                continue;
+            }
+
+            __m128i rs = pairSums(r0, r1);
+            __m128i gs = pairSums(g0, g1);
+            __m128i bs = pairSums(b0, b1);
+
+            if (vShift)
+            {
+                loader.load(row1 + x * bpp, r0, g0, b0);
+                loader.load(row1 + (x + 8) * bpp, r1, g1, b1);
+                storeSamples(y1 + x, lumaOf(r0, g0, b0), lumaOf(r1, g1, b1));
+
+                rs = _mm_add_epi16(rs, pairSums(r0, r1));
+                gs = _mm_add_epi16(gs, pairSums(g0, g1));
+                bs = _mm_add_epi16(bs, pairSums(b0, b1));
+            }
+
+            rs = _mm_srli_epi16(_mm_add_epi16(rs, round), log2Count);
+            gs = _mm_srli_epi16(_mm_add_epi16(gs, round), log2Count);
+            bs = _mm_srli_epi16(_mm_add_epi16(bs, round), log2Count);
+
+            storeSamples(u + (x >> 1), chromaOf(rs, gs, bs, -38, -74, 112));
+            storeSamples(v + (x >> 1), chromaOf(rs, gs, bs, 112, -94, -18));
+        }
+
+        lumaTail<bpp, rIdx, bIdx>(y0, row0, x, w);
+        if (vShift)
+            lumaTail<bpp, rIdx, bIdx>(y1, row1, x, w);
+
+        for (x >>= hShift; x < w >> hShift; x++)
+        {
+            int r = 0, g = 0, b = 0;
+            for (int j = 0; j <= vShift; j++)
+            {
+                const uint8_t *pel = (j ? row1 : row0) + (x << hShift) * bpp;
+                for (int i = 0; i <= hShift; i++, pel += bpp)
+                {
+                    r += pel[rIdx];
+                    g += pel[1];
+                    b += pel[bIdx];
+                }
+            }
+
+            r = (r + ((1 << log2Count) >> 1)) >> log2Count;
+            g = (g + ((1 << log2Count) >> 1)) >> log2Count;
+            b = (b + ((1 << log2Count) >> 1)) >> log2Count;
+            u[x] = (pixel)(rgbToU(r, g, b) << (X265_DEPTH - 8));
+            v[x] = (pixel)(rgbToV(r, g, b) << (X265_DEPTH - 8));
+        }
+    }
+
+    // the last row of an odd height 4:2:0 picture has no chroma of its own
+    if (vShift && (h & 1))
+        lumaTail<bpp, rIdx, bIdx>(dsty + (h - 1) * dstyStride, src + (h - 1) * srcStride, 0, w);
+}
+}
+
+namespace x265 {
+void Setup_Vec_ConvertPrimitives_ssse3(EncoderPrimitives &p)
+{
+    p.plane_copy_deinterleave_c = planeCopyDeinterleave;
+
+#define SETUP_RGB2YUV(csp, bpp, r, b) \
+    p.rgb2yuv[csp - X265_CSP_BGR][X265_CSP_I420] = rgb2yuv<bpp, r, b, 1, 1>; \
+    p.rgb2yuv[csp - X265_CSP_BGR][X265_CSP_I422] = rgb2yuv<bpp, r, b, 1, 0>; \
+    p.rgb2yuv[csp - X265_CSP_BGR][X265_CSP_I444] = rgb2yuv<bpp, r, b, 0, 0>;
+
+    SETUP_RGB2YUV(X265_CSP_BGR,  3, 2, 0);
+    SETUP_RGB2YUV(X265_CSP_BGRA, 4, 2, 0);
+    SETUP_RGB2YUV(X265_CSP_RGB,  3, 0, 2);
+}
+}
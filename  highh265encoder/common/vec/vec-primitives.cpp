@@ -27,20 +27,23 @@
 /* The #if logic here must match the file lists in CMakeLists.txt */
 #if X265_ARCH_X86
 #if defined(__INTEL_COMPILER)
+#define HAVE_SSE2
 #define HAVE_SSE3
 #define HAVE_SSSE3
 #define HAVE_SSE4
 #define HAVE_AVX2
 #elif defined(__GNUC__)
-#if __clang__ || (__GNUC__ >= 4 && __GNUC_MINOR__ >= 3)
+#if __clang__ || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3)
+#define HAVE_SSE2
 #define HAVE_SSE3
 #define HAVE_SSSE3
 #define HAVE_SSE4
 #endif
-#if __clang__ || (__GNUC__ >= 4 && __GNUC_MINOR__ >= 7)
+#if __clang__ || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)
 #define HAVE_AVX2
 #endif
 #elif defined(_MSC_VER)
+#define HAVE_SSE2
 #define HAVE_SSE3
 #define HAVE_SSSE3
 #define HAVE_SSE4
@@ -53,8 +56,13 @@
 namespace x265 {
 // private x265 namespace
 
+void Setup_Vec_BitstreamPrimitives_sse2(EncoderPrimitives&);
+void Setup_Vec_BitstreamPrimitives_avx2(EncoderPrimitives&);
+
 void Setup_Vec_BlockCopyPrimitives_sse3(EncoderPrimitives&);
 
+void Setup_Vec_ConvertPrimitives_ssse3(EncoderPrimitives&);
+
 void Setup_Vec_DCTPrimitives_sse3(EncoderPrimitives&);
 void Setup_Vec_DCTPrimitives_ssse3(EncoderPrimitives&);
 void Setup_Vec_DCTPrimitives_sse41(EncoderPrimitives&);
@@ -62,6 +70,12 @@ void Setup_Vec_DCTPrimitives_sse41(EncoderPrimitives&);
 /* Use primitives for the best available vector architecture */
 void Setup_Instrinsic_Primitives(EncoderPrimitives &p, int cpuMask)
 {
+#ifdef HAVE_SSE2
+    if (cpuMask & X265_CPU_SSE2)
+    {
+        Setup_Vec_BitstreamPrimitives_sse2(p);
+    }
+#endif
 #ifdef HAVE_SSE3
     if (cpuMask & X265_CPU_SSE3)
     {
@@ -73,6 +87,7 @@ void Setup_Instrinsic_Primitives(EncoderPrimitives &p, int cpuMask)
     if (cpuMask & X265_CPU_SSSE3)
     {
         Setup_Vec_DCTPrimitives_ssse3(p);
+        Setup_Vec_ConvertPrimitives_ssse3(p);
     }
 #endif
 #ifdef HAVE_SSE4
@@ -80,6 +95,12 @@ void Setup_Instrinsic_Primitives(EncoderPrimitives &p, int cpuMask)
     {
         Setup_Vec_DCTPrimitives_sse41(p);
     }
+#endif
+#ifdef HAVE_AVX2
+    if (cpuMask & X265_CPU_AVX2)
+    {
+        Setup_Vec_BitstreamPrimitives_avx2(p);
+    }
 #endif
     (void)p;
     (void)cpuMask;
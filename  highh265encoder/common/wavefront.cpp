@@ -68,7 +68,7 @@ void WaveFront::enqueueRow(int row)
 
     assert(row < m_numRows);
     ATOMIC_OR(&m_internalDependencyBitmap[row >> 6], bit);
-    m_pool->pokeIdleThread();
+    m_pool->pokeIdleThread(m_node);
 }
 
 void WaveFront::enableRow(int row)
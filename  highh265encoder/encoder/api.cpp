@@ -68,6 +68,19 @@ x265_encoder *x265_encoder_open(x265_param *param)
     return encoder;
 }
 
+extern "C"
+x265_thread_pool *x265_thread_pool_alloc(int numThreads, int numNodes)
+{
+    return (x265_thread_pool*)ThreadPool::createThreadPool(numThreads, numNodes);
+}
+
+extern "C"
+void x265_thread_pool_free(x265_thread_pool *pool)
+{
+    if (pool)
+        ((ThreadPool*)pool)->release();
+}
+
 extern "C"
 int x265_encoder_headers(x265_encoder *enc, x265_nal **pp_nal, uint32_t *pi_nal)
 {
@@ -94,7 +107,7 @@ int x265_encoder_headers(x265_encoder *enc, x265_nal **pp_nal, uint32_t *pi_nal)
     {
         if (nalunits[i])
         {
-            free(nalunits[i]->m_nalUnitData);
+            nalunits[i]->destroy();
             X265_FREE(nalunits[i]);
         }
     }
@@ -102,6 +115,16 @@ int x265_encoder_headers(x265_encoder *enc, x265_nal **pp_nal, uint32_t *pi_nal)
     return ret;
 }
 
+extern "C"
+int x265_encoder_reconfig(x265_encoder *enc, x265_param *param)
+{
+    if (!enc || !param)
+        return -1;
+
+    Encoder *encoder = static_cast<Encoder*>(enc);
+    return encoder->reconfigure(param);
+}
+
 extern "C"
 int x265_encoder_encode(x265_encoder *enc, x265_nal **pp_nal, uint32_t *pi_nal, x265_picture *pic_in, x265_picture *pic_out)
 {
@@ -112,12 +135,11 @@ int x265_encoder_encode(x265_encoder *enc, x265_nal **pp_nal, uint32_t *pi_nal,
     NALUnitEBSP *nalunits[MAX_NAL_UNITS] = { 0, 0, 0, 0, 0 };
     int numEncoded = encoder->encode(!pic_in, pic_in, pic_out, nalunits);
 
+    // the NAL units were written to the output packet buffer by encode()
     if (pp_nal && numEncoded > 0)
     {
-        int memsize;
-        int nalcount = encoder->extractNalData(nalunits, memsize);
         *pp_nal = &encoder->m_nals[0];
-        if (pi_nal) *pi_nal = nalcount;
+        if (pi_nal) *pi_nal = encoder->m_numNals;
     }
     else if (pi_nal)
         *pi_nal = 0;
@@ -126,7 +148,7 @@ int x265_encoder_encode(x265_encoder *enc, x265_nal **pp_nal, uint32_t *pi_nal,
     {
         if (nalunits[i])
         {
-            free(nalunits[i]->m_nalUnitData);
+            nalunits[i]->destroy();
             X265_FREE(nalunits[i]);
         }
     }
@@ -134,6 +156,16 @@ int x265_encoder_encode(x265_encoder *enc, x265_nal **pp_nal, uint32_t *pi_nal,
     return numEncoded;
 }
 
+extern "C"
+void x265_encoder_output_ring(x265_encoder *enc, uint8_t *buffer, uint32_t sizeBytes)
+{
+    if (enc)
+    {
+        Encoder *encoder = static_cast<Encoder*>(enc);
+        encoder->setOutputRing(buffer, sizeBytes);
+    }
+}
+
 extern "C"
 void x265_encoder_get_stats(x265_encoder *enc, x265_stats *outputStats, uint32_t statsSizeBytes)
 {
@@ -194,3 +226,19 @@ void x265_picture_free(x265_picture *p)
 {
     return x265_free(p);
 }
+
+extern "C"
+int x265_picture_alloc_planes(x265_encoder *enc, x265_picture *pic)
+{
+    if (!enc || !pic)
+        return -1;
+
+    Encoder *encoder = static_cast<Encoder*>(enc);
+    return encoder->allocPicturePlanes(pic);
+}
+
+extern "C"
+void x265_picture_free_planes(void *planesBuffer)
+{
+    x265_free(planesBuffer);
+}
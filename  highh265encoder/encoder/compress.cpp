@@ -247,8 +247,11 @@ void TEncCu::xComputeCostMerge2Nx2N(TComDataCU*& outBestCU, TComDataCU*& outTemp
     for (int mergeCand = 0; mergeCand < numValidMergeCand; ++mergeCand)
     {
         if (m_param->frameNumThreads <= 1 ||
-            (mvFieldNeighbours[0 + 2 * mergeCand].mv.y < (m_param->searchRange + 1) * 4 &&
-             mvFieldNeighbours[1 + 2 * mergeCand].mv.y < (m_param->searchRange + 1) * 4))
+            (mvFieldNeighbours[0 + 2 * mergeCand].mv.y < (m_search->getSearchRange() + 1) * 4 &&
+             mvFieldNeighbours[1 + 2 * mergeCand].mv.y < (m_search->getSearchRange() + 1) * 4 &&
+             (!m_param->bEnableCtuRefSync ||
+              (mvFieldNeighbours[0 + 2 * mergeCand].mv.x < (m_search->getSearchRange() + 1) * 4 &&
+               mvFieldNeighbours[1 + 2 * mergeCand].mv.x < (m_search->getSearchRange() + 1) * 4))))
         {
             // set MC parameters, interprets depth relative to LCU level
             outTempCU->setMergeIndex(0, mergeCand);
@@ -649,6 +652,15 @@ void TEncCu::xCompressInterCU(TComDataCU*& outBestCU, TComDataCU*& outTempCU, TC
             TComDataCU* left = outTempCU->getCULeft();
             TComDataCU* rootCU = outTempCU->getPic()->getPicSym()->getCU(outTempCU->getAddr());
 
+            /* the CUs of other tiles may be under analysis by other threads */
+            if (outTempCU->getPic()->getPicSym()->hasTiles())
+            {
+                above = above && outTempCU->isDiffTile(above) ? NULL : above;
+                aboveLeft = aboveLeft && outTempCU->isDiffTile(aboveLeft) ? NULL : aboveLeft;
+                aboveRight = aboveRight && outTempCU->isDiffTile(aboveRight) ? NULL : aboveRight;
+                left = left && outTempCU->isDiffTile(left) ? NULL : left;
+            }
+
             totalCostCU += rootCU->m_avgCost[depth] * rootCU->m_count[depth];
             totalCountCU += rootCU->m_count[depth];
             if (above)
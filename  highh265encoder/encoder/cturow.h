@@ -38,9 +38,10 @@ namespace x265 {
 
 class Encoder;
 
-/* manages the state of encoding one row of CTU blocks.  When
- * WPP is active, several rows will be simultaneously encoded.
- * When WPP is inactive, only one CTURow instance is used. */
+/* manages the state of encoding one row of CTU blocks, or the segment of
+ * the row within one tile column when tiles are enabled.  When WPP is
+ * active, several rows will be simultaneously encoded.  When WPP is
+ * inactive, only one CTURow instance per tile column is used. */
 class CTURow
 {
 public:
@@ -68,6 +69,8 @@ public:
     void init(TComSlice *slice)
     {
         m_active = 0;
+        m_qpaAq = 0;
+        m_qpaRc = 0;
 
         // Note: Reset status to avoid frame parallelism output mistake on different thread number
         for (uint32_t depth = 0; depth < g_maxCUDepth + 1; depth++)
@@ -88,7 +91,8 @@ public:
 
     /* Threading variables */
 
-    /* This lock must be acquired when reading or writing m_active or m_busy */
+    /* This lock must be acquired when reading or writing m_active, or when
+     * setting m_busy */
     Lock                m_lock;
 
     /* row is ready to run, has no neighbor dependencies. The row may have
@@ -97,13 +101,28 @@ public:
      * encoded by a worker thread. */
     volatile bool       m_active;
 
-    /* row is being processed by a worker thread.  This flag is only true when a
-     * worker thread is within the context of FrameEncoder::processRow(). This
-     * flag is used to detect multiple possible wavefront problems. */
-    volatile bool       m_busy;
+    /* row is being processed by a worker thread.  This flag is only non-zero
+     * when a worker thread is within the context of FrameEncoder::processRow().
+     * This flag is used to detect multiple possible wavefront problems, and VBV
+     * restarts block on it while stopping rows */
+    ThreadSafeInteger   m_busy;
 
     /* count of completed CUs in this row */
     volatile uint32_t   m_completed;
+
+    /* count of CUs in this row whose motion reference pixels are known to be
+     * available in all reference frames. Raised by the frame encoder thread */
+    volatile uint32_t   m_refCols;
+
+    /* row stopped because it reached m_refCols, the frame encoder thread must
+     * re-enqueue it when m_refCols is raised. Cleared whenever the row is
+     * activated */
+    volatile bool       m_refStalled;
+
+    /* sums of the AQ and rate control QPs of the CUs coded in this row
+     * segment, folded into the picture's per row sums by the frame encoder */
+    double              m_qpaAq;
+    double              m_qpaRc;
 };
 }
 
@@ -52,8 +52,9 @@ void DPB::recycleUnreferenced(PicList& freeList)
         iterPic = iterPic->m_next;
         if (pic->getSlice()->isReferenced() == false && pic->m_countRefEncoders == 0)
         {
-            pic->m_reconRowCount.set(0);
+            pic->resetReconProgress();
             pic->m_bChromaPlanesExtended = false;
+            pic->releaseOrigPlanes();
 
             // iterator is invalidated by remove, restart scan
             m_picList.remove(*pic);
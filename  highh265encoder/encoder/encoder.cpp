@@ -67,7 +67,12 @@ Encoder::Encoder()
     m_rateControl = NULL;
     m_dpb = NULL;
     m_nals = NULL;
+    m_numNals = 0;
     m_packetData = NULL;
+    m_packetDataSize = 0;
+    m_outputRing = NULL;
+    m_outputRingSize = 0;
+    m_outputRingOffset = 0;
     m_outputCount = 0;
     m_csvfpt = NULL;
     param = NULL;
@@ -98,9 +103,12 @@ void Encoder::create()
     m_frameEncoder = new FrameEncoder[param->frameNumThreads];
     if (m_frameEncoder)
     {
+        int numNodes = m_threadPool ? m_threadPool->getNodeCount() : 1;
         for (int i = 0; i < param->frameNumThreads; i++)
         {
             m_frameEncoder[i].setThreadPool(m_threadPool);
+            if (numNodes > 1)
+                m_frameEncoder[i].setNode(i % numNodes);
         }
     }
     m_lookahead = new Lookahead(this, m_threadPool);
@@ -269,7 +277,12 @@ int Encoder::encode(bool flush, const x265_picture* pic_in, x265_picture *pic_ou
 
     if (pic_in)
     {
-        if (pic_in->colorSpace != param->internalCsp)
+        /* semi-planar and packed RGB pictures are converted as they are copied */
+        int csp = pic_in->colorSpace;
+        bool bConvertible = (csp == X265_CSP_NV12 && param->internalCsp == X265_CSP_I420) ||
+                            (csp == X265_CSP_NV16 && param->internalCsp == X265_CSP_I422) ||
+                            (csp >= X265_CSP_BGR && csp < X265_CSP_MAX && pic_in->bitDepth == 8);
+        if (csp != param->internalCsp && !bConvertible)
         {
             x265_log(param, X265_LOG_ERROR, "Unsupported color space (%d) on input\n",
                      pic_in->colorSpace);
@@ -281,6 +294,11 @@ int Encoder::encode(bool flush, const x265_picture* pic_in, x265_picture *pic_ou
                      pic_in->bitDepth);
             return -1;
         }
+        if (pic_in->planesBuffer && (csp != param->internalCsp || !checkPlanesLayout(pic_in)))
+        {
+            x265_log(param, X265_LOG_ERROR, "Zero-copy input picture was not allocated by x265_picture_alloc_planes()\n");
+            return -1;
+        }
 
         TComPic *pic;
         if (m_freeList.empty())
@@ -306,10 +324,18 @@ int Encoder::encode(bool flush, const x265_picture* pic_in, x265_picture *pic_ou
         }
         else
             pic = m_freeList.popBack();
-        /* Copy input picture into a TComPic, send to lookahead */
+        /* Copy input picture into a TComPic, or reference the planes of a
+         * zero-copy input picture, send to lookahead */
         pic->getSlice()->setPOC(++m_pocLast);
         pic->reInit(this);
-        pic->getPicYuvOrg()->copyFromPicture(*pic_in, m_pad);
+        if (pic_in->planesBuffer)
+        {
+            pic->getPicYuvOrg()->attachPlanes((pixel*)pic_in->planesBuffer);
+            pic->getPicYuvOrg()->padPicture(m_pad);
+            pic->m_releasePlanes = pic_in->releasePlanes;
+        }
+        else
+            pic->getPicYuvOrg()->copyFromPicture(*pic_in, m_pad);
         pic->m_userData = pic_in->userData;
         pic->m_pts = pic_in->pts;
 
@@ -413,6 +439,11 @@ int Encoder::encode(bool flush, const x265_picture* pic_in, x265_picture *pic_ou
                 m_numChromaWPBiFrames++;
         }
 
+        /* write the access unit to the output packet buffer, unless the frame
+         * encoder has already passed it to the low latency output function */
+        int memsize;
+        m_numNals = param->nalOutput ? 0 : extractNalData(nalunits, memsize);
+
         /* calculate the size of the access unit, excluding:
          *  - any AnnexB contributions (start_code_prefix, zero_byte, etc.,)
          *  - SEI NAL units
@@ -439,12 +470,11 @@ int Encoder::encode(bool flush, const x265_picture* pic_in, x265_picture *pic_ou
         ret = 1;
     }
 
-    if (!m_lookahead->outputQueue.empty())
+    // pop a single frame from decided list, then provide to frame encoder
+    // curEncoder is guaranteed to be idle at this point
+    TComPic *fenc = m_lookahead->getDecidedPicture();
+    if (fenc)
     {
-        // pop a single frame from decided list, then provide to frame encoder
-        // curEncoder is guaranteed to be idle at this point
-        TComPic *fenc = m_lookahead->outputQueue.popFront();
-
         m_encodedFrameNum++;
         if (m_bframeDelay)
         {
@@ -457,6 +487,9 @@ int Encoder::encode(bool flush, const x265_picture* pic_in, x265_picture *pic_ou
         else
             fenc->m_dts = fenc->m_reorderedPts;
 
+        // apply any analysis parameters changed by x265_encoder_reconfig()
+        curEncoder->reconfigure(param);
+
         // Initialize slice for encoding with this FrameEncoder
         curEncoder->initSlice(fenc);
 
@@ -466,6 +499,9 @@ int Encoder::encode(bool flush, const x265_picture* pic_in, x265_picture *pic_ou
         // set slice QP
         m_rateControl->rateControlStart(fenc, m_lookahead, &curEncoder->m_rce, this);
 
+        // NAL units are output by the frame encoders in encode order
+        curEncoder->m_outputIndex = m_encodedFrameNum - 1;
+
         // Allow FrameEncoder::compressFrame() to start in a worker thread
         curEncoder->m_enable.trigger();
     }
@@ -473,6 +509,50 @@ int Encoder::encode(bool flush, const x265_picture* pic_in, x265_picture *pic_ou
     return ret;
 }
 
+void Encoder::initPlanesLayout(TComPicYuv& layout)
+{
+    layout.initLayout(param->sourceWidth, param->sourceHeight, param->internalCsp, g_maxCUSize);
+}
+
+/* Allocate a zero-copy input buffer, the encoder will encode directly from
+ * its planes and extend the picture into its margins in place */
+int Encoder::allocPicturePlanes(x265_picture *pic)
+{
+    TComPicYuv layout;
+    initPlanesLayout(layout);
+
+    pixel *buf = X265_MALLOC(pixel, layout.getPlanesBufSize());
+    if (!buf)
+        return -1;
+
+    for (int i = 0; i < 3; i++)
+    {
+        pic->planes[i] = layout.getPlanesBufOrigin(buf, i);
+        pic->stride[i] = (i ? layout.getCStride() : layout.getStride()) * sizeof(pixel);
+    }
+
+    pic->bitDepth = X265_DEPTH;
+    pic->colorSpace = param->internalCsp;
+    pic->planesBuffer = buf;
+    return 0;
+}
+
+bool Encoder::checkPlanesLayout(const x265_picture* pic)
+{
+    TComPicYuv layout;
+    initPlanesLayout(layout);
+
+    pixel *buf = (pixel*)pic->planesBuffer;
+    for (int i = 0; i < 3; i++)
+    {
+        int stride = (i ? layout.getCStride() : layout.getStride()) * sizeof(pixel);
+        if (pic->planes[i] != layout.getPlanesBufOrigin(buf, i) || pic->stride[i] != stride)
+            return false;
+    }
+
+    return pic->bitDepth == X265_DEPTH;
+}
+
 void EncStats::addPsnr(double psnrY, double psnrU, double psnrV)
 {
     m_psnrSumY += psnrY;
@@ -496,6 +576,11 @@ void EncStats::addQP(double aveQp)
     m_totalQp += aveQp;
 }
 
+void EncStats::addMetricPic()
+{
+    m_numMetricPics++;
+}
+
 
 char* Encoder::statsString(EncStats& stat, char* buffer)
 {
@@ -506,18 +591,18 @@ char* Encoder::statsString(EncStats& stat, char* buffer)
 
     len += sprintf(buffer + len, "Avg QP:%2.2lf", stat.m_totalQp / (double)stat.m_numPics);
     len += sprintf(buffer + len, "  kb/s: %-8.2lf", stat.m_accBits * scale);
-    if (param->bEnablePsnr)
+    if (param->bEnablePsnr && stat.m_numMetricPics)
     {
         len += sprintf(buffer + len, "  PSNR Mean: Y:%.3lf U:%.3lf V:%.3lf",
-                       stat.m_psnrSumY / (double)stat.m_numPics,
-                       stat.m_psnrSumU / (double)stat.m_numPics,
-                       stat.m_psnrSumV / (double)stat.m_numPics);
+                       stat.m_psnrSumY / (double)stat.m_numMetricPics,
+                       stat.m_psnrSumU / (double)stat.m_numMetricPics,
+                       stat.m_psnrSumV / (double)stat.m_numMetricPics);
     }
-    if (param->bEnableSsim)
+    if (param->bEnableSsim && stat.m_numMetricPics)
     {
         sprintf(buffer + len, "  SSIM Mean: %.6lf (%.3lfdB)",
-                stat.m_globalSsim / (double)stat.m_numPics,
-                x265_ssim2dB(stat.m_globalSsim / (double)stat.m_numPics));
+                stat.m_globalSsim / (double)stat.m_numMetricPics,
+                x265_ssim2dB(stat.m_globalSsim / (double)stat.m_numMetricPics));
     }
     return buffer;
 }
@@ -695,6 +780,12 @@ void Encoder::printSummary()
                      (float)100.0 * m_numLumaWPBiFrames / m_analyzeB.m_numPics,
                      (float)100.0 * m_numChromaWPBiFrames / m_analyzeB.m_numPics);
         }
+        if (param->rc.vbvBufferSize > 0 && param->rc.vbvMaxBitrate > 0)
+        {
+            x265_stats stats;
+            fetchStats(&stats, sizeof(stats));
+            x265_log(param, X265_LOG_DEBUG, "VBV restarts waited %.3fs for busy rows\n", stats.vbvRestartWaitTime);
+        }
         int pWithB = 0;
         for (int i = 0; i <= param->bframes; i++)
             pWithB += m_lookahead->histogram[i];
@@ -721,8 +812,10 @@ void Encoder::fetchStats(x265_stats *stats, size_t statsSizeBytes)
         stats->elapsedEncodeTime = (double)(x265_mdate() - m_encodeStartTime) / 1000000;
         if (stats->encodedPictureCount > 0)
         {
-            stats->globalSsim = m_analyzeAll.m_globalSsim / stats->encodedPictureCount;
-            stats->globalPsnr = (stats->globalPsnrY * 6 + stats->globalPsnrU + stats->globalPsnrV) / (8 * stats->encodedPictureCount);
+            // with --metrics-interval only a subset of the pictures are measured
+            uint32_t metricPics = m_analyzeAll.m_numMetricPics;
+            stats->globalSsim = metricPics ? m_analyzeAll.m_globalSsim / metricPics : 0;
+            stats->globalPsnr = metricPics ? (stats->globalPsnrY * 6 + stats->globalPsnrU + stats->globalPsnrV) / (8 * metricPics) : 0;
             stats->elapsedVideoTime = (double)stats->encodedPictureCount * param->fpsDenom / param->fpsNum;
             stats->bitrate = (0.001f * stats->accBits) / stats->elapsedVideoTime;
         }
@@ -738,6 +831,17 @@ void Encoder::fetchStats(x265_stats *stats, size_t statsSizeBytes)
     /* If new statistics are added to x265_stats, we must check here whether the
      * structure provided by the user is the new structure or an older one (for
      * future safety) */
+    if (statsSizeBytes >= sizeof(x265_stats))
+    {
+        int64_t vbvWait = 0;
+        for (int i = 0; i < param->frameNumThreads; i++)
+            vbvWait += m_frameEncoder[i].m_vbvRestartWaitTime;
+
+        stats->vbvRestartWaitTime = (double)vbvWait / 1000000;
+        stats->poolIdleWaitTime = m_threadPool ? (double)m_threadPool->getIdleWaitTime() / 1000000 : 0;
+        stats->poolFlushWaitTime = m_threadPool ? (double)m_threadPool->getFlushWaitTime() / 1000000 : 0;
+        stats->metricPictureCount = m_analyzeAll.m_numMetricPics;
+    }
 }
 
 void Encoder::writeLog(int argc, char **argv)
@@ -772,13 +876,13 @@ void Encoder::writeLog(int argc, char **argv)
         fprintf(m_csvfpt, "%.2f, %.2f, %.2f,",
                 stats.elapsedEncodeTime, stats.encodedPictureCount / stats.elapsedEncodeTime, stats.bitrate);
 
-        if (param->bEnablePsnr)
+        if (param->bEnablePsnr && stats.metricPictureCount)
             fprintf(m_csvfpt, " %.3lf, %.3lf, %.3lf, %.3lf,",
-                    stats.globalPsnrY / stats.encodedPictureCount, stats.globalPsnrU / stats.encodedPictureCount,
-                    stats.globalPsnrV / stats.encodedPictureCount, stats.globalPsnr);
+                    stats.globalPsnrY / stats.metricPictureCount, stats.globalPsnrU / stats.metricPictureCount,
+                    stats.globalPsnrV / stats.metricPictureCount, stats.globalPsnr);
         else
             fprintf(m_csvfpt, " -, -, -, -,");
-        if (param->bEnableSsim)
+        if (param->bEnableSsim && stats.metricPictureCount)
             fprintf(m_csvfpt, " %.6f, %6.3f,", stats.globalSsim, x265_ssim2dB(stats.globalSsim));
         else
             fprintf(m_csvfpt, " -, -,");
@@ -841,43 +945,35 @@ void Encoder::finishFrameStats(TComPic* pic, FrameEncoder *curEncoder, uint64_t
     m_analyzeAll.addBits(bits);
     m_analyzeAll.addQP(pic->m_avgQpAq);
 
-    if (param->bEnablePsnr)
+    // PSNR and SSIM are only measured on every metricsInterval'th picture
+    bool bPsnr = param->bEnablePsnr && pic->m_bMetricsSampled;
+    bool bSsim = param->bEnableSsim && pic->m_bMetricsSampled;
+
+    if (pic->m_bMetricsSampled)
+        m_analyzeAll.addMetricPic();
+
+    if (bPsnr)
     {
         m_analyzeAll.addPsnr(psnrY, psnrU, psnrV);
     }
 
     double ssim = 0.0;
-    if (param->bEnableSsim && pic->m_ssimCnt > 0)
+    if (bSsim && pic->m_ssimCnt > 0)
     {
         ssim = pic->m_ssim / pic->m_ssimCnt;
         m_analyzeAll.addSsim(ssim);
     }
-    if (slice->isIntra())
+    EncStats* sliceStats = slice->isIntra() ? &m_analyzeI : slice->isInterP() ? &m_analyzeP : slice->isInterB() ? &m_analyzeB : NULL;
+    if (sliceStats)
     {
-        m_analyzeI.addBits(bits);
-        m_analyzeI.addQP(pic->m_avgQpAq);
-        if (param->bEnablePsnr)
-            m_analyzeI.addPsnr(psnrY, psnrU, psnrV);
-        if (param->bEnableSsim)
-            m_analyzeI.addSsim(ssim);
-    }
-    else if (slice->isInterP())
-    {
-        m_analyzeP.addBits(bits);
-        m_analyzeP.addQP(pic->m_avgQpAq);
-        if (param->bEnablePsnr)
-            m_analyzeP.addPsnr(psnrY, psnrU, psnrV);
-        if (param->bEnableSsim)
-            m_analyzeP.addSsim(ssim);
-    }
-    else if (slice->isInterB())
-    {
-        m_analyzeB.addBits(bits);
-        m_analyzeB.addQP(pic->m_avgQpAq);
-        if (param->bEnablePsnr)
-            m_analyzeB.addPsnr(psnrY, psnrU, psnrV);
-        if (param->bEnableSsim)
-            m_analyzeB.addSsim(ssim);
+        sliceStats->addBits(bits);
+        sliceStats->addQP(pic->m_avgQpAq);
+        if (pic->m_bMetricsSampled)
+            sliceStats->addMetricPic();
+        if (bPsnr)
+            sliceStats->addPsnr(psnrY, psnrU, psnrV);
+        if (bSsim)
+            sliceStats->addSsim(ssim);
     }
 
     // if debug log level is enabled, per frame logging is performed
@@ -891,9 +987,9 @@ void Encoder::finishFrameStats(TComPic* pic, FrameEncoder *curEncoder, uint64_t
         char buf[1024];
         int p;
         p = sprintf(buf, "POC:%d %c QP %2.2lf(%d) %10d bits", poc, c, pic->m_avgQpAq, slice->getSliceQp(), (int)bits);
-        if (param->bEnablePsnr)
+        if (bPsnr)
             p += sprintf(buf + p, " [Y:%6.2lf U:%6.2lf V:%6.2lf]", psnrY, psnrU, psnrV);
-        if (param->bEnableSsim)
+        if (bSsim)
             p += sprintf(buf + p, " [SSIM: %.3lfdB]", x265_ssim2dB(ssim));
 
         if (!slice->isIntra())
@@ -917,11 +1013,11 @@ void Encoder::finishFrameStats(TComPic* pic, FrameEncoder *curEncoder, uint64_t
         {
             fprintf(m_csvfpt, "%d, %c-SLICE, %4d, %2.2lf, %10d,", m_outputCount++, c, poc, pic->m_avgQpAq, (int)bits);
             double psnr = (psnrY * 6 + psnrU + psnrV) / 8;
-            if (param->bEnablePsnr)
+            if (bPsnr)
                 fprintf(m_csvfpt, "%.3lf, %.3lf, %.3lf, %.3lf,", psnrY, psnrU, psnrV, psnr);
             else
                 fprintf(m_csvfpt, " -, -, -, -,");
-            if (param->bEnableSsim)
+            if (bSsim)
                 fprintf(m_csvfpt, " %.6f, %6.3f,", ssim, x265_ssim2dB(ssim));
             else
                 fprintf(m_csvfpt, " -, -,");
@@ -1176,7 +1272,9 @@ void Encoder::initPPS(TComPPS *pps)
     pps->setChromaCbQpOffset(param->cbQpOffset);
     pps->setChromaCrQpOffset(param->crQpOffset);
 
-    pps->setEntropyCodingSyncEnabledFlag(param->bEnableWavefront);
+    // The Main profile does not allow entropy sync together with tiles, the
+    // tiles are compressed in parallel instead
+    pps->setEntropyCodingSyncEnabledFlag(param->bEnableWavefront && param->tileColumns * param->tileRows == 1);
     pps->setUseWP(param->bEnableWeightedPred);
     pps->setWPBiPred(param->bEnableWeightedBiPred);
     pps->setOutputFlagPresentFlag(false);
@@ -1193,6 +1291,18 @@ void Encoder::initPPS(TComPPS *pps)
     pps->setTransquantBypassEnableFlag(m_TransquantBypassEnableFlag);
     pps->setUseTransformSkip(param->bEnableTransformSkip);
     pps->setLoopFilterAcrossTilesEnabledFlag(m_loopFilterAcrossTilesEnabledFlag);
+    pps->setNumTileColumnsMinus1(param->tileColumns - 1);
+    pps->setNumTileRowsMinus1(param->tileRows - 1);
+    pps->setTileUniformSpacingFlag(m_bUniformTileSpacing);
+    for (int i = 0; i < param->tileColumns; i++)
+    {
+        pps->setTileColumnWidth(i, m_tileColumnWidth[i]);
+    }
+
+    for (int i = 0; i < param->tileRows; i++)
+    {
+        pps->setTileRowHeight(i, m_tileRowHeight[i]);
+    }
 }
 
 void Encoder::determineLevelAndProfile(x265_param *_param)
@@ -1315,14 +1425,101 @@ void Encoder::determineLevelAndProfile(x265_param *_param)
     x265_log(_param, X265_LOG_INFO, "%s profile, Level-%s (%s tier)\n", profiles[m_profile], level, tiers[m_levelTier]);
 }
 
+/* Validates the tile count and explicit tile sizes of one picture dimension
+ * against the minimum tile size, then derives the size in CUs of every tile
+ * of that dimension. Returns the tile count, which may have been reduced */
+static int initTileSizes(x265_param *p, const char *dim, int count, int *explicitSizes,
+                         uint32_t numCUs, uint32_t minCUs, uint32_t *sizes)
+{
+    uint32_t used = 0;
+
+    if (explicitSizes[0])
+    {
+        bool bValid = true;
+        for (int i = 0; i < count - 1; i++)
+        {
+            bValid &= (uint32_t)explicitSizes[i] >= minCUs;
+            used += explicitSizes[i];
+        }
+
+        if (bValid && used + minCUs <= numCUs)
+        {
+            for (int i = 0; i < count - 1; i++)
+            {
+                sizes[i] = explicitSizes[i];
+            }
+
+            sizes[count - 1] = numCUs - used;
+            return count;
+        }
+
+        x265_log(p, X265_LOG_WARNING, "invalid tile %s sizes for the picture size, using uniform spacing\n", dim);
+        explicitSizes[0] = 0;
+    }
+
+    int maxCount = X265_MAX(1, (int)(numCUs / minCUs));
+    if (count > maxCount)
+    {
+        x265_log(p, X265_LOG_WARNING, "too many tile %s for the picture size, reduced to %d\n", dim, maxCount);
+        count = maxCount;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        sizes[i] = ((i + 1) * numCUs) / count - (i * numCUs) / count;
+    }
+
+    return count;
+}
+
+void Encoder::configureRDOQ(x265_param *p)
+{
+    /* Set flags according to RDLevel specified - check_params has verified that RDLevel is within range */
+    switch (p->rdLevel)
+    {
+    case 6:
+        bEnableRDOQ = bEnableRDOQTS = 1;
+        break;
+    case 5:
+        bEnableRDOQ = bEnableRDOQTS = 1;
+        break;
+    case 4:
+        bEnableRDOQ = bEnableRDOQTS = 1;
+        break;
+    case 3:
+        bEnableRDOQ = bEnableRDOQTS = 0;
+        break;
+    case 2:
+        bEnableRDOQ = bEnableRDOQTS = 0;
+        break;
+    case 1:
+        bEnableRDOQ = bEnableRDOQTS = 0;
+        break;
+    case 0:
+        bEnableRDOQ = bEnableRDOQTS = 0;
+        break;
+    }
+
+    if (!(bEnableRDOQ && p->bEnableTransformSkip))
+    {
+        bEnableRDOQTS = 0;
+    }
+}
+
 void Encoder::configure(x265_param *p)
 {
     // Trim the thread pool if WPP is disabled
     if (!p->bEnableWavefront)
         p->poolNumThreads = 1;
 
-    setThreadPool(ThreadPool::allocThreadPool(p->poolNumThreads));
-    int poolThreadCount = ThreadPool::getThreadPool()->getThreadCount();
+    /* the encoder is a client of the given pool or of the process global
+     * pool, the client handle holds the encoder's pool reference */
+    ThreadPool *pool = p->threadPool ? (ThreadPool*)p->threadPool : ThreadPool::allocThreadPool(p->poolNumThreads, p->numaPools);
+    setThreadPool(pool->attachClient(p->poolWeight));
+    if (!p->threadPool)
+        pool->release();
+    int poolThreadCount = m_threadPool->getThreadCount();
+    int poolNodeCount = m_threadPool->getNodeCount();
     int rows = (p->sourceHeight + p->maxCUSize - 1) / p->maxCUSize;
 
     if (p->frameNumThreads == 0)
@@ -1341,10 +1538,21 @@ void Encoder::configure(x265_param *p)
             p->frameNumThreads = 2; // Dual or Quad core
         else
             p->frameNumThreads = 1;
+
+        // keep every worker group busy
+        if (poolNodeCount > 1)
+            p->frameNumThreads = X265_MAX(p->frameNumThreads, poolNodeCount);
     }
     if (poolThreadCount > 1)
     {
         x265_log(p, X265_LOG_INFO, "WPP streams / pool / frames         : %d / %d / %d\n", rows, poolThreadCount, p->frameNumThreads);
+        if (poolNodeCount > 1)
+        {
+            x265_log(p, X265_LOG_INFO, "NUMA worker groups                  : %d%s\n", poolNodeCount,
+                     m_threadPool->isNumaBound() ? "" : " (not bound to nodes)");
+            if (p->frameNumThreads < poolNodeCount)
+                x265_log(p, X265_LOG_WARNING, "fewer frame threads than NUMA worker groups, some groups will be idle\n");
+        }
     }
     else if (p->frameNumThreads > 1)
     {
@@ -1388,36 +1596,7 @@ void Encoder::configure(x265_param *p)
     {
         p->bBPyramid = 0;
     }
-    /* Set flags according to RDLevel specified - check_params has verified that RDLevel is within range */
-    switch (p->rdLevel)
-    {
-    case 6:
-        bEnableRDOQ = bEnableRDOQTS = 1;
-        break;
-    case 5:
-        bEnableRDOQ = bEnableRDOQTS = 1;
-        break;
-    case 4:
-        bEnableRDOQ = bEnableRDOQTS = 1;
-        break;
-    case 3:
-        bEnableRDOQ = bEnableRDOQTS = 0;
-        break;
-    case 2:
-        bEnableRDOQ = bEnableRDOQTS = 0;
-        break;
-    case 1:
-        bEnableRDOQ = bEnableRDOQTS = 0;
-        break;
-    case 0:
-        bEnableRDOQ = bEnableRDOQTS = 0;
-        break;
-    }
-
-    if (!(bEnableRDOQ && p->bEnableTransformSkip))
-    {
-        bEnableRDOQTS = 0;
-    }
+    configureRDOQ(p);
 
     if (p->rc.rateControlMode == X265_RC_CQP)
     {
@@ -1463,6 +1642,12 @@ void Encoder::configure(x265_param *p)
     {
         x265_log(p, X265_LOG_WARNING, "Support for interlaced video is experimental\n");
     }
+    if (p->bEnableHpelCache && p->bEnableCtuRefSync && p->frameNumThreads > 1)
+    {
+        /* the cached planes are published a CTU row at a time */
+        x265_log(p, X265_LOG_WARNING, "hpel-cache is not compatible with ctu-ref-sync, disabled\n");
+        p->bEnableHpelCache = 0;
+    }
 
     m_bframeDelay = p->bframes ? (p->bBPyramid ? 2 : 1) : 0;
 
@@ -1511,11 +1696,37 @@ void Encoder::configure(x265_param *p)
         m_conformanceWindow.m_winBottomOffset = m_pad[1];
     }
 
+    //====== Tiles ======
+    /* tile columns must be at least 256 luma samples wide and tile rows at
+     * least 64 luma samples high */
+    uint32_t widthInCU = (p->sourceWidth + p->maxCUSize - 1) / p->maxCUSize;
+    uint32_t heightInCU = (p->sourceHeight + p->maxCUSize - 1) / p->maxCUSize;
+    p->tileColumns = initTileSizes(p, "column", p->tileColumns, p->tileColumnWidth, widthInCU,
+                                   (256 + p->maxCUSize - 1) / p->maxCUSize, m_tileColumnWidth);
+    p->tileRows = initTileSizes(p, "row", p->tileRows, p->tileRowHeight, heightInCU,
+                                (64 + p->maxCUSize - 1) / p->maxCUSize, m_tileRowHeight);
+    m_bUniformTileSpacing = !p->tileColumnWidth[0] && !p->tileRowHeight[0];
+    if (p->tileColumns * p->tileRows > 1)
+    {
+        x265_log(p, X265_LOG_INFO, "Tile columns / rows                 : %d / %d%s\n", p->tileColumns, p->tileRows,
+                 m_bUniformTileSpacing ? "" : " (explicit sizes)");
+        if (p->maxSlices > p->tileRows)
+        {
+            x265_log(p, X265_LOG_WARNING, "slices are made of whole tile rows, slice count reduced to %d\n", p->tileRows);
+            p->maxSlices = p->tileRows;
+        }
+        if (!p->bLoopFilterAcrossTiles && p->bEnableSAO)
+        {
+            x265_log(p, X265_LOG_WARNING, "SAO disabled, it requires loop filtering across tiles\n");
+            p->bEnableSAO = 0;
+        }
+    }
+
     //====== HM Settings not exposed for configuration ======
     m_loopFilterOffsetInPPS = 0;
     m_loopFilterBetaOffsetDiv2 = 0;
     m_loopFilterTcOffsetDiv2 = 0;
-    m_loopFilterAcrossTilesEnabledFlag = 1;
+    m_loopFilterAcrossTilesEnabledFlag = !!p->bLoopFilterAcrossTiles;
 
     m_vps.setMaxTLayers(1);
     m_vps.setTemporalNestingFlag(true);
@@ -1563,66 +1774,107 @@ void Encoder::configure(x265_param *p)
     m_CUTransquantBypassFlagValue = false;
 }
 
-int Encoder::extractNalData(NALUnitEBSP **nalunits, int& memsize)
+int Encoder::reconfigure(x265_param *p)
 {
-    int offset = 0;
-    int nalcount = 0;
-    int num = 0;
+    /* only the rate control targets and the analysis knobs may change, the
+     * rest of the parameters size the encoder's buffers and thread pool */
+    x265_param tmp;
+    memcpy(&tmp, param, sizeof(x265_param));
+    tmp.rc.bitrate = p->rc.bitrate;
+    tmp.rc.rfConstant = p->rc.rfConstant;
+    tmp.rc.vbvMaxBitrate = p->rc.vbvMaxBitrate;
+    tmp.rc.vbvBufferSize = p->rc.vbvBufferSize;
+    tmp.searchMethod = p->searchMethod;
+    tmp.subpelRefine = p->subpelRefine;
+    tmp.rdLevel = p->rdLevel;
+
+    if (x265_check_params(&tmp))
+        return -1;
 
-    memsize = 0;
-    for (; num < MAX_NAL_UNITS && nalunits[num] != NULL; num++)
+    if (tmp.rc.rateControlMode == X265_RC_ABR && !tmp.rc.bitrate)
+    {
+        x265_log(param, X265_LOG_ERROR, "reconfig: ABR requires a target bitrate\n");
+        return -1;
+    }
+    bool bVbv = tmp.rc.vbvBufferSize > 0 && tmp.rc.vbvMaxBitrate > 0;
+    if (bVbv != m_rateControl->isVbv)
     {
-        const NALUnitEBSP& temp = *nalunits[num];
-        memsize += temp.m_packetSize + 4;
+        x265_log(param, X265_LOG_ERROR, "reconfig: VBV cannot be enabled or disabled while encoding\n");
+        return -1;
     }
 
-    X265_FREE(m_packetData);
-    X265_FREE(m_nals);
-    CHECKED_MALLOC(m_packetData, char, memsize);
-    CHECKED_MALLOC(m_nals, x265_nal, num);
+    param->searchMethod = tmp.searchMethod;
+    param->subpelRefine = tmp.subpelRefine;
+    param->rdLevel = tmp.rdLevel;
 
-    memsize = 0;
+    /* frames already queued to the frame encoders keep their settings, the
+     * frame encoders pick up the analysis parameters as they are handed their
+     * next frame, see encode(), and rate control applies the new targets when
+     * that frame starts */
+    configureRDOQ(param);
+    m_rateControl->reconfigure(tmp.rc.bitrate, tmp.rc.rfConstant, tmp.rc.vbvMaxBitrate, tmp.rc.vbvBufferSize);
 
-    /* Copy NAL output packets into x265_nal_t structures */
-    for (; nalcount < num; nalcount++)
-    {
-        const NALUnitEBSP& nalu = *nalunits[nalcount];
-        int size; /* size of annexB unit in bytes */
+    return 0;
+}
 
-        static const char start_code_prefix[] = { 0, 0, 0, 1 };
-        if (nalcount == 0 || nalu.m_nalUnitType == NAL_UNIT_SPS || nalu.m_nalUnitType == NAL_UNIT_PPS)
-        {
-            /* From AVC, When any of the following conditions are fulfilled, the
-             * zero_byte syntax element shall be present:
-             *  - the nal_unit_type within the nal_unit() is equal to 7 (sequence
-             *    parameter set) or 8 (picture parameter set),
-             *  - the byte stream NAL unit syntax structure contains the first NAL
-             *    unit of an access unit in decoding order, as specified by subclause
-             *    7.4.1.2.3.
-             */
-            ::memcpy(m_packetData + memsize, start_code_prefix, 4);
-            size = 4;
-        }
-        else
-        {
-            ::memcpy(m_packetData + memsize, start_code_prefix + 1, 3);
-            size = 3;
-        }
-        memsize += size;
-        ::memcpy(m_packetData + memsize, nalu.m_nalUnitData, nalu.m_packetSize);
-        memsize += nalu.m_packetSize;
+/* Returns room for size bytes of output packets: in the output ring when one
+ * is registered and can hold them, else in m_packetData which only grows */
+uint8_t* Encoder::getPacketBuffer(uint32_t size, bool& bRing)
+{
+    bRing = m_outputRing && size <= m_outputRingSize;
+    if (bRing)
+    {
+        if (m_outputRingOffset + size > m_outputRingSize)
+            m_outputRingOffset = 0;
+        return m_outputRing + m_outputRingOffset;
+    }
 
-        m_nals[nalcount].type = nalu.m_nalUnitType;
-        m_nals[nalcount].sizeBytes = size + nalu.m_packetSize;
+    if (size > m_packetDataSize)
+    {
+        X265_FREE(m_packetData);
+        m_packetData = X265_MALLOC(uint8_t, size);
+        m_packetDataSize = m_packetData ? size : 0;
     }
+    return m_packetData;
+}
+
+void Encoder::setOutputRing(uint8_t *buffer, uint32_t size)
+{
+    m_outputRing = buffer;
+    m_outputRingSize = buffer ? size : 0;
+    m_outputRingOffset = 0;
+}
 
-    /* Setup payload pointers, now that we're done adding content to m_packetData */
-    for (int i = 0; i < nalcount; i++)
+/* Write the NAL units with their start codes, in EBSP format, directly into the
+ * output packet buffer and set up m_nals to describe them */
+int Encoder::extractNalData(NALUnitEBSP **nalunits, int& memsize)
+{
+    int nalcount = 0;
+    int num = 0;
+    uint32_t maxsize = 0;
+
+    memsize = 0;
+    for (; num < MAX_NAL_UNITS && nalunits[num] != NULL; num++)
     {
-        m_nals[i].payload = (uint8_t*)m_packetData + offset;
-        offset += m_nals[i].sizeBytes;
+        maxsize += 4 + nalunits[num]->maxPacketSize();
     }
 
+    if (!m_nals)
+        CHECKED_MALLOC(m_nals, x265_nal, MAX_NAL_UNITS);
+
+    uint8_t *out;
+    bool bRing;
+    out = getPacketBuffer(maxsize, bRing);
+    if (!out)
+        goto fail;
+
+    /* Write NAL output packets, and describe them with x265_nal_t structures */
+    nalcount = num;
+    memsize = (int)writeAnnexB(out, m_nals, nalunits, num, true);
+
+    if (bRing)
+        m_outputRingOffset += memsize;
+
 fail:
     return nalcount;
 }
@@ -29,6 +29,7 @@
 #include "TLibCommon/TComSlice.h"
 
 #include "piclist.h"
+#include "threading.h"
 
 struct x265_encoder {};
 
@@ -41,12 +42,14 @@ struct EncStats
     double        m_totalQp;
     uint64_t      m_accBits;
     uint32_t      m_numPics;
+    uint32_t      m_numMetricPics; // pictures with measured PSNR and SSIM
 
     EncStats()
     {
         m_psnrSumY = m_psnrSumU = m_psnrSumV = m_globalSsim = 0;
         m_accBits = 0;
         m_numPics = 0;
+        m_numMetricPics = 0;
         m_totalQp = 0;
     }
 
@@ -57,6 +60,8 @@ struct EncStats
     void addBits(uint64_t bits);
 
     void addSsim(double ssim);
+
+    void addMetricPic();
 };
 
 namespace x265 {
@@ -68,6 +73,7 @@ struct Lookahead;
 struct RateControl;
 class ThreadPool;
 struct NALUnitEBSP;
+class TComPicYuv;
 
 class Encoder : public x265_encoder
 {
@@ -156,6 +162,11 @@ public:
     bool               m_bPCMFilterDisableFlag;
     bool               m_loopFilterAcrossTilesEnabledFlag;
 
+    // tile layout, the width (in CUs) of every tile column and the height of every tile row
+    bool               m_bUniformTileSpacing;
+    uint32_t           m_tileColumnWidth[X265_MAX_TILE_COLUMNS];
+    uint32_t           m_tileRowHeight[X265_MAX_TILE_ROWS];
+
     int                m_bufferingPeriodSEIEnabled;
     int                m_recoveryPointSEIEnabled;
     int                m_displayOrientationSEIAngle;
@@ -193,7 +204,18 @@ public:
     Window             m_defaultDisplayWindow;
 
     x265_nal*          m_nals;
-    char*              m_packetData;
+    int                m_numNals;            // NAL units of the last encoded picture in m_nals
+    uint8_t*           m_packetData;
+    uint32_t           m_packetDataSize;
+
+    // caller provided buffer for output packets, see x265_encoder_output_ring()
+    uint8_t*           m_outputRing;
+    uint32_t           m_outputRingSize;
+    uint32_t           m_outputRingOffset;
+
+    // encode order of the picture whose NAL units may be passed to the low
+    // latency output function, see x265_param.nalOutput
+    ThreadSafeInteger  m_nalOutputTurn;
 
     Encoder();
 
@@ -208,6 +230,8 @@ public:
 
     int encode(bool bEos, const x265_picture* pic, x265_picture *pic_out, NALUnitEBSP **nalunits);
 
+    int allocPicturePlanes(x265_picture *pic);
+
     int getStreamHeaders(NALUnitEBSP **nalunits);
 
     void fetchStats(x265_stats* stats, size_t statsSizeBytes);
@@ -224,15 +248,30 @@ public:
 
     void configure(x265_param *param);
 
+    void configureRDOQ(x265_param *param);
+
+    /* change the rate control targets and analysis parameters of the open
+     * encoder, returns negative if the new parameters are rejected */
+    int  reconfigure(x265_param *param);
+
     void determineLevelAndProfile(x265_param *param);
 
     int  extractNalData(NALUnitEBSP **nalunits, int& memsize);
 
+    void setOutputRing(uint8_t *buffer, uint32_t size);
+
     void updateVbvPlan(RateControl* rc);
 
 protected:
 
     void finishFrameStats(TComPic* pic, FrameEncoder *curEncoder, uint64_t bits);
+
+    // layout of the source pictures, which zero-copy input buffers must have
+    void initPlanesLayout(TComPicYuv& layout);
+
+    bool checkPlanesLayout(const x265_picture* pic);
+
+    uint8_t* getPacketBuffer(uint32_t size, bool& bRing);
 };
 }
 
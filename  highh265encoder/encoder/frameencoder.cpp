@@ -36,6 +36,13 @@
 namespace x265 {
 void weightAnalyse(TComSlice& slice, x265_param& param);
 
+/* The adaptive search range of a CTU is the motion of its lowres blocks plus
+ * a margin for the inaccuracy of the lowres estimate, but never less than a
+ * minimum range to find the motion the lookahead missed. It bounds the motion
+ * itself, TEncSearch widens the window around each MVP by the MVP's length */
+static const int ADAPTIVE_MERANGE_MARGIN = 8;
+static const int ADAPTIVE_MERANGE_MIN = 16;
+
 enum SCALING_LIST_PARAMETER
 {
     SCALING_LIST_OFF,
@@ -45,18 +52,32 @@ enum SCALING_LIST_PARAMETER
 FrameEncoder::FrameEncoder()
     : WaveFront(NULL)
     , m_threadActive(true)
+    , m_numTileCols(1)
     , m_rows(NULL)
     , m_top(NULL)
     , m_cfg(NULL)
     , m_pic(NULL)
+    , m_outStreams(NULL)
+    , m_substreamCoded(NULL)
+    , m_bSubstreamJobs(false)
+    , m_bStreamSlices(false)
 {
+    m_rowSegmentsDone = NULL;
+    m_numRowsDone = 0;
+    m_searchRange = 0;
+    m_ctuSearchRange = NULL;
     for (int i = 0; i < MAX_NAL_UNITS; i++)
     {
         m_nalList[i] = NULL;
     }
 
     m_nalCount = 0;
+    m_nalOutputCount = 0;
+    m_nalOutputBuf = NULL;
+    m_nalOutputBufSize = 0;
+    m_outputIndex = 0;
     m_totalTime = 0;
+    m_vbvRestartWaitTime = 0;
     m_bAllRowsStop = false;
     m_vbvResetTriggerRow = -1;
     memset(&m_rce, 0, sizeof(RateControlEntry));
@@ -78,13 +99,13 @@ void FrameEncoder::destroy()
     for (int i = 0; i < m_nalCount; i++)
     {
         NALUnitEBSP *nalu = m_nalList[i];
-        free(nalu->m_nalUnitData);
+        nalu->destroy();
         X265_FREE(nalu);
     }
 
     if (m_rows)
     {
-        for (int i = 0; i < m_numRows; ++i)
+        for (int i = 0; i < m_numRows * m_numTileCols; ++i)
         {
             m_rows[i].destroy();
         }
@@ -92,6 +113,11 @@ void FrameEncoder::destroy()
         delete[] m_rows;
     }
 
+    delete[] m_substreamCoded;
+    delete[] m_rowSegmentsDone;
+    delete[] m_ctuSearchRange;
+    X265_FREE(m_nalOutputBuf);
+
     m_frameFilter.destroy();
     // wait for worker thread to exit
     stop();
@@ -103,13 +129,18 @@ bool FrameEncoder::init(Encoder *top, int numRows)
     m_top = top;
     m_cfg = top;
     m_numRows = numRows;
+    m_numTileCols = m_cfg->param->tileColumns;
     m_filterRowDelay = (m_cfg->param->saoLcuBasedOptimization && m_cfg->param->saoLcuBoundary) ?
         2 : (m_cfg->param->bEnableSAO || m_cfg->param->bEnableLoopFilter ? 1 : 0);
 
-    m_rows = new CTURow[m_numRows];
-    for (int i = 0; i < m_numRows; ++i)
+    memcpy(&m_param, top->param, sizeof(x265_param));
+
+    // one CTURow per tile column segment of each CU row
+    m_rows = new CTURow[m_numRows * m_numTileCols];
+    for (int i = 0; i < m_numRows * m_numTileCols; ++i)
     {
         ok &= m_rows[i].create(top);
+        m_rows[i].m_cuCoder.setParam(&m_param);
 
         for (int list = 0; list <= 1; list++)
         {
@@ -120,14 +151,23 @@ bool FrameEncoder::init(Encoder *top, int numRows)
         }
     }
 
-    // NOTE: 2 times of numRows because both Encoder and Filter in same queue
-    if (!WaveFront::init(m_numRows * 2))
+    // NOTE: the Encoder of each tile column and the Filter of every row, then
+    // the entropy coding of every substream are in the same queue
+    m_substreamCoded = new ThreadSafeInteger[m_numRows * m_numTileCols];
+    m_rowSegmentsDone = new int[m_numRows];
+    if (m_cfg->param->bEnableAdaptiveMeRange)
+    {
+        int numCols = (m_cfg->param->sourceWidth + g_maxCUSize - 1) / g_maxCUSize;
+        m_ctuSearchRange = new int[m_numRows * numCols];
+    }
+    if (!WaveFront::init(m_numRows * (2 * m_numTileCols + 1)))
     {
         x265_log(m_cfg->param, X265_LOG_ERROR, "unable to initialize wavefront queue\n");
         m_pool = NULL;
     }
 
-    m_frameFilter.init(top, numRows, getRDGoOnSbacCoder(0));
+    m_frameFilter.init(top, numRows, getRDGoOnSbacCoder(0), m_pool, m_node);
+    m_headerSbacCoder.init(&m_headerBinCoder);
 
     // initialize SPS
     top->initSPS(&m_sps);
@@ -152,7 +192,7 @@ bool FrameEncoder::init(Encoder *top, int numRows)
     // set default slice level flag to the same as SPS level flag
     if (m_cfg->m_useScalingListId == SCALING_LIST_OFF)
     {
-        for (int i = 0; i < m_numRows; i++)
+        for (int i = 0; i < m_numRows * m_numTileCols; i++)
         {
             m_rows[i].m_trQuant.setFlatScalingList();
             m_rows[i].m_trQuant.setUseScalingList(false);
@@ -163,7 +203,7 @@ bool FrameEncoder::init(Encoder *top, int numRows)
     }
     else if (m_cfg->m_useScalingListId == SCALING_LIST_DEFAULT)
     {
-        for (int i = 0; i < m_numRows; i++)
+        for (int i = 0; i < m_numRows * m_numTileCols; i++)
         {
             m_rows[i].m_trQuant.setScalingList(m_top->getScalingList());
             m_rows[i].m_trQuant.setUseScalingList(true);
@@ -252,6 +292,25 @@ fail:
     return -1;
 }
 
+void FrameEncoder::reconfigure(x265_param *param)
+{
+    if (m_param.rdLevel == param->rdLevel &&
+        m_param.searchMethod == param->searchMethod &&
+        m_param.subpelRefine == param->subpelRefine)
+        return;
+
+    m_param.rdLevel = param->rdLevel;
+    m_param.searchMethod = param->searchMethod;
+    m_param.subpelRefine = param->subpelRefine;
+
+    for (int i = 0; i < m_numRows * m_numTileCols; i++)
+    {
+        m_rows[i].m_search.m_me.setSearchMethod(param->searchMethod);
+        m_rows[i].m_search.m_me.setSubpelRefine(param->subpelRefine);
+        m_rows[i].m_trQuant.setUseRDOQ(!!m_top->bEnableRDOQ, !!m_top->bEnableRDOQTS);
+    }
+}
+
 void FrameEncoder::initSlice(TComPic* pic)
 {
     m_pic = pic;
@@ -280,7 +339,7 @@ void FrameEncoder::initSlice(TComPic* pic)
     slice->setScalingList(m_top->getScalingList());
     slice->getScalingList()->setUseTransformSkip(m_pps.getUseTransformSkip());
 #if LOG_CU_STATISTICS
-    for (int i = 0; i < m_numRows; i++)
+    for (int i = 0; i < m_numRows * m_numTileCols; i++)
     {
         m_rows[i].m_cuCoder.m_log = &m_rows[i].m_cuCoder.m_sliceTypeLog[sliceType];
     }
@@ -314,6 +373,9 @@ void FrameEncoder::initSlice(TComPic* pic)
 void FrameEncoder::threadMain()
 {
     // worker thread routine for FrameEncoder
+    if (m_pool && m_node >= 0 && m_pool->isNumaBound())
+        setThreadNodeAffinity(m_node);
+
     do
     {
         m_enable.wait(); // Encoder::encode() triggers this event
@@ -369,7 +431,13 @@ void FrameEncoder::compressFrame()
     TComSlice*   slice             = m_pic->getSlice();
     int          chFmt             = slice->getSPS()->getChromaFormatIdc();
 
+    // move this frame's source and recon pixels next to the worker group
+    // which encodes it
+    if (m_pool && m_node >= 0 && m_pool->isNumaBound())
+        m_pic->moveToNode(m_node);
+
     m_nalCount = 0;
+    m_nalOutputCount = 0;
     entropyCoder->setEntropyCoder(&m_sbacCoder, NULL);
 
     /* Emit access unit delimiter unless this is the first frame and the user is
@@ -419,7 +487,7 @@ void FrameEncoder::compressFrame()
     m_frameFilter.m_sao.chromaLambda = chromaLambda;
 
     TComPicYuv *fenc = slice->getPic()->getPicYuvOrg();
-    for (int i = 0; i < m_numRows; i++)
+    for (int i = 0; i < m_numRows * m_numTileCols; i++)
     {
         m_rows[i].m_search.setQPLambda(qp, lambda, chromaLambda);
         m_rows[i].m_search.m_me.setSourcePlane(fenc->getLumaAddr(), fenc->getStride());
@@ -454,10 +522,12 @@ void FrameEncoder::compressFrame()
     slice->setSliceQpDeltaCb(0);
     slice->setSliceQpDeltaCr(0);
 
-    int numSubstreams = m_cfg->param->bEnableWavefront ? m_pic->getPicSym()->getFrameHeightInCU() : 1;
+    // One substream per row segment; without WPP only the first row of each
+    // slice and tile row is used
+    int numSubstreams = m_numRows * m_numTileCols;
     // TODO: these two items can likely be FrameEncoder member variables to avoid re-allocs
-    TComOutputBitstream*  bitstreamRedirect = new TComOutputBitstream;
     TComOutputBitstream*  outStreams = new TComOutputBitstream[numSubstreams];
+    uint32_t*             sliceSubstreams = new uint32_t[numSubstreams];
 
     slice->setSliceSegmentBits(0);
     determineSliceBounds();
@@ -487,14 +557,11 @@ void FrameEncoder::compressFrame()
         }
     }
 
-    // Analyze CTU rows, most of the hard work is done here
-    // frame is compressed in a wave-front pattern if WPP is enabled. Loop filter runs as a
-    // wave-front behind the CU compression and reconstruction
-    compressCTURows();
-
-    if (m_cfg->param->bEnableWavefront)
+    int adaptiveRange = m_ctuSearchRange && numPredDir ? computeSearchRanges(*slice) : 0;
+    m_searchRange = adaptiveRange ? adaptiveRange : m_cfg->param->searchRange;
+    for (int i = 0; i < m_numRows * m_numTileCols; i++)
     {
-        slice->setNextSlice(true);
+        m_rows[i].m_search.setSearchRange(m_searchRange, adaptiveRange ? m_ctuSearchRange : NULL);
     }
 
     if ((m_cfg->m_recoveryPointSEIEnabled) && (slice->getSliceType() == I_SLICE))
@@ -543,7 +610,6 @@ void FrameEncoder::compressFrame()
         sei.m_sourceScanType = 1;
         sei.m_duplicateFlag = 0;
 
-        entropyCoder->setBitstream(&nalu.m_bitstream);
         m_seiWriter.writeSEImessage(nalu.m_bitstream, sei, &m_sps);
         writeRBSPTrailingBits(nalu.m_bitstream);
         m_nalList[m_nalCount] = X265_MALLOC(NALUnitEBSP, 1);
@@ -554,149 +620,60 @@ void FrameEncoder::compressFrame()
         }
     }
 
-    /* use the main bitstream buffer for storing the marshaled picture */
-    if (m_sps.getUseSAO())
-    {
-        SAOParam* saoParam = m_pic->getPicSym()->getSaoParam();
-
-        if (!getSAO()->getSaoLcuBasedOptimization())
-        {
-            getSAO()->SAOProcess(saoParam);
-            getSAO()->endSaoEnc();
-            PCMLFDisableProcess(m_pic);
-
-            // Extend border after whole-frame SAO is finished
-            for (int row = 0; row < m_numRows; row++)
-            {
-                m_frameFilter.processRowPost(row, m_cfg);
-            }
-        }
-
-        slice->setSaoEnabledFlag((saoParam->bSaoFlag[0] == 1) ? true : false);
-    }
-
-    entropyCoder->setBitstream(NULL);
-
-    // Reconstruction slice
-    slice->setNextSlice(true);
-    determineSliceBounds();
-
     slice->allocSubstreamSizes(numSubstreams);
+    m_outStreams = outStreams;
     for (int i = 0; i < numSubstreams; i++)
     {
         outStreams[i].clear();
+        m_substreamCoded[i].set(0);
     }
 
-    entropyCoder->setEntropyCoder(&m_sbacCoder, slice);
-    entropyCoder->resetEntropy();
-
-    /* start slice NALunit */
-    bool sliceSegment = !slice->isNextSlice();
-    OutputNALUnit nalu(slice->getNalUnitType());
-    entropyCoder->setBitstream(&nalu.m_bitstream);
-    entropyCoder->encodeSliceHeader(slice);
-
-    // is it needed?
-    if (!sliceSegment)
-    {
-        bitstreamRedirect->writeAlignOne();
-    }
-    else
-    {
-        // We've not completed our slice header info yet, do the alignment later.
-    }
+    // For low latency output the slices are entropy coded while the CU rows
+    // below them are still compressing, the rows of a slice are final once
+    // they are reconstructed. Frame based SAO only decides the parameters of
+    // the CTUs once the whole frame is deblocked
+    m_bStreamSlices = m_cfg->param->nalOutput && m_pool && m_cfg->param->bEnableWavefront &&
+                      !(m_sps.getUseSAO() && !getSAO()->getSaoLcuBasedOptimization());
+    m_bSubstreamJobs = m_bStreamSlices;
 
-    m_sbacCoder.init(&m_binCoderCABAC);
-    entropyCoder->setEntropyCoder(&m_sbacCoder, slice);
-    entropyCoder->resetEntropy();
-    resetEntropy(slice);
+    // Analyze CTU rows, most of the hard work is done here
+    // frame is compressed in a wave-front pattern if WPP is enabled. Loop filter runs as a
+    // wave-front behind the CU compression and reconstruction
+    compressCTURows();
 
-    if (slice->isNextSlice())
+    /* use the main bitstream buffer for storing the marshaled picture */
+    if (m_sps.getUseSAO() && !getSAO()->getSaoLcuBasedOptimization())
     {
-        // set entropy coder for writing
-        m_sbacCoder.init(&m_binCoderCABAC);
-        resetEntropy(slice);
-        getSbacCoder(0)->load(&m_sbacCoder);
+        SAOParam* saoParam = m_pic->getPicSym()->getSaoParam();
 
-        //ALF is written in substream #0 with CABAC coder #0 (see ALF param encoding below)
-        entropyCoder->setEntropyCoder(getSbacCoder(0), slice);
-        entropyCoder->resetEntropy();
+        getSAO()->SAOProcess(saoParam);
+        getSAO()->endSaoEnc();
+        PCMLFDisableProcess(m_pic);
 
-        // File writing
-        if (!sliceSegment)
-        {
-            entropyCoder->setBitstream(bitstreamRedirect);
-        }
-        else
+        // Extend border after whole-frame SAO is finished
+        for (int row = 0; row < m_numRows; row++)
         {
-            entropyCoder->setBitstream(&nalu.m_bitstream);
+            m_frameFilter.processRowPost(row, m_cfg);
         }
-
-        // for now, override the TILES_DECODER setting in order to write substreams.
-        entropyCoder->setBitstream(&outStreams[0]);
     }
-    slice->setFinalized(true);
 
-    m_sbacCoder.load(getSbacCoder(0));
+    if (!m_bStreamSlices)
+        encodeSlices();
 
-    slice->setTileOffstForMultES(0);
-    encodeSlice(outStreams);
+    TComPicSym* picSym = m_pic->getPicSym();
+    const int numSlices = picSym->getNumSlices();
+    const bool bWaveFrontsynchro = slice->getPPS()->getEntropyCodingSyncEnabledFlag();
 
+    if (slice->getPPS()->getCabacInitPresentFlag())
     {
-        // Construct the final bitstream by flushing and concatenating substreams.
-        // The final bitstream is either nalu.m_bitstream or pcBitstreamRedirect;
-        uint32_t* substreamSizes = slice->getSubstreamSizes();
-        for (int i = 0; i < numSubstreams; i++)
-        {
-            // Flush all substreams -- this includes empty ones.
-            // Terminating bit and flush.
-            entropyCoder->setEntropyCoder(getSbacCoder(i), slice);
-            entropyCoder->setBitstream(&outStreams[i]);
-            entropyCoder->encodeTerminatingBit(1);
-            entropyCoder->encodeSliceFinish();
-
-            outStreams[i].writeByteAlignment(); // Byte-alignment in slice_data() at end of sub-stream
-
-            // Byte alignment is necessary between tiles when tiles are independent.
-            if (i + 1 < numSubstreams)
-            {
-                substreamSizes[i] = outStreams[i].getNumberOfWrittenBits() + (outStreams[i].countStartCodeEmulations() << 3);
-            }
-        }
-
-        // Complete the slice header info.
-        entropyCoder->setEntropyCoder(&m_sbacCoder, slice);
-        entropyCoder->setBitstream(&nalu.m_bitstream);
-        entropyCoder->encodeTilesWPPEntryPoint(slice);
-
-        // Substreams...
-        int nss = m_pps.getEntropyCodingSyncEnabledFlag() ? slice->getNumEntryPointOffsets() + 1 : numSubstreams;
-        for (int i = 0; i < nss; i++)
-        {
-            bitstreamRedirect->addSubstream(&outStreams[i]);
-        }
+        // choose the CABAC init table from the final contexts of the frame
+        int lastStreamCount = picSym->getSliceSubstreams(numSlices - 1, bWaveFrontsynchro, sliceSubstreams);
+        entropyCoder->setEntropyCoder(getSbacCoder(sliceSubstreams[lastStreamCount - 1]), slice);
+        entropyCoder->determineCabacInitIdx();
     }
 
-    // If current NALU is the first NALU of slice (containing slice header) and
-    // more NALUs exist (due to multiple dependent slices) then buffer it.  If
-    // current NALU is the last NALU of slice and a NALU was buffered, then (a)
-    // Write current NALU (b) Update an write buffered NALU at appropriate
-    // location in NALU list.
-    nalu.m_bitstream.writeByteAlignment(); // Slice header byte-alignment
-
-    // Perform bitstream concatenation
-    if (bitstreamRedirect->getNumberOfWrittenBits() > 0)
-    {
-        nalu.m_bitstream.addSubstream(bitstreamRedirect);
-    }
-    entropyCoder->setBitstream(&nalu.m_bitstream);
-    bitstreamRedirect->clear();
-    m_nalList[m_nalCount] = X265_MALLOC(NALUnitEBSP, 1);
-    if (m_nalList[m_nalCount])
-    {
-        m_nalList[m_nalCount]->init(nalu);
-        m_nalCount++;
-    }
+    // the row metrics jobs have been running behind the filter
+    m_frameFilter.finishMetrics();
 
     /* write decoded picture hash SEI messages */
     if (m_cfg->param->decodedPictureHashSEI)
@@ -737,6 +714,8 @@ void FrameEncoder::compressFrame()
         }
     }
 
+    outputNals(true);
+
     if (m_sps.getUseSAO())
     {
         m_frameFilter.end();
@@ -754,26 +733,34 @@ void FrameEncoder::compressFrame()
 
     m_pic->m_elapsedCompressTime = (double)(x265_mdate() - startCompressTime) / 1000000;
     delete[] outStreams;
-    delete bitstreamRedirect;
+    delete[] sliceSubstreams;
 }
 
-void FrameEncoder::encodeSlice(TComOutputBitstream* substreams)
+void FrameEncoder::encodeSlices()
 {
-    // choose entropy coder
-    TEncEntropy *entropyCoder = getEntropyCoder(0);
     TComSlice* slice = m_pic->getSlice();
+    TComPicSym* picSym = m_pic->getPicSym();
+    const int numSlices = picSym->getNumSlices();
+    const bool bWaveFrontsynchro = slice->getPPS()->getEntropyCodingSyncEnabledFlag();
+    uint32_t* sliceSubstreams = new uint32_t[m_numRows * m_numTileCols];
+    TComOutputBitstream bitstreamRedirect;
+    TEncEntropy headerCoder;
+
+    // the substreams code the SAO parameters of their CTUs before the slice
+    // headers are written
+    if (m_sps.getUseSAO())
+    {
+        SAOParam* saoParam = picSym->getSaoParam();
+        slice->setSaoEnabledFlag(saoParam->bSaoFlag[0]);
+        slice->setSaoEnabledFlagChroma(saoParam->bSaoFlag[1]);
+    }
 
-    // Initialize slice singletons
-    m_sbacCoder.init(&m_binCoderCABAC);
-    getCuEncoder(0)->setBitCounter(NULL);
-    entropyCoder->setEntropyCoder(&m_sbacCoder, slice);
-
-    uint32_t cuAddr;
-    uint32_t startCUAddr = 0;
-    uint32_t boundingCUAddr = slice->getSliceCurEndCUAddr();
+    // Reconstruction slice
+    slice->setNextSlice(true);
+    determineSliceBounds();
+    slice->setFinalized(true);
+    slice->setTileOffstForMultES(0);
 
-    // Appropriate substream bitstream is switched later.
-    // for every CU
 #if ENC_DEC_TRACE
     g_bJustDoIt = g_bEncDecTraceEnable;
 #endif
@@ -785,151 +772,400 @@ void FrameEncoder::encodeSlice(TComOutputBitstream* substreams)
     g_bJustDoIt = g_bEncDecTraceDisable;
 #endif
 
-    const int  bWaveFrontsynchro = m_cfg->param->bEnableWavefront;
-    const uint32_t heightInLCUs = m_pic->getPicSym()->getFrameHeightInCU();
-    const int  numSubstreams = (bWaveFrontsynchro ? heightInLCUs : 1);
-    uint32_t bitsOriginallyInSubstreams = 0;
-
-    for (int substrmIdx = 0; substrmIdx < numSubstreams; substrmIdx++)
-    {
-        getBufferSBac(substrmIdx)->loadContexts(&m_sbacCoder); //init. state
-        bitsOriginallyInSubstreams += substreams[substrmIdx].getNumberOfWrittenBits();
-    }
-
-    uint32_t widthInLCUs = m_pic->getPicSym()->getFrameWidthInCU();
-    uint32_t col = 0, lin = 0, subStrm = 0;
-    cuAddr = (startCUAddr / m_pic->getNumPartInCU()); /* for tiles, startCUAddr is NOT the real raster scan address, it is actually
-                                                       an encoding order index, so we need to convert the index (startCUAddr)
-                                                       into the real raster scan address (cuAddr) via the CUOrderMap */
-    uint32_t encCUOrder;
-    for (encCUOrder = startCUAddr / m_pic->getNumPartInCU();
-         encCUOrder < (boundingCUAddr + m_pic->getNumPartInCU() - 1) / m_pic->getNumPartInCU();
-         cuAddr = ++encCUOrder)
+    // With a thread pool each substream is entropy coded by its own job. The
+    // substreams of different slices and tiles are independent, with WPP a
+    // substream job is enqueued once the row above has coded its first two
+    // CUs. Slice NAL units are emitted in order as their substreams complete.
+    // When the slices are streamed the wave-front is still running the CU
+    // row jobs, the substream jobs of each slice are enqueued once its rows
+    // are reconstructed
+    if (!m_bStreamSlices)
     {
-        col     = cuAddr % widthInLCUs;
-        lin     = cuAddr / widthInLCUs;
-        subStrm = lin % numSubstreams;
-
-        entropyCoder->setBitstream(&substreams[subStrm]);
+        m_bSubstreamJobs = false;
+        for (int s = 0; s < numSlices && m_pool; s++)
+        {
+            m_bSubstreamJobs |= numSlices > 1 || picSym->getSliceSubstreams(s, bWaveFrontsynchro, sliceSubstreams) > 1;
+        }
 
-        // Synchronize cabac probabilities with upper-right LCU if it's available and we're at the start of a line.
-        if ((numSubstreams > 1) && (col == 0) && bWaveFrontsynchro)
+        if (m_bSubstreamJobs)
         {
-            // We'll sync if the TR is available.
-            TComDataCU *cuUp = m_pic->getCU(cuAddr)->getCUAbove();
-            uint32_t widthInCU = m_pic->getFrameWidthInCU();
-            TComDataCU *cuTr = NULL;
+            WaveFront::clearEnabledRowMask();
+            WaveFront::enqueue();
+            for (int i = 0; i < m_numRows * m_numTileCols; i++)
+            {
+                WaveFront::enableRow(m_numRows * (m_numTileCols + 1) + i);
+            }
 
-            // CHECK_ME: here can be optimize a little, do it later
-            if (cuUp && ((cuAddr % widthInCU + 1) < widthInCU))
+            for (int s = 0; s < numSlices; s++)
             {
-                cuTr = m_pic->getCU(cuAddr - widthInCU + 1);
+                enqueueSliceSubstreams(s, sliceSubstreams);
             }
-            if ( /*bEnforceSliceRestriction &&*/ ((cuTr == NULL) || (cuTr->getSlice() == NULL)))
+        }
+    }
+
+    int slicesStarted = m_bStreamSlices ? 0 : numSlices;
+    for (int s = 0; s < numSlices; s++)
+    {
+        // start the substreams of every slice whose CU rows are reconstructed,
+        // blocking until this slice may be started
+        int reconRowCount = m_pic->m_reconRowCount.get();
+        while (slicesStarted < numSlices)
+        {
+            if (reconRowCount >= (int)picSym->getSliceBaseRow(slicesStarted + 1))
+                enqueueSliceSubstreams(slicesStarted++, sliceSubstreams);
+            else if (slicesStarted <= s)
+                reconRowCount = m_pic->m_reconRowCount.waitForChange(reconRowCount);
+            else
+                break;
+        }
+
+        int sliceStreamCount = picSym->getSliceSubstreams(s, bWaveFrontsynchro, sliceSubstreams);
+        for (int i = 0; i < sliceStreamCount; i++)
+        {
+            if (m_bSubstreamJobs)
             {
-                // TR not available.
+                while (!m_substreamCoded[sliceSubstreams[i]].get())
+                {
+                    m_substreamCoded[sliceSubstreams[i]].waitForChange(0);
+                }
             }
             else
             {
-                // TR is available, we use it.
-                getSbacCoder(subStrm)->loadContexts(getBufferSBac(lin - 1));
+                // coding order, the WPP rows above have stored their contexts
+                encodeSubstream(sliceSubstreams[i]);
             }
         }
-        m_sbacCoder.load(getSbacCoder(subStrm)); //this load is used to simplify the code (avoid to change all the call to m_sbacCoder)
 
-        TComDataCU* cu = m_pic->getCU(cuAddr);
-        if (slice->getSPS()->getUseSAO() && (slice->getSaoEnabledFlag() || slice->getSaoEnabledFlagChroma()))
+        /* start slice NALunit */
+        OutputNALUnit nalu(slice->getNalUnitType());
+
+        slice->setSliceCurStartCUAddr(picSym->getSliceStartCUAddr(s) * m_pic->getNumPartInCU());
+        headerCoder.setEntropyCoder(&m_headerSbacCoder, slice);
+        headerCoder.setBitstream(&nalu.m_bitstream);
+        headerCoder.encodeSliceHeader(slice);
+
+        // Complete the slice header info.
+        headerCoder.encodeTilesWPPEntryPoint(slice);
+
+        // Substreams...
+        for (int i = 0; i < sliceStreamCount; i++)
+        {
+            bitstreamRedirect.addSubstream(&m_outStreams[sliceSubstreams[i]]);
+        }
+
+        nalu.m_bitstream.writeByteAlignment(); // Slice header byte-alignment
+
+        // Perform bitstream concatenation
+        if (bitstreamRedirect.getNumberOfWrittenBits() > 0)
+        {
+            nalu.m_bitstream.addSubstream(&bitstreamRedirect);
+        }
+        bitstreamRedirect.clear();
+        m_nalList[m_nalCount] = X265_MALLOC(NALUnitEBSP, 1);
+        if (m_nalList[m_nalCount])
+        {
+            m_nalList[m_nalCount]->init(nalu);
+            m_nalCount++;
+        }
+
+        outputNals(false);
+    }
+
+    if (m_bSubstreamJobs && !m_bStreamSlices)
+    {
+        WaveFront::dequeue();
+    }
+
+    delete[] sliceSubstreams;
+}
+
+void FrameEncoder::enqueueSliceSubstreams(int sliceIdx, uint32_t* sliceSubstreams)
+{
+    TComPicSym* picSym = m_pic->getPicSym();
+    const bool bWaveFrontsynchro = m_pic->getSlice()->getPPS()->getEntropyCodingSyncEnabledFlag();
+
+    // with WPP the other rows are enqueued by the substream above them
+    int sliceStreamCount = picSym->getSliceSubstreams(sliceIdx, bWaveFrontsynchro, sliceSubstreams);
+    for (int i = 0; i < sliceStreamCount; i++)
+    {
+        uint32_t row = sliceSubstreams[i] / m_numTileCols;
+        if (!bWaveFrontsynchro || picSym->isSliceStartRow(row) || picSym->isTileRowStart(row))
+            enqueueSubstream(sliceSubstreams[i]);
+    }
+}
+
+void FrameEncoder::outputNals(bool bLast)
+{
+    x265_param* param = m_cfg->param;
+
+    if (!param->nalOutput)
+        return;
+
+    // access units are output in encode order, wait for the previous picture
+    if (!m_nalOutputCount)
+    {
+        int turn = m_top->m_nalOutputTurn.get();
+        while (turn != m_outputIndex)
+            turn = m_top->m_nalOutputTurn.waitForChange(turn);
+    }
+
+    int count = m_nalCount - m_nalOutputCount;
+    if (count > 0)
+    {
+        uint32_t maxsize = 0;
+        for (int i = m_nalOutputCount; i < m_nalCount; i++)
+        {
+            maxsize += 4 + m_nalList[i]->maxPacketSize();
+        }
+
+        if (maxsize > m_nalOutputBufSize)
+        {
+            X265_FREE(m_nalOutputBuf);
+            m_nalOutputBuf = X265_MALLOC(uint8_t, maxsize);
+            m_nalOutputBufSize = m_nalOutputBuf ? maxsize : 0;
+        }
+
+        if (m_nalOutputBuf)
+        {
+            writeAnnexB(m_nalOutputBuf, m_nalOutputDesc, m_nalList + m_nalOutputCount, count, !m_nalOutputCount);
+            param->nalOutput(param->nalOutputOpaque, m_nalOutputDesc, count);
+        }
+        m_nalOutputCount = m_nalCount;
+    }
+
+    if (bLast)
+        m_top->m_nalOutputTurn.incr();
+}
+
+void FrameEncoder::encodeSubstream(int subStrm)
+{
+    TComSlice* slice = m_pic->getSlice();
+    TComPicSym* picSym = m_pic->getPicSym();
+
+    const bool bWaveFrontsynchro = slice->getPPS()->getEntropyCodingSyncEnabledFlag();
+    const uint32_t widthInLCUs = picSym->getFrameWidthInCU();
+    const uint32_t startRow = subStrm / m_numTileCols;
+    const uint32_t tileCol = subStrm % m_numTileCols;
+    const uint32_t tileStartCol = picSym->getTileColBase(tileCol);
+    const uint32_t tileWidth = picSym->getTileColBase(tileCol + 1) - tileStartCol;
+    const int      sliceIdx = picSym->getCUSliceIdx(startRow * widthInLCUs);
+    const uint32_t startCUAddr = picSym->getSliceStartCUAddr(sliceIdx);
+
+    // With WPP a substream is one CU row of a tile, otherwise it covers all the
+    // CU rows of a tile within the slice
+    uint32_t endRow = startRow + 1;
+    if (!bWaveFrontsynchro)
+        endRow = X265_MIN(picSym->getSliceBaseRow(sliceIdx + 1), picSym->getTileRowBase(picSym->getRowTileIdx(startRow) + 1));
+
+    // The coders of the substream's row are idle once the frame is compressed
+    TEncEntropy *entropyCoder = getEntropyCoder(subStrm);
+    TEncCu *cuCoder = getCuEncoder(subStrm);
+    cuCoder->setBitCounter(NULL);
+    cuCoder->setEntropyCoder(entropyCoder);
+    entropyCoder->setEntropyCoder(getSbacCoder(subStrm), slice);
+    entropyCoder->resetEntropy();
+    entropyCoder->setBitstream(&m_outStreams[subStrm]);
+
+    // Synchronize cabac probabilities with upper-right LCU if it's available.
+    // The first row of a slice or tile, like the first row of the frame, starts from the initial contexts
+    const bool bBelowSync = bWaveFrontsynchro && startRow + 1 < (uint32_t)m_numRows &&
+                            !picSym->isSliceStartRow(startRow + 1) && !picSym->isTileRowStart(startRow + 1);
+    if (bWaveFrontsynchro && !picSym->isSliceStartRow(startRow) && !picSym->isTileRowStart(startRow) && tileWidth > 1)
+    {
+        getSbacCoder(subStrm)->loadContexts(getBufferSBac(subStrm - m_numTileCols));
+    }
+
+    for (uint32_t lin = startRow; lin < endRow; lin++)
+    {
+        for (uint32_t col = tileStartCol; col < tileStartCol + tileWidth; col++)
         {
-            SAOParam *saoParam = slice->getPic()->getPicSym()->getSaoParam();
-            int numCuInWidth     = saoParam->numCuInWidth;
-            int cuAddrInSlice    = cuAddr;
-            int rx = cuAddr % numCuInWidth;
-            int ry = cuAddr / numCuInWidth;
-            int allowMergeLeft = 1;
-            int allowMergeUp   = 1;
-            int addr = cu->getAddr();
-            allowMergeLeft = (rx > 0) && (cuAddrInSlice != 0);
-            allowMergeUp = (ry > 0) && (cuAddrInSlice >= 0);
-            if (saoParam->bSaoFlag[0] || saoParam->bSaoFlag[1])
+            uint32_t cuAddr = lin * widthInLCUs + col;
+            TComDataCU* cu = m_pic->getCU(cuAddr);
+            if (slice->getSPS()->getUseSAO() && (slice->getSaoEnabledFlag() || slice->getSaoEnabledFlagChroma()))
             {
-                int mergeLeft = saoParam->saoLcuParam[0][addr].mergeLeftFlag;
-                int mergeUp = saoParam->saoLcuParam[0][addr].mergeUpFlag;
-                if (allowMergeLeft)
+                SAOParam *saoParam = slice->getPic()->getPicSym()->getSaoParam();
+                int numCuInWidth     = saoParam->numCuInWidth;
+                int cuAddrInSlice    = cuAddr - startCUAddr;
+                int rx = cuAddr % numCuInWidth;
+                int ry = cuAddr / numCuInWidth;
+                int allowMergeLeft = 1;
+                int allowMergeUp   = 1;
+                int addr = cu->getAddr();
+                allowMergeLeft = (rx > 0) && (cuAddrInSlice != 0) && picSym->getTileIdxMap(addr - 1) == picSym->getTileIdxMap(addr);
+                allowMergeUp = (ry > 0) && (cuAddrInSlice >= numCuInWidth) && picSym->getTileIdxMap(addr - numCuInWidth) == picSym->getTileIdxMap(addr);
+                if (saoParam->bSaoFlag[0] || saoParam->bSaoFlag[1])
                 {
-                    entropyCoder->m_entropyCoderIf->codeSaoMerge(mergeLeft);
-                }
-                else
-                {
-                    mergeLeft = 0;
-                }
-                if (mergeLeft == 0)
-                {
-                    if (allowMergeUp)
+                    int mergeLeft = saoParam->saoLcuParam[0][addr].mergeLeftFlag;
+                    int mergeUp = saoParam->saoLcuParam[0][addr].mergeUpFlag;
+                    if (allowMergeLeft)
                     {
-                        entropyCoder->m_entropyCoderIf->codeSaoMerge(mergeUp);
+                        entropyCoder->m_entropyCoderIf->codeSaoMerge(mergeLeft);
                     }
                     else
                     {
-                        mergeUp = 0;
+                        mergeLeft = 0;
                     }
-                    if (mergeUp == 0)
+                    if (mergeLeft == 0)
                     {
-                        for (int compIdx = 0; compIdx < 3; compIdx++)
+                        if (allowMergeUp)
+                        {
+                            entropyCoder->m_entropyCoderIf->codeSaoMerge(mergeUp);
+                        }
+                        else
                         {
-                            if ((compIdx == 0 && saoParam->bSaoFlag[0]) || (compIdx > 0 && saoParam->bSaoFlag[1]))
+                            mergeUp = 0;
+                        }
+                        if (mergeUp == 0)
+                        {
+                            for (int compIdx = 0; compIdx < 3; compIdx++)
                             {
-                                entropyCoder->encodeSaoOffset(&saoParam->saoLcuParam[compIdx][addr], compIdx);
+                                if ((compIdx == 0 && saoParam->bSaoFlag[0]) || (compIdx > 0 && saoParam->bSaoFlag[1]))
+                                {
+                                    entropyCoder->encodeSaoOffset(&saoParam->saoLcuParam[compIdx][addr], compIdx);
+                                }
                             }
                         }
                     }
                 }
             }
-        }
-        else if (slice->getSPS()->getUseSAO())
-        {
-            int addr = cu->getAddr();
-            SAOParam *saoParam = slice->getPic()->getPicSym()->getSaoParam();
-            for (int cIdx = 0; cIdx < 3; cIdx++)
+            else if (slice->getSPS()->getUseSAO())
             {
-                SaoLcuParam *saoLcuParam = &(saoParam->saoLcuParam[cIdx][addr]);
-                if (((cIdx == 0) && !slice->getSaoEnabledFlag()) || ((cIdx == 1 || cIdx == 2) && !slice->getSaoEnabledFlagChroma()))
+                int addr = cu->getAddr();
+                SAOParam *saoParam = slice->getPic()->getPicSym()->getSaoParam();
+                for (int cIdx = 0; cIdx < 3; cIdx++)
                 {
-                    saoLcuParam->mergeUpFlag   = 0;
-                    saoLcuParam->mergeLeftFlag = 0;
-                    saoLcuParam->subTypeIdx    = 0;
-                    saoLcuParam->typeIdx       = -1;
-                    saoLcuParam->offset[0]     = 0;
-                    saoLcuParam->offset[1]     = 0;
-                    saoLcuParam->offset[2]     = 0;
-                    saoLcuParam->offset[3]     = 0;
+                    SaoLcuParam *saoLcuParam = &(saoParam->saoLcuParam[cIdx][addr]);
+                    if (((cIdx == 0) && !slice->getSaoEnabledFlag()) || ((cIdx == 1 || cIdx == 2) && !slice->getSaoEnabledFlagChroma()))
+                    {
+                        saoLcuParam->mergeUpFlag   = 0;
+                        saoLcuParam->mergeLeftFlag = 0;
+                        saoLcuParam->subTypeIdx    = 0;
+                        saoLcuParam->typeIdx       = -1;
+                        saoLcuParam->offset[0]     = 0;
+                        saoLcuParam->offset[1]     = 0;
+                        saoLcuParam->offset[2]     = 0;
+                        saoLcuParam->offset[3]     = 0;
+                    }
                 }
             }
-        }
 
 #if ENC_DEC_TRACE
-        g_bJustDoIt = g_bEncDecTraceEnable;
+            g_bJustDoIt = g_bEncDecTraceEnable;
 #endif
-        getCuEncoder(0)->setEntropyCoder(entropyCoder);
-        getCuEncoder(0)->encodeCU(cu);
+            cuCoder->encodeCU(cu);
 
 #if ENC_DEC_TRACE
-        g_bJustDoIt = g_bEncDecTraceDisable;
+            g_bJustDoIt = g_bEncDecTraceDisable;
 #endif
 
-        // load back status of the entropy coder after encoding the LCU into relevant bitstream entropy coder
-        getSbacCoder(subStrm)->load(&m_sbacCoder);
+            // Store probabilities of second LCU in line into buffer
+            if (bWaveFrontsynchro && col == tileStartCol + 1)
+            {
+                getBufferSBac(subStrm)->loadContexts(getSbacCoder(subStrm));
+            }
+
+            // the substream below may start once the contexts it loads are stored
+            if (bBelowSync && m_bSubstreamJobs && col == tileStartCol + X265_MIN(tileWidth, 2u) - 1)
+            {
+                enqueueSubstream(subStrm + m_numTileCols);
+            }
+        }
+    }
+
+    // Terminating bit and flush.
+    entropyCoder->encodeTerminatingBit(1);
+    entropyCoder->encodeSliceFinish();
+
+    m_outStreams[subStrm].writeByteAlignment(); // Byte-alignment in slice_data() at end of sub-stream
+
+    // Entry points are needed for all but the last substream of the slice
+    uint32_t* substreamSizes = slice->getSubstreamSizes();
+    substreamSizes[subStrm] = m_outStreams[subStrm].getNumberOfWrittenBits() + (m_outStreams[subStrm].countStartCodeEmulations() << 3);
+
+    m_substreamCoded[subStrm].set(1);
+}
+
+/* Derive the search range of each CTU from the largest motion the lookahead
+ * estimated for the lowres blocks under the CTU and next to it, scaled from
+ * the distance of each estimate to the distance of the farthest reference.
+ * Returns the largest range of the frame, or 0 when the lookahead estimated
+ * no motion for the picture */
+int FrameEncoder::computeSearchRanges(TComSlice& slice)
+{
+    Lowres& lowres = m_pic->m_lowres;
+    const MV* estimates[2 * (X265_BFRAME_MAX + 1)];
+    int estimateDist[2 * (X265_BFRAME_MAX + 1)];
+    int numEstimates = 0;
+
+    for (int dist = 1; dist <= lowres.bframes + 1; dist++)
+    {
+        for (int dir = 0; dir < 2; dir++)
+        {
+            if (lowres.lowresMvs[dir][dist - 1][0].x != 0x7FFF)
+            {
+                estimates[numEstimates] = lowres.lowresMvs[dir][dist - 1];
+                estimateDist[numEstimates++] = dist;
+            }
+        }
+    }
 
-        // Store probabilities of second LCU in line into buffer
-        if ((numSubstreams > 1) && (col == 1) && bWaveFrontsynchro)
+    int refDist = 0;
+    int numPredDir = slice.isInterP() ? 1 : slice.isInterB() ? 2 : 0;
+    for (int l = 0; l < numPredDir; l++)
+    {
+        for (int ref = 0; ref < slice.getNumRefIdx(l); ref++)
         {
-            getBufferSBac(lin)->loadContexts(getSbacCoder(subStrm));
+            refDist = X265_MAX(refDist, abs(slice.getPOC() - slice.getRefPic(l, ref)->getPOC()));
         }
     }
 
-    if (slice->getPPS()->getCabacInitPresentFlag())
+    if (!numEstimates || !refDist)
+        return 0;
+
+    const int maxRange = m_cfg->param->searchRange;
+    const int lowresWidth = ((m_cfg->param->sourceWidth / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+    const int lowresHeight = ((m_cfg->param->sourceHeight / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
+    const int numCols = m_pic->getPicSym()->getFrameWidthInCU();
+
+    /* each lowres block covers 16x16 full resolution pixels */
+    const int blocksPerCTU = g_maxCUSize >> (X265_LOWRES_CU_BITS + 1);
+
+    int frameRange = 0;
+    for (int row = 0; row < m_numRows; row++)
     {
-        entropyCoder->determineCabacInitIdx();
+        int y0 = X265_MAX(row * blocksPerCTU - 1, 0);
+        int y1 = X265_MIN((row + 1) * blocksPerCTU, lowresHeight - 1);
+        for (int col = 0; col < numCols; col++)
+        {
+            int x0 = X265_MAX(col * blocksPerCTU - 1, 0);
+            int x1 = X265_MIN((col + 1) * blocksPerCTU, lowresWidth - 1);
+
+            int motion = 0;
+            for (int e = 0; e < numEstimates; e++)
+            {
+                int maxMv = 0;
+                for (int y = y0; y <= y1; y++)
+                {
+                    const MV* mvs = estimates[e] + y * lowresWidth;
+                    for (int x = x0; x <= x1; x++)
+                    {
+                        maxMv = X265_MAX(maxMv, X265_MAX(abs(mvs[x].x), abs(mvs[x].y)));
+                    }
+                }
+
+                /* lowres quarter pel to full resolution full pel, at the
+                 * distance of the farthest reference */
+                int dist = estimateDist[e];
+                motion = X265_MAX(motion, (maxMv * refDist + 2 * dist - 1) / (2 * dist));
+            }
+
+            int range = X265_MIN(X265_MAX(motion + ADAPTIVE_MERANGE_MARGIN, ADAPTIVE_MERANGE_MIN), maxRange);
+            m_ctuSearchRange[row * numCols + col] = range;
+            frameRange = X265_MAX(frameRange, range);
+        }
     }
+
+    return frameRange;
 }
 
 /** Determines the starting and bounding LCU address of current slice / dependent slice
@@ -949,9 +1185,12 @@ void FrameEncoder::compressCTURows()
     PPAScopeEvent(FrameEncoder_compressRows);
     TComSlice* slice = m_pic->getSlice();
 
+    TComPicSym* picSym = m_pic->getPicSym();
+    const uint32_t numCols = picSym->getFrameWidthInCU();
+
     // reset entropy coders
     m_sbacCoder.init(&m_binCoderCABAC);
-    for (int i = 0; i < this->m_numRows; i++)
+    for (int i = 0; i < this->m_numRows * m_numTileCols; i++)
     {
         m_rows[i].init(slice);
         m_rows[i].m_entropyCoder.setEntropyCoder(&m_sbacCoder, slice);
@@ -960,31 +1199,125 @@ void FrameEncoder::compressCTURows()
         m_rows[i].m_rdSbacCoders[0][CI_CURR_BEST]->load(&m_sbacCoder);
         m_rows[i].m_rdGoOnBinCodersCABAC.m_fracBits = 0;
         m_rows[i].m_completed = 0;
-        m_rows[i].m_busy = false;
+        m_rows[i].m_busy.set(0);
+        m_rows[i].m_refCols = numCols;
+        m_rows[i].m_refStalled = false;
     }
 
+    for (int i = 0; i < this->m_numRows; i++)
+    {
+        m_rowSegmentsDone[i] = 0;
+    }
+
+    m_numRowsDone = 0;
+
     bool bUseWeightP = slice->getPPS()->getUseWP() && slice->getSliceType() == P_SLICE;
     bool bUseWeightB = slice->getPPS()->getWPBiPred() && slice->getSliceType() == B_SLICE;
-    int range = m_cfg->param->searchRange; /* fpel search */
+    int range = m_searchRange;            /* fpel search */
     range    += 1;                        /* diamond search range check lag */
     range    += 2;                        /* subpel refine */
     range    += NTAPS_LUMA / 2;           /* subpel filter half-length */
     int refLagRows = 1 + ((range + g_maxCUSize - 1) / g_maxCUSize);
+    int refLagCols = (range + g_maxCUSize - 1) / g_maxCUSize;
     int numPredDir = slice->isInterP() ? 1 : slice->isInterB() ? 2 : 0;
 
     m_pic->m_SSDY = 0;
     m_pic->m_SSDU = 0;
     m_pic->m_SSDV = 0;
+    m_pic->m_ssim = 0;
+    m_pic->m_ssimCnt = 0;
 
     m_frameFilter.start(m_pic);
 
-    m_rows[0].m_active = true;
+    // the first row segments of each tile have no neighbor dependencies
+    for (int row = 0; row < m_numRows; row++)
+    {
+        if (picSym->isTileRowStart(row))
+        {
+            for (int t = 0; t < m_numTileCols; t++)
+            {
+                m_rows[row * m_numTileCols + t].m_active = true;
+            }
+        }
+    }
+
     if (m_pool && m_cfg->param->bEnableWavefront)
     {
         WaveFront::clearEnabledRowMask();
         WaveFront::enqueue();
 
-        for (int row = 0; row < m_numRows; row++)
+        // the substream jobs are enqueued by encodeSlices() and each other
+        for (int i = 0; m_bStreamSlices && i < m_numRows * m_numTileCols; i++)
+        {
+            WaveFront::enableRow(m_numRows * (m_numTileCols + 1) + i);
+        }
+
+        /* Weighted references are weighted a row at a time, so CTU granular
+         * reference sync is only possible with unweighted references. The
+         * column limits are tracked per CU row, so not with tiles either */
+        bool bColSync = m_cfg->param->bEnableCtuRefSync && m_cfg->param->frameNumThreads > 1 && !(bUseWeightP || bUseWeightB) &&
+                        !picSym->hasTiles();
+
+        /* Rows are enabled as soon as the first CTUs of their reference areas
+         * are available, then the CTU limit of each enabled row is raised as
+         * the reference frames progress. first is the lowest row whose limit
+         * is not yet numCols, next is the next row to enable */
+        int first = 0, next = 0;
+        while (bColSync && first < m_numRows)
+        {
+            ThreadSafeInteger *waitCount = NULL;
+            int waitVal = 0;
+
+            for (int row = first; row <= next && row < m_numRows; row++)
+            {
+                ThreadSafeInteger *limitCount = NULL;
+                int limitVal = 0;
+                uint32_t cols = (uint32_t)refColumnLimit(row, refLagRows, refLagCols, &limitCount, &limitVal);
+
+                if (row == next)
+                {
+                    if (!cols)
+                    {
+                        waitCount = limitCount;
+                        waitVal = limitVal;
+                        break;
+                    }
+
+                    m_rows[row].m_refCols = cols;
+                    enableRowEncoder(row);
+                    if (row == 0)
+                        enqueueRowEncoder(0, 0);
+                    else
+                        m_pool->pokeIdleThread(m_node);
+                    next++;
+                }
+                else if (cols > m_rows[row].m_refCols)
+                {
+                    ScopedLock self(m_rows[row].m_lock);
+                    m_rows[row].m_refCols = cols;
+                    if (m_rows[row].m_refStalled)
+                    {
+                        m_rows[row].m_refStalled = false;
+                        m_rows[row].m_active = true;
+                        enqueueRowEncoder(row, 0);
+                    }
+                }
+
+                if (cols < numCols && !waitCount)
+                {
+                    waitCount = limitCount;
+                    waitVal = limitVal;
+                }
+            }
+
+            while (first < next && m_rows[first].m_refCols == numCols)
+                first++;
+
+            if (waitCount)
+                waitCount->waitForChange(waitVal);
+        }
+
+        for (int row = 0; row < m_numRows && !bColSync; row++)
         {
             // block until all reference frames have reconstructed the rows we need
             for (int l = 0; l < numPredDir; l++)
@@ -1005,12 +1338,16 @@ void FrameEncoder::compressCTURows()
             }
 
             enableRowEncoder(row);
-            if (row == 0)
-                enqueueRowEncoder(0);
+            if (picSym->isTileRowStart(row))
+                enqueueRowEncoder(row);
             else
-                m_pool->pokeIdleThread();
+                m_pool->pokeIdleThread(m_node);
         }
 
+        // entropy code and output the slices as their rows are reconstructed
+        if (m_bStreamSlices)
+            encodeSlices();
+
         m_completionEvent.wait();
 
         WaveFront::dequeue();
@@ -1041,27 +1378,85 @@ void FrameEncoder::compressCTURows()
                     }
                 }
 
-                processRow(i * 2 + 0);
+                for (int t = 0; t < m_numTileCols; t++)
+                {
+                    processRow(i * (m_numTileCols + 1) + t);
+                }
             }
 
             // Filter
             if (i >= m_filterRowDelay)
             {
-                processRow((i - m_filterRowDelay) * 2 + 1);
+                processRow((i - m_filterRowDelay) * (m_numTileCols + 1) + m_numTileCols);
             }
         }
     }
+
+    // fold the QP sums of the row segments into the per row sums used by rate control
+    for (int row = 0; row < m_numRows; row++)
+    {
+        double qpaAq = 0, qpaRc = 0;
+        for (int t = 0; t < m_numTileCols; t++)
+        {
+            qpaAq += m_rows[row * m_numTileCols + t].m_qpaAq;
+            qpaRc += m_rows[row * m_numTileCols + t].m_qpaRc;
+        }
+
+        if (m_pic->m_qpaAq)
+            m_pic->m_qpaAq[row] = qpaAq;
+        if (m_pic->m_qpaRc)
+            m_pic->m_qpaRc[row] = qpaRc;
+    }
+
     m_pic->m_frameTime = (double)m_totalTime / 1000000;
     m_totalTime = 0;
 }
 
+/* Returns the number of CUs of the given row which may be encoded with the
+ * reference pixels currently available in all reference frames. The counter
+ * which limits the result and its value are returned for waiting on */
+int FrameEncoder::refColumnLimit(int row, int refLagRows, int refLagCols, ThreadSafeInteger **limitCount, int *limitVal)
+{
+    TComSlice* slice = m_pic->getSlice();
+    const int numCols = m_pic->getPicSym()->getFrameWidthInCU();
+    const int refRow = X265_MIN(row + refLagRows - 1, m_numRows - 1);
+    int numPredDir = slice->isInterP() ? 1 : slice->isInterB() ? 2 : 0;
+    int limit = numCols;
+
+    for (int l = 0; l < numPredDir; l++)
+    {
+        for (int ref = 0; ref < slice->getNumRefIdx(l); ref++)
+        {
+            TComPic *refpic = slice->getRefPic(l, ref);
+            int count = refpic->m_reconColCount[refRow].get();
+            int avail = count >= numCols ? numCols : X265_MAX(count - refLagCols, 0);
+
+            if (avail < limit)
+            {
+                limit = avail;
+                *limitCount = &refpic->m_reconColCount[refRow];
+                *limitVal = count;
+            }
+        }
+    }
+
+    return limit;
+}
+
 // Called by worker threads
-void FrameEncoder::processRowEncoder(int row)
+void FrameEncoder::processRowEncoder(int row, int tileCol)
 {
     PPAScopeEvent(Thread_ProcessRow);
 
-    CTURow& codeRow = m_rows[m_cfg->param->bEnableWavefront ? row : 0];
-    CTURow& curRow  = m_rows[row];
+    TComPicSym* picSym = m_pic->getPicSym();
+    const int segment = row * m_numTileCols + tileCol;
+
+    /* With WPP or tiles each row segment is analyzed by its own coders,
+     * starting from the contexts saved by the segment above */
+    const bool bWaveFrontsynchro = m_pic->getSlice()->getPPS()->getEntropyCodingSyncEnabledFlag();
+    const bool bSegmentCoders = bWaveFrontsynchro || picSym->hasTiles();
+    CTURow& codeRow = m_rows[bSegmentCoders ? segment : 0];
+    CTURow& curRow  = m_rows[segment];
     {
         ScopedLock self(curRow.m_lock);
         if (!curRow.m_active)
@@ -1069,7 +1464,7 @@ void FrameEncoder::processRowEncoder(int row)
             /* VBV restart is in progress, exit out */
             return;
         }
-        if (curRow.m_busy)
+        if (curRow.m_busy.get())
         {
             /* On multi-socket Windows servers, we have seen problems with
              * ATOMIC_CAS which resulted in multiple worker threads processing
@@ -1080,17 +1475,42 @@ void FrameEncoder::processRowEncoder(int row)
                      "internal error - simulaneous row access detected. Please report HW to x265-devel@videolan.org\n");
             return;
         }
-        curRow.m_busy = true;
+        curRow.m_busy.set(1);
     }
 
     int64_t startTime = x265_mdate();
-    const uint32_t numCols = m_pic->getPicSym()->getFrameWidthInCU();
-    const uint32_t lineStartCUAddr = row * numCols;
-    bool bIsVbv = m_cfg->param->rc.vbvBufferSize > 0 && m_cfg->param->rc.vbvMaxBitrate > 0;
+    const uint32_t numCols = picSym->getFrameWidthInCU();
+    const uint32_t tileStartCol = picSym->getTileColBase(tileCol);
+    const uint32_t tileWidth = picSym->getTileColBase(tileCol + 1) - tileStartCol;
+    const uint32_t lineStartCUAddr = row * numCols + tileStartCol;
+    const bool bTileRowStart = picSym->isTileRowStart(row);
+
+    /* without entropy sync the rows of a tile are coded in order, the row
+     * segment below may only start once this one is complete */
+    const uint32_t belowRowLag = bWaveFrontsynchro ? 2 : tileWidth;
 
-    while (curRow.m_completed < numCols)
+    /* row diagonal VBV rate control needs the whole CU rows of the frame */
+    bool bIsVbv = m_cfg->param->rc.vbvBufferSize > 0 && m_cfg->param->rc.vbvMaxBitrate > 0 && !picSym->hasTiles();
+
+    while (curRow.m_completed < tileWidth)
     {
+        /* col is relative to the start of the tile column */
         int col = curRow.m_completed;
+        if (tileStartCol + col >= curRow.m_refCols)
+        {
+            /* the reference frames have not yet reconstructed the pixels this
+             * CU may reference, the frame encoder thread re-enqueues the row */
+            ScopedLock self(curRow.m_lock);
+            if (tileStartCol + col >= curRow.m_refCols)
+            {
+                curRow.m_active = false;
+                curRow.m_busy.set(0);
+                curRow.m_refStalled = true;
+                m_totalTime += x265_mdate() - startTime;
+                return;
+            }
+        }
+
         const uint32_t cuAddr = lineStartCUAddr + col;
         TComDataCU* cu = m_pic->getCU(cuAddr);
         cu->initCU(m_pic, cuAddr);
@@ -1112,20 +1532,39 @@ void FrameEncoder::processRowEncoder(int row)
         if (m_cfg->param->rc.aqMode || bIsVbv)
         {
             int qp = calcQpForCu(cuAddr, cu->m_baseQp);
-            setLambda(qp, row);
+            setLambda(qp, segment);
             qp = Clip3(-QP_BD_OFFSET, MAX_QP, qp);
             cu->setQPSubParts(char(qp), 0, 0);
             if (m_cfg->param->rc.aqMode)
-                m_pic->m_qpaAq[row] += qp;
+                curRow.m_qpaAq += qp;
         }
 
-        TEncSbac *bufSbac = (m_cfg->param->bEnableWavefront && col == 0 && row > 0) ? &m_rows[row - 1].m_bufferSbacCoder : NULL;
+        TEncSbac *bufSbac = NULL;
         codeRow.m_entropyCoder.setEntropyCoder(&m_sbacCoder, m_pic->getSlice());
         codeRow.m_entropyCoder.resetEntropy();
-        codeRow.processCU(cu, m_pic->getSlice(), bufSbac, m_cfg->param->bEnableWavefront && col == 1);
+        if (col == 0 && (picSym->isSliceStartRow(row) || bTileRowStart))
+        {
+            /* CABAC contexts are reset at the start of each slice and tile. With
+             * WPP the RD coders of each row already start from the initial contexts */
+            if (!bWaveFrontsynchro)
+                bufSbac = &m_sbacCoder;
+        }
+        else if (bSegmentCoders && col == 0)
+            bufSbac = &m_rows[segment - m_numTileCols].m_bufferSbacCoder;
+
+        /* WPP rows continue from the contexts after the second CU of the row
+         * above, tile rows from the contexts at the end of the row above */
+        bool bSaveSbac = bWaveFrontsynchro ? col == 1 : bSegmentCoders && (uint32_t)col == tileWidth - 1;
+        codeRow.processCU(cu, m_pic->getSlice(), bufSbac, bSaveSbac);
+        if (m_frameFilter.m_bInlineFilter)
+            m_frameFilter.processCTU(row, col, m_cfg);
+
         // Completed CU processing
         curRow.m_completed++;
 
+        if (m_pic->m_qpaRc)
+            curRow.m_qpaRc += cu->m_baseQp;
+
         if (bIsVbv)
         {
             // Update encoded bits, satdCost, baseQP for each CU
@@ -1133,7 +1572,6 @@ void FrameEncoder::processRowEncoder(int row)
             m_pic->m_rowDiagIntraSatd[row] += m_pic->m_intraCuCostsForVbv[cuAddr];
             m_pic->m_rowEncodedBits[row] += cu->m_totalBits;
             m_pic->m_numEncodedCusPerRow[row] = cuAddr;
-            m_pic->m_qpaRc[row] += cu->m_baseQp;
 
             // If current block is at row diagonal checkpoint, call vbv ratecontrol.
  
@@ -1162,34 +1600,29 @@ void FrameEncoder::processRowEncoder(int row)
                         {
                             /* if row was active (ready to be run) clear active bit and bitmap bit for this row */
                             stopRow.m_lock.acquire();
+                            stopRow.m_refStalled = false;
                             while (stopRow.m_active)
                             {
-                                if (dequeueRow(r * 2))
+                                /* dequeueRow() only fails when another thread
+                                 * changed the bitmap word, retry at once */
+                                if (dequeueRow(r * (m_numTileCols + 1)))
                                     stopRow.m_active = false;
                                 else
-                                    GIVE_UP_TIME();
+                                    CPU_PAUSE();
                             }
                             stopRow.m_lock.release();
 
-                            bool bRowBusy = true;
-                            do
-                            {
-                                stopRow.m_lock.acquire();
-                                bRowBusy = stopRow.m_busy;
-                                stopRow.m_lock.release();
-
-                                if (bRowBusy)
-                                {
-                                    GIVE_UP_TIME();
-                                }
-                            }
-                            while (bRowBusy);
+                            /* wait for a worker thread to exit the row */
+                            int64_t waitStart = x265_mdate();
+                            int busy = stopRow.m_busy.get();
+                            while (busy)
+                                busy = stopRow.m_busy.waitForChange(busy, X265_SPIN_COUNT);
+                            m_vbvRestartWaitTime += x265_mdate() - waitStart;
                         }
 
                         stopRow.m_completed = 0;
-                        if (m_pic->m_qpaAq)
-                            m_pic->m_qpaAq[r] = 0;
-                        m_pic->m_qpaRc[r] = 0;
+                        stopRow.m_qpaAq = 0;
+                        stopRow.m_qpaRc = 0;
                         m_pic->m_rowEncodedBits[r] = 0;
                         m_pic->m_numEncodedCusPerRow[r] = 0;
                     }
@@ -1198,49 +1631,69 @@ void FrameEncoder::processRowEncoder(int row)
                 }
             }
         }
-        if (curRow.m_completed >= 2 && row < m_numRows - 1)
+        /* the row segment below, within the same tile, may start once this
+         * segment is far enough ahead of it */
+        if (curRow.m_completed >= belowRowLag && row < m_numRows - 1 && !picSym->isTileRowStart(row + 1))
         {
-            ScopedLock below(m_rows[row + 1].m_lock);
-            if (m_rows[row + 1].m_active == false &&
-                m_rows[row + 1].m_completed + 2 <= curRow.m_completed &&
+            CTURow& belowRow = m_rows[segment + m_numTileCols];
+            ScopedLock below(belowRow.m_lock);
+            if (belowRow.m_active == false &&
+                belowRow.m_completed + 2 <= curRow.m_completed &&
                 (!m_bAllRowsStop || row + 1 < m_vbvResetTriggerRow))
             {
-                m_rows[row + 1].m_active = true;
-                enqueueRowEncoder(row + 1);
+                belowRow.m_active = true;
+                belowRow.m_refStalled = false;
+                enqueueRowEncoder(row + 1, tileCol);
             }
         }
 
         ScopedLock self(curRow.m_lock);
         if ((m_bAllRowsStop && row > m_vbvResetTriggerRow) || 
-            (row > 0 && curRow.m_completed < numCols - 1 && m_rows[row - 1].m_completed < m_rows[row].m_completed + 2))
+            (!bTileRowStart && curRow.m_completed < tileWidth - 1 && m_rows[segment - m_numTileCols].m_completed < curRow.m_completed + 2))
         {
             curRow.m_active = false;
-            curRow.m_busy = false;
+            curRow.m_busy.set(0);
             m_totalTime += x265_mdate() - startTime;
             return;
         }
     }
 
-    // this row of CTUs has been encoded
+    // this row segment of CTUs has been encoded
+    rowSegmentDone(row);
 
-    // trigger row-wise loop filters
-    if (row >= m_filterRowDelay)
-    {
-        enableRowFilter(row - m_filterRowDelay);
+    m_totalTime += x265_mdate() - startTime;
+    curRow.m_busy.set(0);
+}
 
-        // NOTE: Active Filter to first row (row 0)
-        if (row == m_filterRowDelay)
-            enqueueRowFilter(0);
-    }
-    if (row == m_numRows - 1)
+void FrameEncoder::rowSegmentDone(int row)
+{
+    ScopedLock self(m_rowDoneLock);
+
+    if (++m_rowSegmentsDone[row] < m_numTileCols)
+        return;
+
+    // trigger row-wise loop filters in row order, the rows of different
+    // tiles may complete out of order
+    while (m_numRowsDone < m_numRows && m_rowSegmentsDone[m_numRowsDone] == m_numTileCols)
     {
-        for (int i = m_numRows - m_filterRowDelay; i < m_numRows; i++)
+        int doneRow = m_numRowsDone++;
+
+        if (doneRow >= m_filterRowDelay)
+        {
+            enableRowFilter(doneRow - m_filterRowDelay);
+
+            // NOTE: Active Filter to first row (row 0)
+            if (doneRow == m_filterRowDelay)
+                enqueueRowFilter(0);
+        }
+        if (doneRow == m_numRows - 1)
         {
-            enableRowFilter(i);
+            for (int i = m_numRows - m_filterRowDelay; i < m_numRows; i++)
+            {
+                enableRowFilter(i);
+            }
         }
     }
-    m_totalTime += x265_mdate() - startTime;
-    curRow.m_busy = false;
 }
 
 int FrameEncoder::calcQpForCu(uint32_t cuAddr, double baseQp)
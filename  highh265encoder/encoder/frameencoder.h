@@ -63,42 +63,59 @@ public:
 
     void destroy();
 
-    void processRowEncoder(int row);
+    void processRowEncoder(int row, int tileCol);
 
     void processRowFilter(int row)
     {
         m_frameFilter.processRow(row, m_cfg);
     }
 
+    /* Each CU row has one encoder job per tile column followed by its filter
+     * job, so rows are still serviced in wave-front order */
+    void enqueueRowEncoder(int row, int tileCol)
+    {
+        WaveFront::enqueueRow(row * (m_numTileCols + 1) + tileCol);
+    }
+
     void enqueueRowEncoder(int row)
     {
-        WaveFront::enqueueRow(row * 2 + 0);
+        for (int t = 0; t < m_numTileCols; t++)
+            enqueueRowEncoder(row, t);
     }
 
     void enqueueRowFilter(int row)
     {
-        WaveFront::enqueueRow(row * 2 + 1);
+        WaveFront::enqueueRow(row * (m_numTileCols + 1) + m_numTileCols);
     }
 
     void enableRowEncoder(int row)
     {
-        WaveFront::enableRow(row * 2 + 0);
+        for (int t = 0; t < m_numTileCols; t++)
+            WaveFront::enableRow(row * (m_numTileCols + 1) + t);
     }
 
     void enableRowFilter(int row)
     {
-        WaveFront::enableRow(row * 2 + 1);
+        WaveFront::enableRow(row * (m_numTileCols + 1) + m_numTileCols);
     }
 
     void processRow(int row)
     {
-        const int realRow = row >> 1;
-        const int typeNum = row & 1;
+        const int rowJobs = m_numTileCols + 1;
+
+        if (row >= m_numRows * rowJobs)
+        {
+            // Substream entropy coding jobs follow the CU row encoders and filters
+            encodeSubstream(row - m_numRows * rowJobs);
+            return;
+        }
+
+        const int realRow = row / rowJobs;
+        const int typeNum = row % rowJobs;
 
-        // TODO: use switch when more type
-        if (typeNum == 0)
+        if (typeNum < m_numTileCols)
         {
-            processRowEncoder(realRow);
+            processRowEncoder(realRow, typeNum);
         }
         else
         {
@@ -112,6 +129,8 @@ public:
         }
     }
 
+    /* CTURow accessors, indexed by row segment (row * m_numTileCols + tileCol),
+     * which is also the substream index of the segment */
     TEncEntropy* getEntropyCoder(int row)      { return &this->m_rows[row].m_entropyCoder; }
 
     TEncSbac*    getSbacCoder(int row)         { return &this->m_rows[row].m_sbacCoder; }
@@ -125,26 +144,38 @@ public:
     /* Frame singletons, last the life of the encoder */
     TEncSampleAdaptiveOffset* getSAO()         { return &m_frameFilter.m_sao; }
 
-    void resetEntropy(TComSlice *slice)
-    {
-        for (int i = 0; i < this->m_numRows; i++)
-        {
-            this->m_rows[i].m_entropyCoder.setEntropyCoder(&this->m_rows[i].m_sbacCoder, slice);
-            this->m_rows[i].m_entropyCoder.resetEntropy();
-        }
-    }
-
     int getStreamHeaders(NALUnitEBSP **nalunits);
 
     void initSlice(TComPic* pic);
 
+    /* pick up the analysis parameters changed by x265_encoder_reconfig(),
+     * called between frames while the frame encoder is idle */
+    void reconfigure(x265_param *param);
+
     /* analyze / compress frame, can be run in parallel within reference constraints */
     void compressFrame();
 
     /* called by compressFrame to perform wave-front compression analysis */
     void compressCTURows();
 
-    void encodeSlice(TComOutputBitstream* substreams);
+    /* entropy code the slices of the compressed frame and append their NAL
+     * units, called once the CU rows of each slice are reconstructed */
+    void encodeSlices();
+
+    /* entropy code one substream of the compressed frame */
+    void encodeSubstream(int subStrm);
+
+    void enqueueSubstream(int subStrm)
+    {
+        WaveFront::enqueueRow(m_numRows * (m_numTileCols + 1) + subStrm);
+    }
+
+    /* enqueue the substream jobs of one slice which have no dependencies */
+    void enqueueSliceSubstreams(int sliceIdx, uint32_t* sliceSubstreams);
+
+    /* pass the NAL units appended since the last call to the low latency
+     * output function, if any. bLast ends the access unit */
+    void outputNals(bool bLast);
 
     /* blocks until worker thread is done, returns encoded picture and bitstream */
     TComPic *getEncodedPicture(NALUnitEBSP **nalunits);
@@ -159,26 +190,50 @@ public:
     bool                     m_threadActive;
 
     int                      m_numRows;
+    int                      m_numTileCols;
     CTURow*                  m_rows;
     SEIWriter                m_seiWriter;
     TComSPS                  m_sps;
     TComPPS                  m_pps;
     RateControlEntry         m_rce;
+
+    /* copy of the encoder parameters read by the CU analysis of this frame
+     * encoder, so they may be reconfigured while other frames are encoded */
+    x265_param               m_param;
     SEIDecodedPictureHash    m_seiReconPictureDigest;
 
+    /* encode order of the picture, NAL units are output in this order */
+    int                      m_outputIndex;
+
     volatile bool            m_bAllRowsStop;
     volatile int             m_vbvResetTriggerRow;
 
+    /* wall time (us) VBV restarts have spent waiting for rows to stop */
+    int64_t                  m_vbvRestartWaitTime;
+
 protected:
 
     void determineSliceBounds();
     int calcQpForCu(uint32_t cuAddr, double baseQp);
+    int computeSearchRanges(TComSlice& slice);
+    int refColumnLimit(int row, int refLagRows, int refLagCols, ThreadSafeInteger **limitCount, int *limitVal);
     Encoder*                 m_top;
     Encoder*                 m_cfg;
 
     MotionReference          m_mref[2][MAX_NUM_REF + 1];
+
+    /* search range of the frame being encoded, and of each of its CTUs when
+     * the range adapts to the lookahead's motion, see --adaptive-merange */
+    int                      m_searchRange;
+    int*                     m_ctuSearchRange;
+
     TEncSbac                 m_sbacCoder;
     TEncBinCABAC             m_binCoderCABAC;
+
+    /* writes the slice headers, m_sbacCoder provides the initial contexts of
+     * the CU rows which may still be compressing */
+    TEncSbac                 m_headerSbacCoder;
+    TEncBinCABAC             m_headerBinCoder;
     FrameFilter              m_frameFilter;
     TComBitCounter           m_bitCounter;
 
@@ -189,6 +244,34 @@ protected:
 
     int                      m_filterRowDelay;
     Event                    m_completionEvent;
+
+    /* With tiles the CU rows may complete out of order. Count the completed
+     * tile column segments of each row, and the number of leading rows which
+     * are complete, to trigger the row filters in order */
+    Lock                     m_rowDoneLock;
+    int*                     m_rowSegmentsDone;
+    int                      m_numRowsDone;
+
+    void rowSegmentDone(int row);
+
+    /* substreams of the frame being entropy coded, one per row segment, and
+     * their completion flags. When m_bSubstreamJobs is set the substreams are
+     * coded by thread pool jobs, in a wave-front pattern with WPP */
+    TComOutputBitstream*     m_outStreams;
+    ThreadSafeInteger*       m_substreamCoded;
+    bool                     m_bSubstreamJobs;
+
+    /* the slices are entropy coded and output while the CU rows below them
+     * are compressed, see x265_param.nalOutput */
+    bool                     m_bStreamSlices;
+
+    /* count of m_nalList entries already passed to the output function, and
+     * the buffer they were written to */
+    int                      m_nalOutputCount;
+    uint8_t*                 m_nalOutputBuf;
+    uint32_t                 m_nalOutputBufSize;
+    x265_nal                 m_nalOutputDesc[MAX_NAL_UNITS];
+
     int64_t                  m_totalTime;
     bool                     m_isReferenced;
 };
@@ -37,8 +37,11 @@ static float calculateSSIM(pixel *pix1, intptr_t stride1, pixel *pix2, intptr_t
 // **************************************************************************
 FrameFilter::FrameFilter()
     : m_param(NULL)
+    , m_rowLoopFilter(NULL)
+    , m_bInlineFilter(false)
     , m_rdGoOnBinCodersCABAC(true)
     , m_ssimBuf(NULL)
+    , m_bMetricsJobs(false)
 {
 }
 
@@ -49,6 +52,16 @@ void FrameFilter::destroy()
         m_loopFilter.destroy();
     }
 
+    if (m_rowLoopFilter)
+    {
+        for (int i = 0; i < m_numRows; i++)
+        {
+            m_rowLoopFilter[i].destroy();
+        }
+
+        delete[] m_rowLoopFilter;
+    }
+
     if (m_param->bEnableSAO)
     {
         // NOTE: I don't check sao flag since loopfilter and sao have same control status
@@ -56,9 +69,12 @@ void FrameFilter::destroy()
         m_sao.destroyEncBuffer();
     }
     X265_FREE(m_ssimBuf);
+
+    if (m_bMetricsJobs)
+        m_metrics.flush();
 }
 
-void FrameFilter::init(Encoder *top, int numRows, TEncSbac* rdGoOnSbacCoder)
+void FrameFilter::init(Encoder *top, int numRows, TEncSbac* rdGoOnSbacCoder, ThreadPool* pool, int node)
 {
     m_param = top->param;
     m_numRows = numRows;
@@ -68,9 +84,23 @@ void FrameFilter::init(Encoder *top, int numRows, TEncSbac* rdGoOnSbacCoder)
     // NOTE: for sao only, I write this code because I want to exact match with HM's bug bitstream
     m_rdGoOnSbacCoderRow0 = rdGoOnSbacCoder;
 
+    // CTUs of different tiles are reconstructed out of raster order, so the
+    // inline filter cannot rely on the left and above CTUs being done
+    m_bInlineFilter = !m_param->bEnableSAO && !(m_param->rc.vbvBufferSize > 0 && m_param->rc.vbvMaxBitrate > 0) &&
+                      m_param->tileColumns * m_param->tileRows == 1;
+
     if (top->param->bEnableLoopFilter)
     {
         m_loopFilter.create(g_maxCUDepth);
+
+        if (m_bInlineFilter)
+        {
+            m_rowLoopFilter = new TComLoopFilter[numRows];
+            for (int i = 0; i < numRows; i++)
+            {
+                m_rowLoopFilter[i].create(g_maxCUDepth);
+            }
+        }
     }
 
     if (top->param->bEnableSAO)
@@ -84,14 +114,30 @@ void FrameFilter::init(Encoder *top, int numRows, TEncSbac* rdGoOnSbacCoder)
 
     if (m_param->bEnableSsim)
         m_ssimBuf = (int*)x265_malloc(sizeof(int) * 8 * (m_param->sourceWidth / 4 + 3));
+
+    if (pool && (m_param->bEnablePsnr || m_param->bEnableSsim || m_param->decodedPictureHashSEI))
+    {
+        m_metrics.setThreadPool(pool);
+        m_metrics.setNode(node);
+        m_metrics.setPriority(JobProvider::PRIORITY_LOW);
+        m_bMetricsJobs = m_metrics.init(this, top, numRows);
+    }
 }
 
 void FrameFilter::start(TComPic *pic)
 {
     m_pic = pic;
+    m_pic->m_bMetricsSampled = (pic->getPOC() % m_param->metricsInterval) == 0;
 
     m_saoRowDelay = m_param->bEnableLoopFilter ? 1 : 0;
     m_loopFilter.setCfg(pic->getSlice()->getPPS()->getLoopFilterAcrossTilesEnabledFlag());
+    if (m_rowLoopFilter)
+    {
+        for (int i = 0; i < m_numRows; i++)
+        {
+            m_rowLoopFilter[i].setCfg(pic->getSlice()->getPPS()->getLoopFilterAcrossTilesEnabledFlag());
+        }
+    }
     m_rdGoOnSbacCoder.init(&m_rdGoOnBinCodersCABAC);
     m_entropyCoder.setEntropyCoder(&m_rdGoOnSbacCoder, pic->getSlice());
     m_entropyCoder.setBitstream(&m_bitCounter);
@@ -114,17 +160,32 @@ void FrameFilter::start(TComPic *pic)
             saoParam->bSaoFlag[1] = true;
         }
     }
+
+    if (m_bMetricsJobs)
+        m_metrics.start();
 }
 
 void FrameFilter::end()
 {
 }
 
+void FrameFilter::finishMetrics()
+{
+    if (m_bMetricsJobs)
+        m_metrics.finish();
+}
+
 void FrameFilter::processRow(int row, Encoder* cfg)
 {
     PPAScopeEvent(Thread_filterCU);
 
-    if (!m_param->bEnableLoopFilter && !m_param->bEnableSAO)
+    if (m_bInlineFilter)
+    {
+        // the CU row encoders have filtered and extended all other rows
+        if (row != m_numRows - 1 || !m_param->bEnableLoopFilter)
+            return;
+    }
+    else if (!m_param->bEnableLoopFilter && !m_param->bEnableSAO)
     {
         processRowPost(row, cfg);
         return;
@@ -209,36 +270,132 @@ void FrameFilter::processRow(int row, Encoder* cfg)
     }
 }
 
-void FrameFilter::processRowPost(int row, Encoder* cfg)
+void FrameFilter::processCTU(int row, int col, Encoder* cfg)
 {
-    const uint32_t numCols = m_pic->getPicSym()->getFrameWidthInCU();
-    const uint32_t lineStartCUAddr = row * numCols;
+    const int numCols = m_pic->getPicSym()->getFrameWidthInCU();
+
+    if (!m_param->bEnableLoopFilter)
+    {
+        // without any filters the CTU is final once it is reconstructed
+        processCTUPost(row, col);
+        if (col == numCols - 1)
+            processRowPost(row, cfg);
+        return;
+    }
+
+    if (!row)
+        return;
+
+    // this row has encoded the CTUs below and below-right of CTU col - 1 of
+    // the row above, so intra prediction no longer needs its unfiltered pixels
+    if (col > 0)
+        deblockCTU(row - 1, col - 1);
+
+    if (col == numCols - 1)
+    {
+        deblockCTU(row - 1, col);
+        m_rowLoopFilter[row - 1].loopFilterCU(m_pic->getCU((row - 1) * numCols + col), EDGE_HOR);
+
+        if (row > 1)
+        {
+            processCTUPost(row - 2, col);
+            processRowPost(row - 2, cfg);
+        }
+    }
+}
+
+/* Deblock the vertical edges of a CTU and the horizontal edges of the CTU to
+ * its left, in the same order as processRow(). This finishes the CTU above
+ * the left CTU */
+void FrameFilter::deblockCTU(int row, int col)
+{
+    const int numCols = m_pic->getPicSym()->getFrameWidthInCU();
+    const uint32_t cuAddr = row * numCols + col;
+
+    m_rowLoopFilter[row].loopFilterCU(m_pic->getCU(cuAddr), EDGE_VER);
+
+    if (col > 0)
+    {
+        m_rowLoopFilter[row].loopFilterCU(m_pic->getCU(cuAddr - 1), EDGE_HOR);
+
+        if (row > 0)
+            processCTUPost(row - 1, col - 1);
+    }
+}
+
+static void extendCTUBorder(pixel* pix, intptr_t stride, int width, int height, int marginX, bool bLeft, bool bRight)
+{
+    if (bLeft && bRight)
+    {
+        primitives.extendRowBorder(pix, stride, width, height, marginX);
+        return;
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+#if HIGH_BIT_DEPTH
+        for (int x = 0; x < marginX; x++)
+        {
+            if (bLeft)
+                pix[-marginX + x] = pix[0];
+            if (bRight)
+                pix[width + x] = pix[width - 1];
+        }
+
+#else
+        if (bLeft)
+            ::memset(pix - marginX, pix[0], marginX);
+        if (bRight)
+            ::memset(pix + width, pix[width - 1], marginX);
+#endif
+
+        pix += stride;
+    }
+}
+
+/* Extend the picture borders next to one CTU of final reconstructed pixels
+ * and make it available for motion reference */
+void FrameFilter::processCTUPost(int row, int col)
+{
+    const int numCols = m_pic->getPicSym()->getFrameWidthInCU();
+    const uint32_t cuAddr = row * numCols + col;
     TComPicYuv *recon = m_pic->getPicYuvRec();
     const int lastH = ((recon->getHeight() % g_maxCUSize) ? (recon->getHeight() % g_maxCUSize) : g_maxCUSize);
     const int realH = (row != m_numRows - 1) ? g_maxCUSize : lastH;
+    const int lastW = ((recon->getWidth() % g_maxCUSize) ? (recon->getWidth() % g_maxCUSize) : g_maxCUSize);
+    const int realW = (col != numCols - 1) ? g_maxCUSize : lastW;
+    const bool bLeft = col == 0;
+    const bool bRight = col == numCols - 1;
 
     // Border extend Left and Right
-    primitives.extendRowBorder(recon->getLumaAddr(lineStartCUAddr), recon->getStride(), recon->getWidth(), realH, recon->getLumaMarginX());
-    primitives.extendRowBorder(recon->getCbAddr(lineStartCUAddr), recon->getCStride(), recon->getWidth() >> m_hChromaShift, realH >> m_vChromaShift, recon->getChromaMarginX());
-    primitives.extendRowBorder(recon->getCrAddr(lineStartCUAddr), recon->getCStride(), recon->getWidth() >> m_hChromaShift, realH >> m_vChromaShift, recon->getChromaMarginX());
+    extendCTUBorder(recon->getLumaAddr(cuAddr), recon->getStride(), realW, realH, recon->getLumaMarginX(), bLeft, bRight);
+    extendCTUBorder(recon->getCbAddr(cuAddr), recon->getCStride(), realW >> m_hChromaShift, realH >> m_vChromaShift, recon->getChromaMarginX(), bLeft, bRight);
+    extendCTUBorder(recon->getCrAddr(cuAddr), recon->getCStride(), realW >> m_hChromaShift, realH >> m_vChromaShift, recon->getChromaMarginX(), bLeft, bRight);
+
+    // Columns of the top and bottom margins above and below this CTU
+    const int leftY = bLeft ? recon->getLumaMarginX() : 0;
+    const int leftC = bLeft ? recon->getChromaMarginX() : 0;
+    const int widthY = leftY + realW + (bRight ? recon->getLumaMarginX() : 0);
+    const int widthC = leftC + (realW >> m_hChromaShift) + (bRight ? recon->getChromaMarginX() : 0);
+
     // Border extend Top
     if (row == 0)
     {
         const intptr_t stride = recon->getStride();
         const intptr_t strideC = recon->getCStride();
-        pixel *pixY = recon->getLumaAddr(lineStartCUAddr) - recon->getLumaMarginX();
-        pixel *pixU = recon->getCbAddr(lineStartCUAddr) - recon->getChromaMarginX();
-        pixel *pixV = recon->getCrAddr(lineStartCUAddr) - recon->getChromaMarginX();
+        pixel *pixY = recon->getLumaAddr(cuAddr) - leftY;
+        pixel *pixU = recon->getCbAddr(cuAddr) - leftC;
+        pixel *pixV = recon->getCrAddr(cuAddr) - leftC;
 
         for (int y = 0; y < recon->getLumaMarginY(); y++)
         {
-            memcpy(pixY - (y + 1) * stride, pixY, stride * sizeof(pixel));
+            memcpy(pixY - (y + 1) * stride, pixY, widthY * sizeof(pixel));
         }
 
         for (int y = 0; y < recon->getChromaMarginY(); y++)
         {
-            memcpy(pixU - (y + 1) * strideC, pixU, strideC * sizeof(pixel));
-            memcpy(pixV - (y + 1) * strideC, pixV, strideC * sizeof(pixel));
+            memcpy(pixU - (y + 1) * strideC, pixU, widthC * sizeof(pixel));
+            memcpy(pixV - (y + 1) * strideC, pixV, widthC * sizeof(pixel));
         }
     }
 
@@ -247,26 +404,131 @@ void FrameFilter::processRowPost(int row, Encoder* cfg)
     {
         const intptr_t stride = recon->getStride();
         const intptr_t strideC = recon->getCStride();
-        pixel *pixY = recon->getLumaAddr(lineStartCUAddr) - recon->getLumaMarginX() + (realH - 1) * stride;
-        pixel *pixU = recon->getCbAddr(lineStartCUAddr) - recon->getChromaMarginX() + ((realH >> m_vChromaShift) - 1) * strideC;
-        pixel *pixV = recon->getCrAddr(lineStartCUAddr) - recon->getChromaMarginX() + ((realH >> m_vChromaShift) - 1) * strideC;
+        pixel *pixY = recon->getLumaAddr(cuAddr) - leftY + (realH - 1) * stride;
+        pixel *pixU = recon->getCbAddr(cuAddr) - leftC + ((realH >> m_vChromaShift) - 1) * strideC;
+        pixel *pixV = recon->getCrAddr(cuAddr) - leftC + ((realH >> m_vChromaShift) - 1) * strideC;
         for (int y = 0; y < recon->getLumaMarginY(); y++)
         {
-            memcpy(pixY + (y + 1) * stride, pixY, stride * sizeof(pixel));
+            memcpy(pixY + (y + 1) * stride, pixY, widthY * sizeof(pixel));
         }
 
         for (int y = 0; y < recon->getChromaMarginY(); y++)
         {
-            memcpy(pixU + (y + 1) * strideC, pixU, strideC * sizeof(pixel));
-            memcpy(pixV + (y + 1) * strideC, pixV, strideC * sizeof(pixel));
+            memcpy(pixU + (y + 1) * strideC, pixU, widthC * sizeof(pixel));
+            memcpy(pixV + (y + 1) * strideC, pixV, widthC * sizeof(pixel));
         }
     }
 
+    // Notify other FrameEncoders that this CTU is available for motion reference
+    m_pic->m_reconColCount[row].set(col + 1);
+}
+
+void FrameFilter::processRowPost(int row, Encoder* cfg)
+{
+    const uint32_t numCols = m_pic->getPicSym()->getFrameWidthInCU();
+
+    // Extend the borders of the CTUs which were not made available one by one
+    for (uint32_t col = m_pic->m_reconColCount[row].get(); col < numCols; col++)
+    {
+        processCTUPost(row, col);
+    }
+
+    if (m_pic->getPicYuvRec()->m_hpelBuf[0])
+        interpolateHpelRows(row);
+
+    if (m_pic->getPicYuvRec()->m_integralBuf)
+        integrateRows(row);
+
     // Notify other FrameEncoders that this row of reconstructed pixels is available
     m_pic->m_reconRowCount.incr();
 
+    if (m_bMetricsJobs)
+        m_metrics.enableRowMetrics(row);
+    else
+        processRowMetrics(row, cfg);
+}
+
+/* Fill the half-pel plane cache for the rows which became computable with this
+ * CTU row. The 8-tap filters read four rows below each output row, so the
+ * cache lags the reconstructed rows by four rows, exactly as far as sub-pel
+ * interpolation of a reference block reaches below it. Positions which on
+ * the fly interpolation could not compute without reading outside of the
+ * margins are not filled */
+void FrameFilter::interpolateHpelRows(int row)
+{
+    TComPicYuv *recon = m_pic->getPicYuvRec();
+    const intptr_t stride = recon->getStride();
+    const int tile = g_maxCUSize;
+    const int halfTaps = NTAPS_LUMA / 2;
+    const int partEnum = partitionFromSizes(tile, tile);
+
+    const int x0 = halfTaps - 1 - recon->getLumaMarginX();
+    const int x1 = recon->getWidth() + recon->getLumaMarginX() - halfTaps;
+    const int y0 = row ? row * tile - halfTaps : halfTaps - 1 - recon->getLumaMarginY();
+    const int y1 = row == m_numRows - 1 ? recon->getHeight() + recon->getLumaMarginY() - halfTaps : (row + 1) * tile - halfTaps;
+
+    ALIGN_VAR_32(int16_t, immed[MAX_CU_SIZE * (MAX_CU_SIZE + NTAPS_LUMA - 1)]);
+
+    /* the last tile of each direction overlaps its neighbor, it never
+     * reaches into rows of the cache which were already published */
+    for (int y = y0; y < y1; y += tile)
+    {
+        for (int x = x0; x < x1; x += tile)
+        {
+            intptr_t offset = X265_MIN(y, y1 - tile) * stride + X265_MIN(x, x1 - tile);
+            pixel *src = recon->getLumaAddr() + offset;
+
+            primitives.luma_hpp[partEnum](src, stride, recon->m_hpelOrg[0] + offset, stride, 2);
+            primitives.luma_vpp[partEnum](src, stride, recon->m_hpelOrg[1] + offset, stride, 2);
+            primitives.luma_hps[partEnum](src, stride, immed, tile, 2, 1);
+            primitives.luma_vsp[partEnum](immed + (halfTaps - 1) * tile, tile, recon->m_hpelOrg[2] + offset, stride, 2);
+        }
+    }
+}
+
+/* Accumulate the summed area table of the luma rows of this CTU row, with the
+ * margins of the first and the last row. Each entry is the sum of the pixels
+ * left of and above its position in the extended plane, so the sum of any
+ * block is four lookups. The wrapping uint32_t arithmetic still gives exact
+ * block sums. The last row and column of the buffer are not needed, the
+ * search range keeps blocks inside the margins */
+void FrameFilter::integrateRows(int row)
+{
+    TComPicYuv *recon = m_pic->getPicYuvRec();
+    const intptr_t stride = recon->getStride();
+    const int marginY = recon->getLumaMarginY();
+    const int width = X265_MIN(recon->getWidth() + 2 * recon->getLumaMarginX(), (int)stride - 1);
+    const int y0 = row ? marginY + row * g_maxCUSize : 0;
+    const int y1 = row == m_numRows - 1 ? recon->getHeight() + 2 * marginY - 1 : marginY + (row + 1) * g_maxCUSize;
+
+    const pixel *src = recon->m_picBufY + y0 * stride;
+    uint32_t *sum = recon->m_integralBuf + (y0 + 1) * stride;
+
+    for (int y = y0; y < y1; y++)
+    {
+        uint32_t rowSum = 0;
+        for (int x = 0; x < width; x++)
+        {
+            sum[x] = sum[x - stride] + rowSum;
+            rowSum += src[x];
+        }
+
+        sum[width] = sum[width - stride] + rowSum;
+        src += stride;
+        sum += stride;
+    }
+}
+
+/* Measure the PSNR and SSIM of a final reconstructed CTU row and update the
+ * decoded picture hash, rows must be processed in order */
+void FrameFilter::processRowMetrics(int row, Encoder* cfg)
+{
+    const uint32_t numCols = m_pic->getPicSym()->getFrameWidthInCU();
+    const uint32_t lineStartCUAddr = row * numCols;
+    TComPicYuv *recon = m_pic->getPicYuvRec();
+
     int cuAddr = lineStartCUAddr;
-    if (m_param->bEnablePsnr)
+    if (m_param->bEnablePsnr && m_pic->m_bMetricsSampled)
     {
         TComPicYuv* orig  = m_pic->getPicYuvOrg();
 
@@ -291,7 +553,7 @@ void FrameFilter::processRowPost(int row, Encoder* cfg)
         m_pic->m_SSDU += ssdU;
         m_pic->m_SSDV += ssdV;
     }
-    if (m_param->bEnableSsim && m_ssimBuf)
+    if (m_param->bEnableSsim && m_ssimBuf && m_pic->m_bMetricsSampled)
     {
         pixel *rec = (pixel*)m_pic->getPicYuvRec()->getLumaAddr();
         pixel *org = (pixel*)m_pic->getPicYuvOrg()->getLumaAddr();
@@ -371,6 +633,43 @@ void FrameFilter::processRowPost(int row, Encoder* cfg)
     }
 }
 
+bool RowMetrics::init(FrameFilter *filter, Encoder *cfg, int numRows)
+{
+    m_filter = filter;
+    m_cfg = cfg;
+    m_numRows = numRows;
+    return WaveFront::init(numRows);
+}
+
+void RowMetrics::start()
+{
+    m_rowsDone.set(0);
+    WaveFront::clearEnabledRowMask();
+    WaveFront::enqueue();
+    WaveFront::enqueueRow(0);
+}
+
+void RowMetrics::processRow(int row)
+{
+    m_filter->processRowMetrics(row, m_cfg);
+
+    // the hashes and the SSIM scratch buffer require rows in picture order
+    if (row < m_numRows - 1)
+        WaveFront::enqueueRow(row + 1);
+
+    m_rowsDone.incr();
+}
+
+void RowMetrics::finish()
+{
+    int done = m_rowsDone.get();
+
+    while (done < m_numRows)
+        done = m_rowsDone.waitForChange(done);
+
+    WaveFront::dequeue();
+}
+
 static uint64_t computeSSD(pixel *fenc, pixel *rec, int stride, int width, int height)
 {
     uint64_t ssd = 0;
@@ -28,11 +28,48 @@
 #include "TLibCommon/TComPic.h"
 #include "TLibCommon/TComLoopFilter.h"
 #include "TLibEncoder/TEncSampleAdaptiveOffset.h"
+#include "threading.h"
+#include "wavefront.h"
 
 namespace x265 {
 // private x265 namespace
 
 class Encoder;
+class FrameFilter;
+
+/* Low priority jobs which measure the PSNR and SSIM and update the decoded
+ * picture hash of each filtered CTU row. A row is enqueued when the row above
+ * it is measured and enabled once the filter has made it available for motion
+ * reference, so these jobs never delay the filter or reference rows */
+class RowMetrics : public WaveFront
+{
+public:
+
+    RowMetrics() : WaveFront(NULL), m_filter(NULL), m_cfg(NULL), m_numRows(0) {}
+
+    bool init(FrameFilter *filter, Encoder *cfg, int numRows);
+
+    void start();
+
+    // Called by the filter when the row is final, may be called from any thread
+    void enableRowMetrics(int row)
+    {
+        WaveFront::enableRow(row);
+        m_pool->pokeIdleThread(m_node);
+    }
+
+    // Blocks until the metrics of every row of the picture have been computed
+    void finish();
+
+    void processRow(int row);
+
+protected:
+
+    FrameFilter*      m_filter;
+    Encoder*          m_cfg;
+    int               m_numRows;
+    ThreadSafeInteger m_rowsDone;
+};
 
 // Manages the processing of a single frame loopfilter
 class FrameFilter
@@ -43,7 +80,7 @@ public:
 
     virtual ~FrameFilter() {}
 
-    void init(Encoder *top, int numRows, TEncSbac* rdGoOnSbacCoder);
+    void init(Encoder *top, int numRows, TEncSbac* rdGoOnSbacCoder, ThreadPool* pool, int node);
 
     void destroy();
 
@@ -52,10 +89,23 @@ public:
 
     void processRow(int row, Encoder* cfg);
     void processRowPost(int row, Encoder* cfg);
+    void processRowMetrics(int row, Encoder* cfg);
     void processSao(int row);
 
+    // Wait for the PSNR, SSIM and picture hash of the whole picture
+    void finishMetrics();
+
+    // Called by the CU row encoder of the given row after each CTU it encodes,
+    // when m_bInlineFilter is set
+    void processCTU(int row, int col, Encoder* cfg);
+
 protected:
 
+    void deblockCTU(int row, int col);
+    void processCTUPost(int row, int col);
+    void interpolateHpelRows(int row);
+    void integrateRows(int row);
+
     x265_param*                 m_param;
     TComPic*                    m_pic;
     int                         m_hChromaShift;
@@ -64,6 +114,13 @@ protected:
 public:
 
     TComLoopFilter              m_loopFilter;
+    TComLoopFilter*             m_rowLoopFilter;        // per CTU row deblocking state for inline filtering
+
+    // Without SAO or VBV row restarts, each CTU row is deblocked and extended
+    // by the CU row encoder below it, one CTU behind, so reference pixels
+    // become available while the frame is still being encoded
+    bool                        m_bInlineFilter;
+
     TEncSampleAdaptiveOffset    m_sao;
     int                         m_numRows;
     int                         m_saoRowDelay;
@@ -76,6 +133,11 @@ public:
     TEncSbac*                   m_rdGoOnSbacCoderRow0;  // for bitstream exact only, depends on HM's bug
     /* Temp storage for ssim computation that doesn't need repeated malloc */
     void*                       m_ssimBuf;
+
+    // Metrics and hashes are computed by m_metrics jobs when a thread pool is
+    // available, else inline by processRowPost()
+    RowMetrics                  m_metrics;
+    bool                        m_bMetricsJobs;
 };
 }
 
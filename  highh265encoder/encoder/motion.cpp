@@ -95,6 +95,7 @@ static void init_scales(void)
 MotionEstimate::MotionEstimate()
     : searchMethod(3)
     , subpelRefine(5)
+    , bCandidateStart(false)
 {
     if (size_scale[0] == 0)
         init_scales();
@@ -532,14 +533,32 @@ int MotionEstimate::motionEstimate(ReferencePlanes *ref,
                                    int              merange,
                                    MV &             outQMv)
 {
-    ALIGN_VAR_16(int, costs[16]);
+    RefSearch rs;
+
+    rs.ref = ref;
+    rs.mvmin = mvmin;
+    rs.mvmax = mvmax;
+    rs.qmvp = qmvp;
+    rs.numCandidates = numCandidates;
+    rs.mvc = mvc;
+
+    searchStart(rs);
+    integerSearch(rs, merange);
+    return finishSearch(rs, outQMv);
+}
+
+/* Measures the MVP, MV(0) and the candidates, giving the best qpel predictor
+ * and the full pel start point of the integer search */
+void MotionEstimate::searchStart(RefSearch& rs)
+{
+    ReferencePlanes *ref = rs.ref;
     size_t stride = ref->lumaStride;
     pixel *fref = ref->fpelPlane + blockOffset;
 
-    setMVP(qmvp);
+    setMVP(rs.qmvp);
 
-    MV qmvmin = mvmin.toQPel();
-    MV qmvmax = mvmax.toQPel();
+    MV qmvmin = rs.mvmin.toQPel();
+    MV qmvmax = rs.mvmax.toQPel();
 
     /* The term cost used here means satd/sad values for that particular search.
      * The costs used in ME integer search only includes the SAD cost of motion
@@ -549,7 +568,7 @@ int MotionEstimate::motionEstimate(ReferencePlanes *ref,
      * (mode + MVD bits). */
 
     // measure SAD cost at clipped QPEL MVP
-    MV pmv = qmvp.clipped(qmvmin, qmvmax);
+    MV pmv = rs.qmvp.clipped(qmvmin, qmvmax);
     MV bestpre = pmv;
     int bprecost;
 
@@ -578,9 +597,9 @@ int MotionEstimate::motionEstimate(ReferencePlanes *ref,
     }
 
     // measure SAD cost at each QPEL motion vector candidate
-    for (int i = 0; i < numCandidates; i++)
+    for (int i = 0; i < rs.numCandidates; i++)
     {
-        MV m = mvc[i].clipped(qmvmin, qmvmax);
+        MV m = rs.mvc[i].clipped(qmvmin, qmvmax);
         if (m.notZero() && m != pmv && m != bestpre) // check already measured
         {
             int cost;
@@ -594,10 +613,46 @@ int MotionEstimate::motionEstimate(ReferencePlanes *ref,
                 bprecost = cost;
                 bestpre = m;
             }
+
+            /* the full pel candidate may be a better search start point,
+             * see --lowres-mvc */
+            MV fm = m.roundToFPel();
+            if (bCandidateStart && !ref->isLowres && fm != bmv)
+            {
+                cost = sad(fenc, FENC_STRIDE, fref + fm.x + fm.y * stride, stride) + mvcost(fm << 2);
+                if (cost < bcost)
+                {
+                    bcost = cost;
+                    bmv = fm;
+                }
+            }
         }
     }
 
-    pmv = pmv.roundToFPel();
+    rs.bmv = bmv;
+    rs.bcost = bcost;
+    rs.bestpre = bestpre;
+    rs.bprecost = bprecost;
+}
+
+/* Integer search of one reference from the start point found by searchStart() */
+void MotionEstimate::integerSearch(RefSearch& rs, int merange)
+{
+    ALIGN_VAR_16(int, costs[16]);
+    ReferencePlanes *ref = rs.ref;
+    size_t stride = ref->lumaStride;
+    pixel *fref = ref->fpelPlane + blockOffset;
+    const MV& mvmin = rs.mvmin;
+    const MV& mvmax = rs.mvmax;
+    const MV& qmvp = rs.qmvp;
+    const MV *mvc = rs.mvc;
+    int numCandidates = rs.numCandidates;
+
+    setMVP(qmvp);
+
+    MV pmv = qmvp.clipped(mvmin.toQPel(), mvmax.toQPel()).roundToFPel();
+    MV bmv = rs.bmv;
+    int bcost = rs.bcost;
     MV omv = bmv;  // current search origin or starting point
 
     switch (searchMethod)
@@ -996,6 +1051,12 @@ me_hex2:
 
     case X265_FULL_SEARCH:
     {
+        if (ref->integralPlane)
+        {
+            successiveElimination(ref, mvmin, mvmax, bmv, bcost);
+            break;
+        }
+
         // dead slow exhaustive search, but at least it uses sad_x4()
         MV tmv;
         for (tmv.y = mvmin.y; tmv.y <= mvmax.y; tmv.y++)
@@ -1036,13 +1097,30 @@ me_hex2:
         break;
     }
 
-    if (bprecost < bcost)
+    rs.bmv = bmv;
+    rs.bcost = bcost;
+}
+
+/* Subpel refinement of the better of the integer search result and the best
+ * predictor, returns the cost of the final qpel MV */
+int MotionEstimate::finishSearch(RefSearch& rs, MV& outQMv)
+{
+    ReferencePlanes *ref = rs.ref;
+    MV bmv;
+    int bcost;
+
+    setMVP(rs.qmvp);
+
+    if (rs.bprecost < rs.bcost)
     {
-        bmv = bestpre;
-        bcost = bprecost;
+        bmv = rs.bestpre;
+        bcost = rs.bprecost;
     }
     else
-        bmv = bmv.toQPel(); // promote search bmv to qpel
+    {
+        bmv = rs.bmv.toQPel(); // promote search bmv to qpel
+        bcost = rs.bcost;
+    }
 
     SubpelWorkload& wl = workload[this->subpelRefine];
 
@@ -1121,6 +1199,303 @@ me_hex2:
     return bcost;
 }
 
+/* Exhaustive search which measures only the candidates that may beat the best
+ * cost. The SAD of a candidate is at least the sum of the absolute differences
+ * between the pixel sums of a grid of sub-blocks of the PU and of the same
+ * sub-blocks of the reference block, which the summed area table of the
+ * reference gives with four lookups each. The candidates whose bound plus MV
+ * cost is below the best cost are measured four at a time, in raster order, so
+ * the search finds the same MV as measuring every candidate */
+void MotionEstimate::successiveElimination(ReferencePlanes *ref, const MV& mvmin, const MV& mvmax, MV& bmv, int& bcost)
+{
+    enum { MAX_GRID = 4, MIN_SUB_SIZE = 8 };
+
+    ALIGN_VAR_16(int, costs[4]);
+    pixel *fref[4];
+    int16_t candx[4];
+    intptr_t stride = ref->lumaStride;
+    pixel *fbase = ref->fpelPlane + blockOffset;
+    const uint32_t *sat = ref->integralPlane + blockOffset;
+
+    /* up to MAX_GRID sub-blocks of at least MIN_SUB_SIZE pixels in each
+     * direction, the corners of each in the summed area table and its sum
+     * in the PU */
+    int gridx = Clip3(1, (int)MAX_GRID, blockwidth / MIN_SUB_SIZE);
+    int gridy = Clip3(1, (int)MAX_GRID, blockheight / MIN_SUB_SIZE);
+    int numSub = gridx * gridy;
+    intptr_t cornerTL[MAX_GRID * MAX_GRID], cornerTR[MAX_GRID * MAX_GRID];
+    intptr_t cornerBL[MAX_GRID * MAX_GRID], cornerBR[MAX_GRID * MAX_GRID];
+    int encSum[MAX_GRID * MAX_GRID];
+
+    for (int j = 0; j < gridy; j++)
+    {
+        int y0 = j * blockheight / gridy, y1 = (j + 1) * blockheight / gridy;
+        for (int i = 0; i < gridx; i++)
+        {
+            int x0 = i * blockwidth / gridx, x1 = (i + 1) * blockwidth / gridx;
+            int k = j * gridx + i;
+            cornerTL[k] = y0 * stride + x0;
+            cornerTR[k] = y0 * stride + x1;
+            cornerBL[k] = y1 * stride + x0;
+            cornerBR[k] = y1 * stride + x1;
+
+            int sum = 0;
+            for (int y = y0; y < y1; y++)
+                for (int x = x0; x < x1; x++)
+                    sum += fenc[y * FENC_STRIDE + x];
+            encSum[k] = sum;
+        }
+    }
+
+    MV tmv;
+    for (tmv.y = mvmin.y; tmv.y <= mvmax.y; tmv.y++)
+    {
+        int costy = m_cost_mvy[tmv.y << 2];
+        int count = 0;
+
+        for (tmv.x = mvmin.x; tmv.x <= mvmax.x; tmv.x++)
+        {
+            int bound = costy + m_cost_mvx[tmv.x << 2];
+            const uint32_t *s = sat + tmv.x + tmv.y * stride;
+            for (int k = 0; k < numSub && bound < bcost; k++)
+            {
+                int refSum = (int)(s[cornerBR[k]] - s[cornerBL[k]] - s[cornerTR[k]] + s[cornerTL[k]]);
+                bound += abs(encSum[k] - refSum);
+            }
+
+            if (bound >= bcost)
+                continue;
+
+            fref[count] = fbase + tmv.x + tmv.y * stride;
+            candx[count++] = tmv.x;
+            if (count < 4)
+                continue;
+
+            sadRefs(fref, count, stride, costs);
+            for (int i = 0; i < count; i++)
+            {
+                MV mv(candx[i], tmv.y);
+                costs[i] += costy + m_cost_mvx[mv.x << 2];
+                COPY2_IF_LT(bcost, costs[i], bmv, mv);
+            }
+
+            count = 0;
+        }
+
+        if (count)
+        {
+            sadRefs(fref, count, stride, costs);
+            for (int i = 0; i < count; i++)
+            {
+                MV mv(candx[i], tmv.y);
+                costs[i] += costy + m_cost_mvx[mv.x << 2];
+                COPY2_IF_LT(bcost, costs[i], bmv, mv);
+            }
+        }
+    }
+}
+
+/* SAD of the PU against one block in each of count (at most four) references */
+void MotionEstimate::sadRefs(pixel **fref, int count, intptr_t stride, int *costs)
+{
+    if (count == 4)
+        sad_x4(fenc, fref[0], fref[1], fref[2], fref[3], stride, costs);
+    else if (count == 3)
+        sad_x3(fenc, fref[0], fref[1], fref[2], stride, costs);
+    else
+    {
+        for (int i = 0; i < count; i++)
+            costs[i] = sad(fenc, FENC_STRIDE, fref[i], stride);
+    }
+}
+
+/* Integer search of up to MAX_SEARCH_REFS references. The diamond and hexagon
+ * searches of the references run in lockstep, each pattern offset is measured
+ * around the current best MV of every reference still moving with one call.
+ * The result of each reference is identical to integerSearch() */
+void MotionEstimate::searchRefs(RefSearch *rs, int count, int merange)
+{
+    assert(count <= MAX_SEARCH_REFS);
+
+    if (count < 3 || (searchMethod != X265_DIA_SEARCH && searchMethod != X265_HEX_SEARCH))
+    {
+        /* sad_x3/sad_x4 already measure several offsets of one reference */
+        for (int i = 0; i < count; i++)
+            integerSearch(rs[i], merange);
+        return;
+    }
+
+    ALIGN_VAR_16(int, costs[MAX_SEARCH_REFS]);
+    pixel *fref[MAX_SEARCH_REFS];
+    pixel *fbase[MAX_SEARCH_REFS];
+    const uint16_t *costMvx[MAX_SEARCH_REFS];
+    const uint16_t *costMvy[MAX_SEARCH_REFS];
+    MV  bmv[MAX_SEARCH_REFS];
+    int bcost[MAX_SEARCH_REFS];
+    int dir[MAX_SEARCH_REFS];
+    int iters[MAX_SEARCH_REFS];
+    int active[MAX_SEARCH_REFS];
+    intptr_t stride = rs[0].ref->lumaStride;
+
+    for (int i = 0; i < count; i++)
+    {
+        assert(rs[i].ref->lumaStride == stride);
+        fbase[i] = rs[i].ref->fpelPlane + blockOffset;
+        costMvx[i] = m_cost - rs[i].qmvp.x;
+        costMvy[i] = m_cost - rs[i].qmvp.y;
+        bmv[i] = rs[i].bmv;
+        bcost[i] = rs[i].bcost;
+        active[i] = i;
+    }
+
+#define REF_SADS(n, MVEXPR) \
+    for (int j = 0; j < (n); j++) \
+    { \
+        int i = active[j]; \
+        MV mv = MVEXPR; \
+        fref[j] = fbase[i] + mv.x + mv.y * stride; \
+    } \
+    sadRefs(fref, n, stride, costs); \
+    for (int j = 0; j < (n); j++) \
+    { \
+        int i = active[j]; \
+        MV mv = MVEXPR; \
+        costs[j] += costMvx[i][mv.x << 2] + costMvy[i][mv.y << 2]; \
+    }
+
+    int numActive = count;
+
+    if (searchMethod == X265_DIA_SEARCH)
+    {
+        /* diamond search, radius 1 */
+        static const int diaTag[4] = { 1, 3, 4, 12 };
+        for (int i = 0; i < count; i++)
+        {
+            bcost[i] <<= 4;
+            iters[i] = merange;
+        }
+
+        while (numActive)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                REF_SADS(numActive, bmv[i] + square1[k + 1]);
+                for (int j = 0; j < numActive; j++)
+                    COPY1_IF_LT(bcost[active[j]], (costs[j] << 4) + diaTag[k]);
+            }
+
+            int moving = 0;
+            for (int j = 0; j < numActive; j++)
+            {
+                int i = active[j];
+                if (!(bcost[i] & 15))
+                    continue;
+                bmv[i].x -= (bcost[i] << 28) >> 30;
+                bmv[i].y -= (bcost[i] << 30) >> 30;
+                bcost[i] &= ~15;
+                if (--iters[i] && bmv[i].checkRange(rs[i].mvmin, rs[i].mvmax))
+                    active[moving++] = i;
+            }
+
+            numActive = moving;
+        }
+
+        for (int i = 0; i < count; i++)
+            rs[i].bcost = bcost[i] >> 4;
+    }
+    else
+    {
+        /* hexagon search, radius 2 */
+        for (int i = 0; i < count; i++)
+            bcost[i] <<= 3;
+
+        for (int k = 0; k < 6; k++)
+        {
+            REF_SADS(numActive, bmv[i] + hex2[k + 1]);
+            for (int j = 0; j < numActive; j++)
+                COPY1_IF_LT(bcost[active[j]], (costs[j] << 3) + k + 2);
+        }
+
+        numActive = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (bcost[i] & 7)
+            {
+                dir[i] = (bcost[i] & 7) - 2;
+                bmv[i] += hex2[dir[i] + 1];
+                iters[i] = (merange >> 1) - 1;
+                active[numActive++] = i;
+            }
+        }
+
+        /* half hexagon, not overlapping the previous iteration */
+        while (numActive)
+        {
+            int moving = 0;
+            for (int j = 0; j < numActive; j++)
+            {
+                int i = active[j];
+                if (iters[i] > 0 && bmv[i].checkRange(rs[i].mvmin, rs[i].mvmax))
+                {
+                    bcost[i] &= ~7;
+                    active[moving++] = i;
+                }
+            }
+
+            numActive = moving;
+            if (!numActive)
+                break;
+
+            for (int k = 0; k < 3; k++)
+            {
+                REF_SADS(numActive, bmv[i] + hex2[dir[i] + k]);
+                for (int j = 0; j < numActive; j++)
+                    COPY1_IF_LT(bcost[active[j]], (costs[j] << 3) + k + 1);
+            }
+
+            for (int j = 0; j < numActive; j++)
+            {
+                int i = active[j];
+                if (!(bcost[i] & 7))
+                {
+                    iters[i] = 0;
+                    continue;
+                }
+                dir[i] += (bcost[i] & 7) - 2;
+                dir[i] = mod6m1[dir[i] + 1];
+                bmv[i] += hex2[dir[i] + 1];
+                iters[i]--;
+            }
+        }
+
+        /* square refine */
+        for (int i = 0; i < count; i++)
+        {
+            bcost[i] >>= 3;
+            dir[i] = 0;
+            active[i] = i;
+        }
+
+        for (int k = 1; k <= 8; k++)
+        {
+            REF_SADS(count, bmv[i] + square1[k]);
+            for (int i = 0; i < count; i++)
+                COPY2_IF_LT(bcost[i], costs[i], dir[i], k);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            bmv[i] += square1[dir[i]];
+            rs[i].bcost = bcost[i];
+        }
+    }
+
+#undef REF_SADS
+
+    for (int i = 0; i < count; i++)
+        rs[i].bmv = bmv[i];
+}
+
 int MotionEstimate::subpelCompare(ReferencePlanes *ref, const MV& qmv, pixelcmp_t cmp)
 {
     int xFrac = qmv.x & 0x3;
@@ -1131,6 +1506,13 @@ int MotionEstimate::subpelCompare(ReferencePlanes *ref, const MV& qmv, pixelcmp_
         pixel *fref = ref->fpelPlane + blockOffset + (qmv.x >> 2) + (qmv.y >> 2) * ref->lumaStride;
         return cmp(fenc, FENC_STRIDE, fref, ref->lumaStride);
     }
+    else if (!((yFrac | xFrac) & 1) && ref->hpelPlane[0])
+    {
+        /* half-pel position, read the cached interpolated plane */
+        int hpel = (yFrac & 2) | (xFrac >> 1);
+        pixel *fref = ref->hpelPlane[hpel] + blockOffset + (qmv.x >> 2) + (qmv.y >> 2) * ref->lumaStride;
+        return cmp(fenc, FENC_STRIDE, fref, ref->lumaStride);
+    }
     else
     {
         /* We are taking a short-cut here if the reference is weighted. To be
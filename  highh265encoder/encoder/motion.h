@@ -51,6 +51,9 @@ protected:
     int searchMethod;
     int subpelRefine;
 
+    /* measure the candidates at full pel as integer search start points */
+    bool bCandidateStart;
+
     /* subpel generation buffers */
     int blockwidth;
     int blockheight;
@@ -61,6 +64,28 @@ public:
 
     static const int COST_MAX = 1 << 28;
 
+    /* The searches of a multi-reference motion search. searchStart() measures
+     * the predictors of one reference, searchRefs() runs the integer search of
+     * up to four references in lockstep, measuring the same pattern offset in
+     * every reference with one sad_x3/sad_x4 call, and finishSearch() refines
+     * the result of one reference at subpel */
+    static const int MAX_SEARCH_REFS = 4;
+
+    struct RefSearch
+    {
+        ReferencePlanes *ref;
+        MV        mvmin;    // full pel search range
+        MV        mvmax;
+        MV        qmvp;
+        int       numCandidates;
+        const MV *mvc;
+
+        MV        bmv;      // best full pel MV and its SAD cost
+        int       bcost;
+        MV        bestpre;  // best qpel predictor and its SAD cost
+        int       bprecost;
+    };
+
     pixel *fenc;
 
     MotionEstimate();
@@ -71,6 +96,8 @@ public:
 
     void setSubpelRefine(int i) { subpelRefine = i; }
 
+    void setCandidateStart(bool b) { bCandidateStart = b; }
+
     /* Methods called at slice setup */
 
     void setSourcePlane(pixel *Y, intptr_t luma)
@@ -92,10 +119,22 @@ public:
 
     int motionEstimate(ReferencePlanes *ref, const MV & mvmin, const MV & mvmax, const MV & qmvp, int numCandidates, const MV * mvc, int merange, MV & outQMv);
 
+    void searchStart(RefSearch& rs);
+
+    void searchRefs(RefSearch *rs, int count, int merange);
+
+    int finishSearch(RefSearch& rs, MV& outQMv);
+
     int subpelCompare(ReferencePlanes * ref, const MV &qmv, pixelcmp_t);
 
 protected:
 
+    void integerSearch(RefSearch& rs, int merange);
+
+    void sadRefs(pixel **fref, int count, intptr_t stride, int *costs);
+
+    void successiveElimination(ReferencePlanes *ref, const MV& mvmin, const MV& mvmax, MV& bmv, int& bcost);
+
     inline void StarPatternSearch(ReferencePlanes *ref,
                                   const MV &       mvmin,
                                   const MV &       mvmax,
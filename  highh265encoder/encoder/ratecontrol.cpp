@@ -205,6 +205,61 @@ RateControl::RateControl(Encoder * _cfg)
     else
         qCompress = param->rc.qCompress;
 
+    bReconfigPending = false;
+    initReconfigurable(true);
+
+    isAbr = param->rc.rateControlMode != X265_RC_CQP; // later add 2pass option
+    frameDuration = (double)param->fpsDenom / param->fpsNum;
+    qp = param->rc.qp;
+    lastRceq = 1; /* handles the cmplxrsum when the previous frame cost is zero */
+    shortTermCplxSum = 0;
+    shortTermCplxCount = 0;
+    lastNonBPictType = I_SLICE;
+    isAbrReset = false;
+    lastAbrResetPoc = -1;
+    encodeOrder = -1;
+
+    bframes = param->bframes;
+    bframeBits = 0;
+    leadingNoBSatd = 0;
+    if (param->rc.rateControlMode == X265_RC_ABR)
+    {
+        /* Adjust the first frame in order to stabilize the quality level compared to the rest */
+#define ABR_INIT_QP_MIN (24 + QP_BD_OFFSET)
+#define ABR_INIT_QP_MAX (34 + QP_BD_OFFSET)
+    }
+    else if (param->rc.rateControlMode == X265_RC_CRF)
+    {
+#define ABR_INIT_QP ((int)param->rc.rfConstant)
+    }
+    reInit();
+
+    ipOffset = 6.0 * X265_LOG2(param->rc.ipFactor);
+    pbOffset = 6.0 * X265_LOG2(param->rc.pbFactor);
+    for (int i = 0; i < 3; i++)
+    {
+        lastQScaleFor[i] = x265_qp2qScale(param->rc.rateControlMode == X265_RC_CRF ? ABR_INIT_QP : ABR_INIT_QP_MIN);
+        lmin[i] = x265_qp2qScale(MIN_QP);
+        lmax[i] = x265_qp2qScale(MAX_MAX_QP);
+    }
+
+    if (param->rc.rateControlMode == X265_RC_CQP)
+    {
+        qpConstant[P_SLICE] = qp;
+        qpConstant[I_SLICE] = Clip3(0, MAX_MAX_QP, (int)(qp - ipOffset + 0.5));
+        qpConstant[B_SLICE] = Clip3(0, MAX_MAX_QP, (int)(qp + pbOffset + 0.5));
+    }
+
+    /* qstep - value set as encoder specific */
+    lstep = pow(2, param->rc.qpStep / 6.0);
+}
+
+/* Set up the rate control state which x265_encoder_reconfig() may change:
+ * the CRF rate factor, the ABR target and the VBV buffer */
+void RateControl::initReconfigurable(bool bInit)
+{
+    double oldBufferSize = bInit ? 0 : bufferSize;
+
     // validate for param->rc, maybe it is need to add a function like x265_parameters_valiate()
     param->rc.rfConstant = Clip3((double)-QP_BD_OFFSET, (double)51, param->rc.rfConstant);
     param->rc.rfConstantMax = Clip3((double)-QP_BD_OFFSET, (double)51, param->rc.rfConstantMax);
@@ -231,21 +286,14 @@ RateControl::RateControl(Encoder * _cfg)
         }
     }
 
-    isAbr = param->rc.rateControlMode != X265_RC_CQP; // later add 2pass option
     bitrate = param->rc.bitrate * 1000;
-    frameDuration = (double)param->fpsDenom / param->fpsNum;
-    qp = param->rc.qp;
-    lastRceq = 1; /* handles the cmplxrsum when the previous frame cost is zero */
-    shortTermCplxSum = 0;
-    shortTermCplxCount = 0;
-    lastNonBPictType = I_SLICE;
-    isAbrReset = false;
-    lastAbrResetPoc = -1;
+
     // vbv initialization
     param->rc.vbvBufferSize = Clip3(0, 2000000, param->rc.vbvBufferSize);
     param->rc.vbvMaxBitrate = Clip3(0, 2000000, param->rc.vbvMaxBitrate);
     param->rc.vbvBufferInit = Clip3(0.0, 2000000.0, param->rc.vbvBufferInit);
-    vbvMinRate = 0;
+    param->rc.vbvBufferEnd = Clip3(0.0, 2000000.0, param->rc.vbvBufferEnd);
+    bufferFillEnd = 0;
     if (param->rc.vbvBufferSize)
     {
         if (param->rc.rateControlMode == X265_RC_CQP)
@@ -284,8 +332,6 @@ RateControl::RateControl(Encoder * _cfg)
     double fps = (double)param->fpsNum / param->fpsDenom;
     if (isVbv)
     {
-        /* We don't support changing the ABR bitrate right now,
-           so if the stream starts as CBR, keep it CBR. */
         if (param->rc.vbvBufferSize < (int)(param->rc.vbvMaxBitrate / fps))
         {
             param->rc.vbvBufferSize = (int)(param->rc.vbvMaxBitrate / fps);
@@ -300,47 +346,51 @@ RateControl::RateControl(Encoder * _cfg)
         bufferSize = vbvBufferSize;
         singleFrameVbv = bufferRate * 1.1 > bufferSize;
 
-        if (param->rc.vbvBufferInit > 1.)
-            param->rc.vbvBufferInit = Clip3(0.0, 1.0, param->rc.vbvBufferInit / param->rc.vbvBufferSize);
-        param->rc.vbvBufferInit = Clip3(0.0, 1.0, X265_MAX(param->rc.vbvBufferInit, bufferRate / bufferSize));
-        bufferFillFinal = bufferSize * param->rc.vbvBufferInit;
+        if (bInit)
+        {
+            if (param->rc.vbvBufferInit > 1.)
+                param->rc.vbvBufferInit = Clip3(0.0, 1.0, param->rc.vbvBufferInit / param->rc.vbvBufferSize);
+            param->rc.vbvBufferInit = Clip3(0.0, 1.0, X265_MAX(param->rc.vbvBufferInit, bufferRate / bufferSize));
+            bufferFillFinal = bufferSize * param->rc.vbvBufferInit;
+        }
+        else
+        {
+            /* keep the fullness of the buffer as a fraction of its size */
+            bufferFillFinal = Clip3(0.0, bufferSize, bufferFillFinal * bufferSize / oldBufferSize);
+        }
+        if (param->rc.vbvBufferEnd > 1.)
+            param->rc.vbvBufferEnd = Clip3(0.0, 1.0, param->rc.vbvBufferEnd / param->rc.vbvBufferSize);
+        if (param->totalFrames && param->lookaheadDepth)
+            bufferFillEnd = bufferSize * param->rc.vbvBufferEnd;
         vbvMinRate = /*!rc->b_2pass && */ param->rc.rateControlMode == X265_RC_ABR
             && param->rc.vbvMaxBitrate <= param->rc.bitrate;
     }
+}
 
-    bframes = param->bframes;
-    bframeBits = 0;
-    leadingNoBSatd = 0;
-    if (param->rc.rateControlMode == X265_RC_ABR)
-    {
-        /* Adjust the first frame in order to stabilize the quality level compared to the rest */
-#define ABR_INIT_QP_MIN (24 + QP_BD_OFFSET)
-#define ABR_INIT_QP_MAX (34 + QP_BD_OFFSET)
-    }
-    else if (param->rc.rateControlMode == X265_RC_CRF)
-    {
-#define ABR_INIT_QP ((int)param->rc.rfConstant)
-    }
-    reInit();
+void RateControl::reconfigure(int newBitrate, double newRfConstant, int newVbvMaxBitrate, int newVbvBufferSize)
+{
+    reconfigBitrate = newBitrate;
+    reconfigRfConstant = newRfConstant;
+    reconfigVbvMaxBitrate = newVbvMaxBitrate;
+    reconfigVbvBufferSize = newVbvBufferSize;
+    bReconfigPending = true;
+}
 
-    ipOffset = 6.0 * X265_LOG2(param->rc.ipFactor);
-    pbOffset = 6.0 * X265_LOG2(param->rc.pbFactor);
-    for (int i = 0; i < 3; i++)
-    {
-        lastQScaleFor[i] = x265_qp2qScale(param->rc.rateControlMode == X265_RC_CRF ? ABR_INIT_QP : ABR_INIT_QP_MIN);
-        lmin[i] = x265_qp2qScale(MIN_QP);
-        lmax[i] = x265_qp2qScale(MAX_MAX_QP);
-    }
+void RateControl::applyReconfig()
+{
+    double oldBitrate = bitrate;
 
-    if (param->rc.rateControlMode == X265_RC_CQP)
-    {
-        qpConstant[P_SLICE] = qp;
-        qpConstant[I_SLICE] = Clip3(0, MAX_MAX_QP, (int)(qp - ipOffset + 0.5));
-        qpConstant[B_SLICE] = Clip3(0, MAX_MAX_QP, (int)(qp + pbOffset + 0.5));
-    }
+    param->rc.bitrate = reconfigBitrate;
+    param->rc.rfConstant = reconfigRfConstant;
+    param->rc.vbvMaxBitrate = reconfigVbvMaxBitrate;
+    param->rc.vbvBufferSize = reconfigVbvBufferSize;
+    bReconfigPending = false;
 
-    /* qstep - value set as encoder specific */
-    lstep = pow(2, param->rc.qpStep / 6.0);
+    initReconfigurable(false);
+
+    /* the ABR accounting is against the old target, restart it */
+    if (param->rc.rateControlMode == X265_RC_ABR && bitrate != oldBitrate)
+        reInit();
 }
 
 void RateControl::reInit()
@@ -369,6 +419,9 @@ void RateControl::reInit()
 
 void RateControl::rateControlStart(TComPic* pic, Lookahead *l, RateControlEntry* rce, Encoder* enc)
 {
+    if (bReconfigPending)
+        applyReconfig();
+
     curSlice = pic->getSlice();
     sliceType = curSlice->getSliceType();
     rce->sliceType = sliceType;
@@ -381,6 +434,7 @@ void RateControl::rateControlStart(TComPic* pic, Lookahead *l, RateControlEntry*
     rce->bLastMiniGopBFrame = pic->m_lowres.bLastMiniGopBFrame;
     rce->bufferRate = bufferRate;
     rce->poc = curSlice->getPOC();
+    encodeOrder++;
     if (isVbv)
     {
         if (rce->rowPreds[0][0].count == 0)
@@ -686,6 +740,24 @@ double RateControl::clipQscale(TComPic* pic, double q)
                     terminate |= 1;
                     continue;
                 }
+                /* Within two buffer lengths of the end of the stream, steer the
+                 * fill towards the requested final fill, reaching it with the
+                 * last planned frames */
+                if (bufferFillEnd > 0)
+                {
+                    double endDuration = (param->totalFrames - encodeOrder) * frameDuration;
+                    if (endDuration > 0 && endDuration * vbvMaxRate <= 2 * bufferSize)
+                    {
+                        double planned = X265_MIN(1.0, (totalDuration + frameDuration) / endDuration);
+                        targetFill = bufferFill + (bufferFillEnd - bufferFill) * planned;
+                        if (bufferFillCur < targetFill)
+                        {
+                            q *= 1.01;
+                            terminate |= 1;
+                            continue;
+                        }
+                    }
+                }
                 /* Try to get the buffer no more than 80% filled, but don't set an impossible goal. */
                 targetFill = Clip3(bufferSize * 0.8, bufferSize, bufferFill - totalDuration * vbvMaxRate * 0.5);
                 if (vbvMinRate && bufferFillCur > targetFill)
@@ -93,6 +93,7 @@ struct RateControl
     double bufferFillFinal;  /* real buffer as of the last finished frame */
     double bufferFill;       /* planned buffer, if all in-progress frames hit their bit budget */
     double bufferRate;       /* # of bits added to buffer_fill after each frame */
+    double bufferFillEnd;    /* buffer fill to plan for after the last frame, or 0 */
     double vbvMaxRate;       /* in kbps */
     double vbvMinRate;       /* in kbps */
     bool singleFrameVbv;
@@ -123,6 +124,7 @@ struct RateControl
     int64_t totalBits;        /* totalbits used for already encoded frames */
     double lastRceq;
     int framesDone;           /* framesDone keeps track of # of frames passed through RateCotrol already */
+    int encodeOrder;          /* encode order of the current frame, not reset with the ABR state */
     double qCompress;
     double qpNoVbv;             /* QP for the current frame if 1-pass VBV was disabled. */
     RateControl(Encoder * _cfg);
@@ -133,8 +135,23 @@ struct RateControl
     int rateControlEnd(TComPic* pic, int64_t bits, RateControlEntry* rce);
     int rowDiagonalVbvRateControl(TComPic* pic, uint32_t row, RateControlEntry* rce, double& qpVbv);
 
+    // to be called by x265_encoder_reconfig() with validated targets, they are
+    // applied when the next frame starts, see rateControlStart()
+    void reconfigure(int newBitrate, double newRfConstant, int newVbvMaxBitrate, int newVbvBufferSize);
+
 protected:
 
+    /* targets of the last x265_encoder_reconfig() call, not yet applied. The
+     * frame encoders read the rate control state while they encode, so it
+     * only changes at frame boundaries */
+    bool   bReconfigPending;
+    int    reconfigBitrate;
+    double reconfigRfConstant;
+    int    reconfigVbvMaxBitrate;
+    int    reconfigVbvBufferSize;
+
+    void applyReconfig();
+    void initReconfigurable(bool bInit);
     void reInit();
     double getQScale(RateControlEntry *rce, double rateFactor);
     double rateEstimateQscale(TComPic* pic, RateControlEntry *rce); // main logic for calculating QP based on ABR
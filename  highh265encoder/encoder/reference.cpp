@@ -67,6 +67,14 @@ int MotionReference::init(TComPicYuv* pic, wpScalingParam *w)
         fpelPlane = m_weightBuffer + startpad;
     }
 
+    /* the cached half-pel planes are interpolated from unweighted pixels */
+    hpelPlane[0] = !isWeighted && pic->m_hpelOrg[0] ? fpelPlane : NULL;
+    for (int i = 1; i < 4; i++)
+        hpelPlane[i] = hpelPlane[0] ? pic->m_hpelOrg[i - 1] : NULL;
+
+    /* the summed area table also holds unweighted sums */
+    integralPlane = isWeighted ? NULL : pic->m_integralOrg;
+
     return 0;
 }
 
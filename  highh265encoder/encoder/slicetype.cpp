@@ -56,25 +56,66 @@ static inline void median_mv(MV &dst, MV a, MV b, MV c)
     dst.y = median(a.y, b.y, c.y);
 }
 
-Lookahead::Lookahead(Encoder *_cfg, ThreadPool* pool)
-    : est(pool)
+Lookahead::Lookahead(Encoder *_cfg, ThreadPool* _pool)
+    : est(_pool)
 {
     param = _cfg->param;
+    pool = _pool;
     lastKeyframe = -param->keyframeMax;
     lastNonB = NULL;
     widthInCU = ((param->sourceWidth / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
     heightInCU = ((param->sourceHeight / 2) + X265_LOWRES_CU_SIZE - 1) >> X265_LOWRES_CU_BITS;
     scratch = (int*)x265_malloc(widthInCU * sizeof(int));
     memset(histogram, 0, sizeof(histogram));
+
+    /* extra estimators only pay off if the pool can run their rows */
+    batchEst[0] = &est;
+    numBatchEst = pool ? X265_MAX(1, X265_MIN(X265_LOOKAHEAD_BATCH, pool->getThreadCount())) : 1;
+    for (int i = 1; i < numBatchEst; i++)
+    {
+        batchEst[i] = new CostEstimate(pool);
+    }
+
+    /* a lookahead thread only pays off if there is concurrent work */
+    bThreaded = param->bEnableWavefront || param->frameNumThreads > 1;
+    bThreadActive = false;
+    pendingFlushes = 0;
+    numSubmitted = 0;
 }
 
 Lookahead::~Lookahead() { }
 
-void Lookahead::init() { }
+void Lookahead::init()
+{
+    if (bThreaded)
+    {
+        bThreadActive = true;
+        if (!start())
+        {
+            x265_log(param, X265_LOG_WARNING, "unable to start lookahead thread, making slice decisions in-line\n");
+            bThreadActive = false;
+            bThreaded = false;
+        }
+    }
+}
 
 void Lookahead::destroy()
 {
-    // these two queues will be empty unless the encode was aborted
+    if (bThreadActive)
+    {
+        bThreadActive = false;
+        inputEvent.trigger();
+        stop();
+    }
+
+    // these queues will be empty unless the encode was aborted
+    while (!inputFifo.empty())
+    {
+        TComPic* pic = inputFifo.popFront();
+        pic->destroy();
+        delete pic;
+    }
+
     while (!inputQueue.empty())
     {
         TComPic* pic = inputQueue.popFront();
@@ -89,6 +130,11 @@ void Lookahead::destroy()
         delete pic;
     }
 
+    for (int i = 1; i < numBatchEst; i++)
+    {
+        delete batchEst[i];
+    }
+
     x265_free(scratch);
 }
 
@@ -97,18 +143,95 @@ void Lookahead::addPicture(TComPic *pic, int sliceType)
     TComPicYuv *orig = pic->getPicYuvOrg();
 
     pic->m_lowres.init(orig, pic->getSlice()->getPOC(), sliceType);
+
+    if (bThreaded)
+    {
+        inputLock.acquire();
+        inputFifo.pushBack(*pic);
+        inputLock.release();
+        numSubmitted++;
+        inputEvent.trigger();
+    }
+    else
+        queuePicture(pic);
+}
+
+void Lookahead::flush()
+{
+    if (bThreaded)
+    {
+        inputLock.acquire();
+        pendingFlushes++;
+        inputLock.release();
+        numSubmitted++;
+        inputEvent.trigger();
+    }
+    else
+        flushInput();
+}
+
+void Lookahead::queuePicture(TComPic *pic)
+{
     inputQueue.pushBack(*pic);
 
     if (inputQueue.size() >= param->lookaheadDepth)
         slicetypeDecide();
 }
 
-void Lookahead::flush()
+void Lookahead::flushInput()
 {
     if (!inputQueue.empty())
         slicetypeDecide();
 }
 
+TComPic* Lookahead::getDecidedPicture()
+{
+    if (bThreaded)
+    {
+        /* wait for the lookahead thread to process all submitted requests */
+        int processed = numProcessed.get();
+        while (processed != numSubmitted)
+            processed = numProcessed.waitForChange(processed);
+    }
+
+    return outputQueue.empty() ? NULL : outputQueue.popFront();
+}
+
+void Lookahead::threadMain()
+{
+    while (bThreadActive)
+    {
+        inputEvent.wait();
+
+        /* pictures are always submitted ahead of any flush request made in
+         * the same API call, so process them first */
+        while (bThreadActive)
+        {
+            TComPic *pic = NULL;
+            bool bFlush = false;
+
+            inputLock.acquire();
+            if (!inputFifo.empty())
+                pic = inputFifo.popFront();
+            else if (pendingFlushes)
+            {
+                pendingFlushes--;
+                bFlush = true;
+            }
+            inputLock.release();
+
+            if (pic)
+                queuePicture(pic);
+            else if (bFlush)
+                flushInput();
+            else
+                break;
+
+            numProcessed.incr();
+        }
+    }
+}
+
 // Called by RateControl to get the estimated SATD cost for a given picture.
 // It assumes dpb->prepareEncode() has already been called for the picture and
 // all the references are established
@@ -167,7 +290,7 @@ int64_t Lookahead::getEstimatedPictureCost(TComPic *pic)
 
     if (pic->m_lowres.costEst[b - p0][p1 - b] < 0)
     {
-        CostEstimate cost(ThreadPool::getThreadPool());
+        CostEstimate cost(pool);
         cost.init(param, pic);
         cost.estimateFrameCost(frames, p0, p1, b, false);
         cost.flush();
@@ -220,7 +343,12 @@ void Lookahead::slicetypeDecide()
     bool isKeyFrameAnalyse = (param->rc.cuTree || (param->rc.vbvBufferSize && param->lookaheadDepth));
 
     if (!est.rows && ipic)
-        est.init(param, ipic);
+    {
+        for (int i = 0; i < numBatchEst; i++)
+        {
+            batchEst[i]->init(param, ipic);
+        }
+    }
 
     if ((param->bFrameAdaptive && param->bframes) ||
         param->rc.cuTree || param->scenecutThreshold ||
@@ -340,12 +468,14 @@ void Lookahead::slicetypeDecide()
         else // P
             p0 = 0;
 
-        est.estimateFrameCost(frames, p0, p1, b, 0);
+        CostTuple tuples[X265_BFRAME_MAX + 2];
+        int numTuples = 0;
+        tuples[numTuples++].set(p0, p1, b);
 
         if ((p0 != p1 || bframes) && param->rc.vbvBufferSize)
         {
             // We need the intra costs for row SATDs
-            est.estimateFrameCost(frames, b, b, b, 0);
+            tuples[numTuples++].set(b, b, b);
 
             // We need B-frame costs for row SATDs
             p0 = 0;
@@ -358,11 +488,13 @@ void Lookahead::slicetypeDecide()
                     }
                 else
                     p1 = bframes + 1;
-                est.estimateFrameCost(frames, p0, p1, b, 0);
+                tuples[numTuples++].set(p0, p1, b);
                 if (frames[b]->sliceType == X265_TYPE_BREF)
                     p0 = b;
             }
         }
+
+        estimateFrameCosts(frames, tuples, numTuples);
     }
 
     /* dequeue all frames from inputQueue that are about to be enqueued
@@ -450,6 +582,85 @@ void Lookahead::vbvLookahead(Lowres **frames, int numFrames, int keyframe)
     frames[nextNonB]->plannedType[idx] = X265_TYPE_AUTO;
 }
 
+void Lookahead::estimateFrameCosts(Lowres **frames, const CostTuple *tuples, int count)
+{
+    if (numBatchEst == 1)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            est.estimateFrameCost(frames, tuples[i].p0, tuples[i].p1, tuples[i].b, 0);
+        }
+
+        return;
+    }
+
+    /* Estimates of the same frame b share its intra costs, motion vectors and
+     * weights, so they must be made one after another. Each pass starts the
+     * first pending estimate of up to numBatchEst distinct frames, in list
+     * order, and waits for all of them to complete */
+    bool done[X265_LOOKAHEAD_MAX + 2];
+    int first = 0;
+    memset(done, 0, count * sizeof(bool));
+
+    while (first < count)
+    {
+        int running[X265_LOOKAHEAD_BATCH];
+        int busyB[X265_LOOKAHEAD_MAX + 2];
+        int numRunning = 0, numBusy = 0;
+
+        for (int i = first; i < count && numRunning < numBatchEst; i++)
+        {
+            if (done[i])
+                continue;
+
+            const CostTuple &t = tuples[i];
+            bool bBusy = false;
+            for (int j = 0; j < numBusy && !bBusy; j++)
+            {
+                bBusy = busyB[j] == t.b;
+            }
+
+            if (bBusy)
+                continue;
+            busyB[numBusy++] = t.b;
+
+            if (CostEstimate::isCostCached(frames, t.p0, t.p1, t.b))
+                done[i] = true;
+            else
+            {
+                batchEst[numRunning]->startFrameCost(frames, t.p0, t.p1, t.b);
+                running[numRunning++] = i;
+            }
+        }
+
+        /* help process the rows of every running estimate */
+        bool bWorking = true;
+        while (bWorking)
+        {
+            bWorking = false;
+            for (int j = 0; j < numRunning; j++)
+            {
+                if (!batchEst[j]->rowsCompleted)
+                {
+                    bWorking = true;
+                    batchEst[j]->findJob();
+                }
+            }
+        }
+
+        for (int j = 0; j < numRunning; j++)
+        {
+            batchEst[j]->finishFrameCost();
+            done[running[j]] = true;
+        }
+
+        while (first < count && done[first])
+        {
+            first++;
+        }
+    }
+}
+
 int64_t Lookahead::vbvFrameCost(Lowres **frames, int p0, int p1, int b)
 {
     int64_t cost = est.estimateFrameCost(frames, p0, p1, b, 0);
@@ -553,6 +764,9 @@ void Lookahead::slicetypeAnalyse(Lowres **frames, bool bKeyframe)
                     continue;
                 }
 
+                const CostTuple fastCosts[3] = { { i + 0, i + 2, i + 1 }, { i + 0, i + 1, i + 1 }, { i + 1, i + 2, i + 2 } };
+                estimateFrameCosts(frames, fastCosts, 3);
+
                 cost1b1 = est.estimateFrameCost(frames, i + 0, i + 2, i + 1, 0);
                 cost1p0 = est.estimateFrameCost(frames, i + 0, i + 1, i + 1, 0);
                 cost2p0 = est.estimateFrameCost(frames, i + 1, i + 2, i + 2, 0);
@@ -826,6 +1040,11 @@ void Lookahead::cuTree(Lowres **frames, int numframes, bool bIntra)
     int i = numframes;
     int cuCount = widthInCU * heightInCU;
 
+    /* make all of the frame cost estimates up front, concurrently. The
+     * estimateFrameCost() calls below only fetch the cached results */
+    CostTuple tuples[X265_LOOKAHEAD_MAX + 2];
+    estimateFrameCosts(frames, tuples, cuTreeCostTuples(frames, numframes, bIntra, tuples));
+
     if (bIntra)
         est.estimateFrameCost(frames, 0, 0, 0, 0);
 
@@ -915,6 +1134,74 @@ void Lookahead::cuTree(Lowres **frames, int numframes, bool bIntra)
         cuTreeFinish(frames[lastnonb + (bframes + 1) / 2], averageDuration, 0);
 }
 
+/* lists the frame cost estimates made by cuTree(), in the order it makes them */
+int Lookahead::cuTreeCostTuples(Lowres **frames, int numframes, bool bIntra, CostTuple *tuples)
+{
+    int idx = !bIntra;
+    int numTuples = 0;
+    int i = numframes;
+
+    if (bIntra)
+        tuples[numTuples++].set(0, 0, 0);
+
+    while (i > 0 && frames[i]->sliceType == X265_TYPE_B)
+    {
+        i--;
+    }
+
+    int lastnonb = i;
+
+    if (!param->lookaheadDepth)
+    {
+        if (bIntra)
+            return numTuples;
+    }
+    else if (lastnonb < idx)
+        return numTuples;
+
+    while (i-- > idx)
+    {
+        int curnonb = i;
+        while (frames[curnonb]->sliceType == X265_TYPE_B && curnonb > 0)
+        {
+            curnonb--;
+        }
+
+        if (curnonb < idx)
+            break;
+
+        tuples[numTuples++].set(curnonb, lastnonb, lastnonb);
+        int bframes = lastnonb - curnonb - 1;
+        if (param->bBPyramid && bframes > 1)
+        {
+            int middle = (bframes + 1) / 2 + curnonb;
+            tuples[numTuples++].set(curnonb, lastnonb, middle);
+            while (i > curnonb)
+            {
+                int p0 = i > middle ? middle : curnonb;
+                int p1 = i < middle ? middle : lastnonb;
+                if (i != middle)
+                    tuples[numTuples++].set(p0, p1, i);
+                i--;
+            }
+        }
+        else
+        {
+            while (i > curnonb)
+            {
+                tuples[numTuples++].set(curnonb, lastnonb, i);
+                i--;
+            }
+        }
+        lastnonb = curnonb;
+    }
+
+    if (!param->lookaheadDepth)
+        tuples[numTuples++].set(0, lastnonb, lastnonb);
+
+    return numTuples;
+}
+
 void Lookahead::estimateCUPropagate(Lowres **frames, double averageDuration, int p0, int p1, int b, int referenced)
 {
     uint16_t *refCosts[2] = { frames[p0]->propagateCost, frames[p1]->propagateCost };
@@ -1093,6 +1380,7 @@ int64_t Lookahead::frameCostRecalculate(Lowres** frames, int p0, int p1, int b)
 CostEstimate::CostEstimate(ThreadPool *p)
     : WaveFront(p)
 {
+    setPriority(PRIORITY_LOOKAHEAD);
     param = NULL;
     curframes = NULL;
     wbuffer[0] = wbuffer[1] = wbuffer[2] = wbuffer[3] = 0;
@@ -1160,90 +1448,118 @@ int64_t CostEstimate::estimateFrameCost(Lowres **frames, int p0, int p1, int b,
     int64_t score = 0;
     Lowres *fenc = frames[b];
 
-    if (fenc->costEst[b - p0][p1 - b] >= 0 && fenc->rowSatds[b - p0][p1 - b][0] != -1)
+    if (isCostCached(frames, p0, p1, b))
         score = fenc->costEst[b - p0][p1 - b];
     else
     {
-        weightedRef.isWeighted = false;
-        if (param->bEnableWeightedPred && b == p1 && b != p0 && fenc->lowresMvs[0][b - p0 - 1][0].x == 0x7FFF)
-        {
-            if (!fenc->bIntraCalculated)
-                estimateFrameCost(frames, b, b, b, 0);
-            weightsAnalyse(frames, b, p0);
-        }
+        startFrameCost(frames, p0, p1, b);
+        score = finishFrameCost();
+    }
 
-        /* For each list, check to see whether we have lowres motion-searched this reference */
-        bDoSearch[0] = b != p0 && fenc->lowresMvs[0][b - p0 - 1][0].x == 0x7FFF;
-        bDoSearch[1] = b != p1 && fenc->lowresMvs[1][p1 - b - 1][0].x == 0x7FFF;
+    if (bIntraPenalty)
+    {
+        // arbitrary penalty for I-blocks after B-frames
+        int ncu = NUM_CUS;
+        score += (uint64_t)score * fenc->intraMbs[b - p0] / (ncu * 8);
+    }
+    return score;
+}
 
-        if (bDoSearch[0]) fenc->lowresMvs[0][b - p0 - 1][0].x = 0;
-        if (bDoSearch[1]) fenc->lowresMvs[1][p1 - b - 1][0].x = 0;
+bool CostEstimate::isCostCached(Lowres **frames, int p0, int p1, int b)
+{
+    Lowres *fenc = frames[b];
 
-        curb = b;
-        curp0 = p0;
-        curp1 = p1;
-        curframes = frames;
-        fenc->costEst[b - p0][p1 - b] = 0;
-        fenc->costEstAq[b - p0][p1 - b] = 0;
+    return fenc->costEst[b - p0][p1 - b] >= 0 && fenc->rowSatds[b - p0][p1 - b][0] != -1;
+}
 
-        for (int i = 0; i < heightInCU; i++)
-        {
-            rows[i].init();
-            rows[i].me.setSourcePlane(fenc->lowresPlane[0], fenc->lumaStride);
-        }
+void CostEstimate::startFrameCost(Lowres **frames, int p0, int p1, int b)
+{
+    Lowres *fenc = frames[b];
 
-        rowsCompleted = false;
+    weightedRef.isWeighted = false;
+    if (param->bEnableWeightedPred && b == p1 && b != p0 && fenc->lowresMvs[0][b - p0 - 1][0].x == 0x7FFF)
+    {
+        if (!fenc->bIntraCalculated)
+            estimateFrameCost(frames, b, b, b, 0);
+        weightsAnalyse(frames, b, p0);
+    }
 
-        if (m_pool)
-        {
-            WaveFront::enqueue();
+    /* For each list, check to see whether we have lowres motion-searched this reference */
+    bDoSearch[0] = b != p0 && fenc->lowresMvs[0][b - p0 - 1][0].x == 0x7FFF;
+    bDoSearch[1] = b != p1 && fenc->lowresMvs[1][p1 - b - 1][0].x == 0x7FFF;
 
-            // enableAllRows must be already called
-            enqueueRow(0);
-            while (!rowsCompleted)
-            {
-                WaveFront::findJob();
-            }
+    if (bDoSearch[0]) fenc->lowresMvs[0][b - p0 - 1][0].x = 0;
+    if (bDoSearch[1]) fenc->lowresMvs[1][p1 - b - 1][0].x = 0;
 
-            WaveFront::dequeue();
-        }
-        else
-        {
-            for (int row = 0; row < heightInCU; row++)
-            {
-                processRow(row);
-            }
+    curb = b;
+    curp0 = p0;
+    curp1 = p1;
+    curframes = frames;
+    fenc->costEst[b - p0][p1 - b] = 0;
+    fenc->costEstAq[b - p0][p1 - b] = 0;
 
-            x265_emms();
-        }
+    for (int i = 0; i < heightInCU; i++)
+    {
+        rows[i].init();
+        rows[i].me.setSourcePlane(fenc->lowresPlane[0], fenc->lumaStride);
+    }
 
-        // Accumulate cost from each row
+    rowsCompleted = false;
+
+    if (m_pool)
+    {
+        WaveFront::enqueue();
+
+        // enableAllRows must be already called
+        enqueueRow(0);
+    }
+    else
+    {
         for (int row = 0; row < heightInCU; row++)
         {
-            score += rows[row].costEst;
-            fenc->costEst[0][0] += rows[row].costIntra;
-            if (param->rc.aqMode)
-            {
-                fenc->costEstAq[0][0] += rows[row].costIntraAq;
-                fenc->costEstAq[b - p0][p1 - b] += rows[row].costEstAq;
-            }
-            fenc->intraMbs[b - p0] += rows[row].intraMbs;
+            processRow(row);
         }
 
-        fenc->bIntraCalculated = true;
+        x265_emms();
+    }
+}
+
+int64_t CostEstimate::finishFrameCost()
+{
+    int64_t score = 0;
+    Lowres *fenc = curframes[curb];
+    int b = curb, p0 = curp0, p1 = curp1;
+
+    if (m_pool)
+    {
+        while (!rowsCompleted)
+        {
+            WaveFront::findJob();
+        }
 
-        if (b != p1)
-            score = (uint64_t)score * 100 / (130 + param->bFrameBias);
-        if (b != p0 || b != p1) //Not Intra cost
-            fenc->costEst[b - p0][p1 - b] = score;
+        WaveFront::dequeue();
     }
 
-    if (bIntraPenalty)
+    // Accumulate cost from each row
+    for (int row = 0; row < heightInCU; row++)
     {
-        // arbitrary penalty for I-blocks after B-frames
-        int ncu = NUM_CUS;
-        score += (uint64_t)score * fenc->intraMbs[b - p0] / (ncu * 8);
+        score += rows[row].costEst;
+        fenc->costEst[0][0] += rows[row].costIntra;
+        if (param->rc.aqMode)
+        {
+            fenc->costEstAq[0][0] += rows[row].costIntraAq;
+            fenc->costEstAq[b - p0][p1 - b] += rows[row].costEstAq;
+        }
+        fenc->intraMbs[b - p0] += rows[row].intraMbs;
     }
+
+    fenc->bIntraCalculated = true;
+
+    if (b != p1)
+        score = (uint64_t)score * 100 / (130 + param->bFrameBias);
+    if (b != p0 || b != p1) //Not Intra cost
+        fenc->costEst[b - p0][p1 - b] = score;
+
     return score;
 }
 
@@ -27,6 +27,7 @@
 #include "motion.h"
 #include "piclist.h"
 #include "wavefront.h"
+#include "threading.h"
 
 namespace x265 {
 // private namespace
@@ -35,6 +36,9 @@ struct Lowres;
 class TComPic;
 class Encoder;
 
+/* maximum number of frame cost estimates made concurrently by the lookahead */
+#define X265_LOOKAHEAD_BATCH 4
+
 #define SET_WEIGHT(w, b, s, d, o) \
     { \
         (w).inputWeight = (s); \
@@ -83,6 +87,14 @@ struct EstimateRow
     void estimateCUCost(Lowres * *frames, ReferencePlanes * wfref0, int cux, int cuy, int p0, int p1, int b, bool bDoSearch[2]);
 };
 
+/* a lowres frame cost estimate request: frame b predicted from p0 and p1 */
+struct CostTuple
+{
+    int p0, p1, b;
+
+    void set(int _p0, int _p1, int _b) { p0 = _p0; p1 = _p1; b = _b; }
+};
+
 /* CostEstimate manages the cost estimation of a single frame, ie:
  * estimateFrameCost() and everything below it in the call graph */
 struct CostEstimate : public WaveFront
@@ -110,13 +122,26 @@ struct CostEstimate : public WaveFront
     void     processRow(int row);
     int64_t  estimateFrameCost(Lowres **frames, int p0, int p1, int b, bool bIntraPenalty);
 
+    /* split form of estimateFrameCost() for an estimate which is not already
+     * cached. startFrameCost() enqueues the rows and returns immediately,
+     * finishFrameCost() waits for all rows and returns the unpenalized score */
+    static bool isCostCached(Lowres **frames, int p0, int p1, int b);
+    void     startFrameCost(Lowres **frames, int p0, int p1, int b);
+    int64_t  finishFrameCost();
+
 protected:
 
     void     weightsAnalyse(Lowres **frames, int b, int p0);
     uint32_t weightCostLuma(Lowres **frames, int b, int p0, wpScalingParam *w);
 };
 
-struct Lookahead
+/* When the encoder is multi-threaded, slice decisions are made by a dedicated
+ * lookahead thread. The API thread submits pictures and flush requests to it
+ * and the decisions are made while the API thread waits on the frame encoders.
+ * Before a decided picture is taken from the output queue the API thread waits
+ * for all of its requests to be processed, so the slice decisions and the
+ * frame encoder assignments are identical to the single threaded behavior */
+struct Lookahead : public Thread
 {
     Lookahead(Encoder *, ThreadPool *pool);
     ~Lookahead();
@@ -124,10 +149,22 @@ struct Lookahead
     void destroy();
 
     CostEstimate     est;             // Frame cost estimator
+    CostEstimate    *batchEst[X265_LOOKAHEAD_BATCH]; // estimators used by estimateFrameCosts(), [0] is est
+    int              numBatchEst;
     PicList          inputQueue;      // input pictures in order received
     PicList          outputQueue;     // pictures to be encoded, in encode order
 
+    bool             bThreaded;       // slice decisions made by lookahead thread
+    volatile bool    bThreadActive;
+    PicList          inputFifo;       // submitted pictures, not yet in inputQueue
+    int              pendingFlushes;  // submitted flush requests
+    Lock             inputLock;       // protects inputFifo and pendingFlushes
+    Event            inputEvent;      // triggered for each submitted request
+    int              numSubmitted;    // requests submitted by the API thread
+    ThreadSafeInteger numProcessed;   // requests processed by the lookahead thread
+
     x265_param      *param;
+    ThreadPool      *pool;            // the encoder's client handle of its thread pool
     Lowres          *lastNonB;
     int             *scratch;         // temp buffer
 
@@ -139,10 +176,19 @@ struct Lookahead
     void addPicture(TComPic*, int sliceType);
     void flush();
 
+    /* returns the next picture in encode order, or NULL */
+    TComPic* getDecidedPicture();
+
+    void threadMain();
+
     int64_t getEstimatedPictureCost(TComPic *pic);
 
 protected:
 
+    /* called by addPicture() or by the lookahead thread */
+    void queuePicture(TComPic*);
+    void flushInput();
+
     /* called by addPicture() or flush() to trigger slice decisions */
     void slicetypeDecide();
     void slicetypeAnalyse(Lowres **frames, bool bKeyframe);
@@ -155,9 +201,15 @@ protected:
     int64_t vbvFrameCost(Lowres **frames, int p0, int p1, int b);
     void    vbvLookahead(Lowres **frames, int numFrames, int keyframes);
 
+    /* computes a list of frame costs, concurrently when a thread pool is
+     * available. Estimates of the same frame are made in list order so the
+     * results are identical to estimateFrameCost() calls made in that order */
+    void    estimateFrameCosts(Lowres **frames, const CostTuple *tuples, int count);
+
     /* called by slicetypeAnalyse() to effect cuTree adjustments to adaptive
      * quant offsets */
     void cuTree(Lowres **frames, int numframes, bool bintra);
+    int  cuTreeCostTuples(Lowres **frames, int numframes, bool bintra, CostTuple *tuples);
     void estimateCUPropagate(Lowres **frames, double average_duration, int p0, int p1, int b, int referenced);
     void estimateCUPropagateCost(int *dst, uint16_t *propagateIn, int32_t *intraCosts, uint16_t *interCosts,
                                  int32_t *invQscales, double *fpsFactor, int len);
@@ -0,0 +1,180 @@
+/*****************************************************************************
+ * Copyright (C) 2013 x265 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@multicorewareinc.com.
+ *****************************************************************************/
+
+#include "filemap.h"
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace x265;
+
+FileMap::FileMap()
+{
+    m_base = NULL;
+    m_size = 0;
+    m_prefetchEnd = 0;
+    m_pageSize = 4096;
+#if _WIN32
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+#endif
+}
+
+#if _WIN32
+
+bool FileMap::open(const char *filename)
+{
+    close();
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    m_pageSize = si.dwPageSize;
+
+    m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (GetFileType(m_file) != FILE_TYPE_DISK || !GetFileSizeEx(m_file, &size) ||
+        !size.QuadPart || (uint64_t)(size_t)size.QuadPart != (uint64_t)size.QuadPart)
+    {
+        close();
+        return false;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (m_mapping)
+        m_base = (uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (!m_base)
+    {
+        close();
+        return false;
+    }
+
+    m_size = size.QuadPart;
+    return true;
+}
+
+void FileMap::close()
+{
+    if (m_base)
+        UnmapViewOfFile(m_base);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+    m_base = NULL;
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+    m_size = 0;
+    m_prefetchEnd = 0;
+}
+
+void FileMap::adviseSequential()
+{
+    /* requested by FILE_FLAG_SEQUENTIAL_SCAN */
+}
+
+void FileMap::prefetch(uint64_t, uint64_t)
+{
+    /* PrefetchVirtualMemory() is not available before Windows 8, the
+     * sequential scan hint drives the read ahead */
+}
+
+#else /* POSIX */
+
+bool FileMap::open(const char *filename)
+{
+    close();
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize > 0)
+        m_pageSize = (size_t)pageSize;
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (uint64_t)(size_t)st.st_size != (uint64_t)st.st_size)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    /* the mapping stays valid once the descriptor is closed */
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    m_base = (uint8_t*)base;
+    m_size = st.st_size;
+    return true;
+}
+
+void FileMap::close()
+{
+    if (m_base)
+        munmap(m_base, (size_t)m_size);
+    m_base = NULL;
+    m_size = 0;
+    m_prefetchEnd = 0;
+}
+
+void FileMap::adviseSequential()
+{
+#ifdef MADV_SEQUENTIAL
+    if (m_base)
+        madvise(m_base, (size_t)m_size, MADV_SEQUENTIAL);
+#endif
+}
+
+void FileMap::prefetch(uint64_t offset, uint64_t length)
+{
+#ifdef MADV_WILLNEED
+    uint64_t end = offset + length < m_size ? offset + length : m_size;
+    if (offset < m_prefetchEnd)
+        offset = m_prefetchEnd;
+    if (!m_base || offset >= end)
+        return;
+
+    m_prefetchEnd = end;
+
+    /* madvise() requires a page aligned address */
+    uint64_t start = offset - offset % m_pageSize;
+    madvise(m_base + start, (size_t)(end - start), MADV_WILLNEED);
+#else
+    (void)offset;
+    (void)length;
+#endif
+}
+
+#endif // if _WIN32
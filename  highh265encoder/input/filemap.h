@@ -0,0 +1,77 @@
+/*****************************************************************************
+ * Copyright (C) 2013 x265 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@multicorewareinc.com.
+ *****************************************************************************/
+
+#ifndef X265_FILEMAP_H
+#define X265_FILEMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace x265 {
+// private x265 namespace
+
+/* Maps a whole input file into memory, so the input readers may hand the
+ * encoder pointers to the mapped pages instead of copying each frame into a
+ * queue. The mapping is copy-on-write, the pictures may be modified in place
+ * (dither) without touching the file */
+class FileMap
+{
+public:
+
+    FileMap();
+
+    ~FileMap()                   { close(); }
+
+    /* Returns false if the file is not a regular file or cannot be mapped,
+     * the readers then fall back to stream reads */
+    bool open(const char *filename);
+
+    void close();
+
+    bool isOpen() const          { return !!m_base; }
+
+    uint8_t *data() const        { return m_base; }
+
+    uint64_t size() const        { return m_size; }
+
+    /* Hint that the file is read once, front to back */
+    void adviseSequential();
+
+    /* Ask the kernel to start reading the given range in the background.
+     * The part of the range below the end of the last request is skipped,
+     * so the readers may request their whole read ahead window per frame */
+    void prefetch(uint64_t offset, uint64_t length);
+
+protected:
+
+    uint8_t *m_base;
+    uint64_t m_size;
+    uint64_t m_prefetchEnd;
+    size_t   m_pageSize;
+
+#if _WIN32
+    void    *m_file;
+    void    *m_mapping;
+#endif
+};
+}
+
+#endif // ifndef X265_FILEMAP_H
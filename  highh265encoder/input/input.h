@@ -51,6 +51,8 @@ struct InputFileInfo
 
     /* user supplied */
     int skipFrames;
+    int prefetchFrames; // frames to read ahead of the encoder, memory mapped files only
+    bool bMemoryMap;    // read regular files in place from a memory mapping
     const char *filename;
 };
 
@@ -60,6 +60,9 @@ Y4MInput::Y4MInput(InputFileInfo& info)
     height = info.height;
     rateNum = info.fpsNum;
     rateDenom = info.fpsDenom;
+    mapOffset = 0;
+    framePayload = 0;
+    prefetchFrames = info.prefetchFrames;
 
     ifs = NULL;
     if (!strcmp(info.filename, "-"))
@@ -76,9 +79,26 @@ Y4MInput::Y4MInput(InputFileInfo& info)
     if (ifs && ifs->good() && parseHeader())
     {
         threadActive = true;
-        for (uint32_t i = 0; i < QUEUE_SIZE; i++)
+        for (int i = 0; i < x265_cli_csps[colorSpace].planes; i++)
         {
-            pictureAlloc(i);
+            plane_stride[i] = (uint32_t)(width >> x265_cli_csps[colorSpace].width[i]);
+            plane_size[i] =   (uint32_t)(plane_stride[i] * (height >> x265_cli_csps[colorSpace].height[i]));
+            framePayload += plane_size[i];
+        }
+
+        /* a memory mapped file is read in place, it needs no frame queue. The
+         * stream remains open, it has only parsed the file header */
+        if (info.bMemoryMap && ifs != &cin && map.open(info.filename))
+        {
+            map.adviseSequential();
+            mapOffset = (uint64_t)ifs->tellg();
+        }
+        else
+        {
+            for (uint32_t i = 0; i < QUEUE_SIZE; i++)
+            {
+                pictureAlloc(i);
+            }
         }
     }
     if (!threadActive)
@@ -137,9 +157,14 @@ Y4MInput::Y4MInput(InputFileInfo& info)
 
     if (info.skipFrames)
     {
-        for (int i = 0; i < info.skipFrames; i++)
+        if (map.isOpen())
+            seekMapped(info.skipFrames);
+        else
         {
-            ifs->ignore(frameSize);
+            for (int i = 0; i < info.skipFrames; i++)
+            {
+                ifs->ignore(frameSize);
+            }
         }
     }
 }
@@ -162,8 +187,6 @@ void Y4MInput::pictureAlloc(int queueindex)
 {
     for (int i = 0; i < x265_cli_csps[colorSpace].planes; i++)
     {
-        plane_stride[i] = (uint32_t)(width >> x265_cli_csps[colorSpace].width[i]);
-        plane_size[i] =   (uint32_t)(plane_stride[i] * (height >> x265_cli_csps[colorSpace].height[i]));
         plane[queueindex][i] = new char[plane_size[i]];
         if (!plane[queueindex][i])
         {
@@ -357,11 +380,40 @@ bool Y4MInput::parseHeader()
 void Y4MInput::startReader()
 {
 #if ENABLE_THREADING
-    if (threadActive)
+    if (threadActive && !map.isOpen())
         start();
 #endif
 }
 
+/* Move mapOffset forward by skipFrames frames. Frame headers usually have no
+ * parameters, then the frames have a fixed size and the target frame header
+ * is found at once. Otherwise the frame headers are walked one by one */
+void Y4MInput::seekMapped(int skipFrames)
+{
+    const uint8_t *base = map.data();
+    const uint64_t size = map.size();
+    const uint64_t fixedSize = strlen(header) + 1 + framePayload;
+    uint64_t target = mapOffset + (uint64_t)skipFrames * fixedSize;
+
+    if (mapOffset + strlen(header) < size && base[mapOffset + strlen(header)] == '\n' &&
+        target + strlen(header) <= size && !memcmp(base + target, header, strlen(header)))
+    {
+        mapOffset = target;
+        return;
+    }
+
+    for (int i = 0; i < skipFrames; i++)
+    {
+        if (mapOffset + strlen(header) > size || memcmp(base + mapOffset, header, strlen(header)))
+            return;
+
+        while (mapOffset < size && base[mapOffset] != '\n')
+            mapOffset++;
+
+        mapOffset += 1 + framePayload;
+    }
+}
+
 void Y4MInput::threadMain()
 {
     do
@@ -380,6 +432,39 @@ void Y4MInput::threadMain()
 
 bool Y4MInput::readPicture(x265_picture& pic)
 {
+    if (map.isOpen())
+    {
+        /* strip off the FRAME header and its parameters, in place */
+        const uint8_t *base = map.data();
+        const uint64_t size = map.size();
+        if (mapOffset + strlen(header) > size || memcmp(base + mapOffset, header, strlen(header)))
+            return false;
+
+        uint64_t offset = mapOffset + strlen(header);
+        while (offset < size && base[offset] != '\n')
+            offset++;
+        offset++;
+
+        if (offset + framePayload > size)
+            return false;
+
+        /* keep the kernel reading prefetchFrames frames ahead of the encoder */
+        map.prefetch(offset, (uint64_t)(prefetchFrames + 1) * (framePayload + strlen(header) + 1));
+
+        pic.bitDepth = 8;
+        pic.colorSpace = colorSpace;
+        char *frame = (char*)base + offset;
+        for (int i = 0; i < x265_cli_csps[colorSpace].planes; i++)
+        {
+            pic.planes[i] = frame;
+            pic.stride[i] = plane_stride[i];
+            frame += plane_size[i];
+        }
+
+        mapOffset = offset + framePayload;
+        return true;
+    }
+
     PPAStartCpuEventFunc(read_yuv);
     int curHead = head.get();
     int curTail = tail.get();
@@ -25,6 +25,7 @@
 #define X265_Y4M_H
 
 #include "input.h"
+#include "filemap.h"
 #include "threading.h"
 #include <fstream>
 
@@ -67,8 +68,20 @@ protected:
 
     std::istream *ifs;
 
+    /* when the file is memory mapped the frames are read in place, without
+     * the reader thread. mapOffset is the offset of the next frame header */
+    FileMap map;
+
+    uint64_t mapOffset;
+
+    uint32_t framePayload;
+
+    int prefetchFrames;
+
     bool parseHeader();
 
+    void seekMapped(int skipFrames);
+
     void pictureAlloc(int index);
 
     void threadMain();
@@ -83,7 +96,7 @@ public:
 
     void release();
 
-    bool isEof() const            { return ifs && ifs->eof();  }
+    bool isEof() const            { return map.isOpen() ? mapOffset + framePayload > map.size() : ifs && ifs->eof(); }
 
     bool isFail()                 { return !(ifs && !ifs->fail() && threadActive); }
 
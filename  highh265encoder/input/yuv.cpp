@@ -57,6 +57,8 @@ YUVInput::YUVInput(InputFileInfo& info)
     colorSpace = info.csp;
     threadActive = false;
     ifs = NULL;
+    mapOffset = 0;
+    prefetchFrames = info.prefetchFrames;
 
     if (width == 0 || height == 0 || info.fpsNum == 0 || info.fpsDenom == 0)
     {
@@ -64,6 +66,23 @@ YUVInput::YUVInput(InputFileInfo& info)
         return;
     }
 
+    pixelbytes = depth > 8 ? 2 : 1;
+    for (int i = 0; i < x265_cli_csps[colorSpace].planes; i++)
+    {
+        uint32_t w = width >> x265_cli_csps[colorSpace].width[i];
+        uint32_t h = height >> x265_cli_csps[colorSpace].height[i];
+        framesize += w * h * pixelbytes;
+    }
+
+    /* a memory mapped file needs no frame queue, and seeks at once */
+    if (info.bMemoryMap && strcmp(info.filename, "-") && map.open(info.filename))
+    {
+        map.adviseSequential();
+        info.frameCount = (int)(map.size() / framesize);
+        mapOffset = (uint64_t)info.skipFrames * framesize;
+        return;
+    }
+
     if (!strcmp(info.filename, "-"))
     {
         ifs = &cin;
@@ -84,14 +103,6 @@ YUVInput::YUVInput(InputFileInfo& info)
         return;
     }
 
-    pixelbytes = depth > 8 ? 2 : 1;
-    for (int i = 0; i < x265_cli_csps[colorSpace].planes; i++)
-    {
-        uint32_t w = width >> x265_cli_csps[colorSpace].width[i];
-        uint32_t h = height >> x265_cli_csps[colorSpace].height[i];
-        framesize += w * h * pixelbytes;
-    }
-
     for (uint32_t i = 0; i < QUEUE_SIZE; i++)
     {
         buf[i] = new char[framesize];
@@ -204,37 +215,53 @@ bool YUVInput::populateFrameQueue()
 
 bool YUVInput::readPicture(x265_picture& pic)
 {
-    int curHead = head.get();
-    int curTail = tail.get();
-
-#if ENABLE_THREADING
+    char *frame;
 
-    while (curHead == curTail)
+    if (map.isOpen())
     {
-        curTail = tail.waitForChange(curTail);
-        if (!threadActive)
+        if (mapOffset + framesize > map.size())
             return false;
+
+        /* keep the kernel reading prefetchFrames frames ahead of the encoder */
+        map.prefetch(mapOffset, (uint64_t)(prefetchFrames + 1) * framesize);
+        frame = (char*)map.data() + mapOffset;
+        mapOffset += framesize;
     }
+    else
+    {
+        int curHead = head.get();
+        int curTail = tail.get();
+
+#if ENABLE_THREADING
+
+        while (curHead == curTail)
+        {
+            curTail = tail.waitForChange(curTail);
+            if (!threadActive)
+                return false;
+        }
 
 #else
 
-    populateFrameQueue();
+        populateFrameQueue();
 
 #endif
 
-    if (!frameStat[curHead])
-        return false;
+        if (!frameStat[curHead])
+            return false;
+
+        frame = buf[curHead];
+        head.set((curHead + 1) % QUEUE_SIZE);
+    }
 
     pic.colorSpace = colorSpace;
     pic.bitDepth = depth;
     pic.stride[0] = width * pixelbytes;
     pic.stride[1] = pic.stride[0] >> x265_cli_csps[colorSpace].width[1];
     pic.stride[2] = pic.stride[0] >> x265_cli_csps[colorSpace].width[2];
-    pic.planes[0] = buf[curHead];
+    pic.planes[0] = frame;
     pic.planes[1] = (char*)pic.planes[0] + pic.stride[0] * height;
     pic.planes[2] = (char*)pic.planes[1] + pic.stride[1] * (height >> x265_cli_csps[colorSpace].height[1]);
 
-    head.set((curHead + 1) % QUEUE_SIZE);
-
     return true;
 }
@@ -25,6 +25,7 @@
 #define X265_YUV_H
 
 #include "input.h"
+#include "filemap.h"
 #include "threading.h"
 #include <fstream>
 
@@ -61,6 +62,14 @@ protected:
 
     std::istream *ifs;
 
+    /* when the file is memory mapped the frames are read in place, without
+     * the reader thread. mapOffset is the offset of the next frame */
+    FileMap map;
+
+    uint64_t mapOffset;
+
+    int prefetchFrames;
+
     int guessFrameCount();
 
     void threadMain();
@@ -75,9 +84,9 @@ public:
 
     void release();
 
-    bool isEof() const                            { return ifs && ifs->eof();  }
+    bool isEof() const                            { return map.isOpen() ? mapOffset + framesize > map.size() : ifs && ifs->eof(); }
 
-    bool isFail()                                 { return !(ifs && !ifs->fail() && threadActive); }
+    bool isFail()                                 { return !(map.isOpen() || (ifs && !ifs->fail() && threadActive)); }
 
     void startReader();
 
@@ -0,0 +1,314 @@
+/*****************************************************************************
+ * Copyright (C) 2013 x265 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@multicorewareinc.com.
+ *****************************************************************************/
+
+#include "common.h"
+#include "writer.h"
+
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if _WIN32
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace x265;
+
+WriterThread::WriterThread()
+{
+    endEntry = -1;
+    bThreaded = false;
+}
+
+int WriterThread::acquireSlot()
+{
+    /* only this thread increments queued */
+    int q = queued.get();
+    int w = written.get();
+
+    while (q - w >= QUEUE_DEPTH)
+        w = written.waitForChange(w);
+
+    return q % QUEUE_DEPTH;
+}
+
+void WriterThread::commitSlot()
+{
+    if (bThreaded)
+        queued.incr();
+    else
+    {
+        int q = queued.get();
+        writeEntries(q, 1);
+        queued.set(q + 1);
+        written.set(q + 1);
+    }
+}
+
+void WriterThread::finish()
+{
+    if (!bThreaded)
+        return;
+
+    /* the end marker takes no slot, the thread stops before it */
+    endEntry = queued.get();
+    queued.incr();
+    stop();
+    bThreaded = false;
+}
+
+void WriterThread::threadMain()
+{
+    int done = 0;
+
+    while (true)
+    {
+        int avail = queued.get();
+        while (avail == done)
+            avail = queued.waitForChange(done);
+
+        /* write everything which is queued with one call */
+        int end = endEntry;
+        bool bEnd = end >= 0 && end < avail;
+        int count = (bEnd ? end : avail) - done;
+
+        if (count)
+            writeEntries(done, count);
+        done += count;
+        written.set(done);
+
+        if (bEnd)
+            return;
+    }
+}
+
+BitstreamWriter::BitstreamWriter(const char *filename)
+{
+    bFail = false;
+    memset(buf, 0, sizeof(buf));
+    memset(bufSize, 0, sizeof(bufSize));
+    memset(used, 0, sizeof(used));
+
+#if _WIN32
+    fd = _open(filename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd >= 0)
+        startWriter();
+}
+
+BitstreamWriter::~BitstreamWriter()
+{
+    for (int i = 0; i < QUEUE_DEPTH; i++)
+        X265_FREE(buf[i]);
+}
+
+void BitstreamWriter::release()
+{
+    finish();
+    if (fd >= 0)
+    {
+#if _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+    delete this;
+}
+
+uint32_t BitstreamWriter::write(const x265_nal *nal, uint32_t nalcount)
+{
+    uint32_t bytes = 0;
+
+    for (uint32_t i = 0; i < nalcount; i++)
+        bytes += nal[i].sizeBytes;
+
+    if (!bytes || isFail())
+        return bytes;
+
+    int slot = acquireSlot();
+    if (bufSize[slot] < bytes)
+    {
+        /* the slot buffers only grow, they are reused for the whole stream */
+        X265_FREE(buf[slot]);
+        buf[slot] = X265_MALLOC(uint8_t, bytes);
+        bufSize[slot] = buf[slot] ? bytes : 0;
+        if (!buf[slot])
+        {
+            x265_log(NULL, X265_LOG_ERROR, "unable to allocate bitstream write buffer\n");
+            bFail = true;
+            return bytes;
+        }
+    }
+
+    uint8_t *out = buf[slot];
+    for (uint32_t i = 0; i < nalcount; i++)
+    {
+        memcpy(out, nal[i].payload, nal[i].sizeBytes);
+        out += nal[i].sizeBytes;
+    }
+
+    used[slot] = bytes;
+    commitSlot();
+
+    return bytes;
+}
+
+void BitstreamWriter::writeEntries(int first, int count)
+{
+    if (bFail)
+        return;
+
+#if _WIN32
+    for (int i = 0; i < count; i++)
+    {
+        int slot = (first + i) % QUEUE_DEPTH;
+        const uint8_t *data = buf[slot];
+        uint32_t left = used[slot];
+        while (left)
+        {
+            int ret = _write(fd, data, left);
+            if (ret <= 0)
+            {
+                bFail = true;
+                break;
+            }
+            data += ret;
+            left -= ret;
+        }
+        if (bFail)
+            break;
+    }
+#else
+    /* gather the queued buffers into one system call */
+    struct iovec iov[QUEUE_DEPTH];
+    for (int i = 0; i < count; i++)
+    {
+        int slot = (first + i) % QUEUE_DEPTH;
+        iov[i].iov_base = buf[slot];
+        iov[i].iov_len = used[slot];
+    }
+
+    struct iovec *vec = iov;
+    int left = count;
+    while (left)
+    {
+        ssize_t ret = writev(fd, vec, left);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            bFail = true;
+            break;
+        }
+
+        /* skip the buffers which were written entirely, resume a partial one */
+        while (left && (size_t)ret >= vec->iov_len)
+        {
+            ret -= vec->iov_len;
+            vec++;
+            left--;
+        }
+
+        if (left)
+        {
+            vec->iov_base = (uint8_t*)vec->iov_base + ret;
+            vec->iov_len -= ret;
+        }
+    }
+#endif // if _WIN32
+
+    if (bFail)
+        x265_log(NULL, X265_LOG_ERROR, "failed to write bitstream file, %s\n", strerror(errno));
+}
+
+ReconWriter::ReconWriter(Output *o, int w, int h, int csp)
+    : out(o)
+    , width(w)
+    , height(h)
+    , colorSpace(csp)
+{
+    memset(pic, 0, sizeof(pic));
+    memset(planeBuf, 0, sizeof(planeBuf));
+    memset(planeBufSize, 0, sizeof(planeBufSize));
+
+    startWriter();
+}
+
+ReconWriter::~ReconWriter()
+{
+    for (int i = 0; i < QUEUE_DEPTH; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            X265_FREE(planeBuf[i][j]);
+    }
+}
+
+void ReconWriter::release()
+{
+    finish();
+    out->release();
+    delete this;
+}
+
+bool ReconWriter::writePicture(const x265_picture& p)
+{
+    int slot = acquireSlot();
+
+    /* the encoder reuses the recon picture buffers, copy the planes */
+    pic[slot] = p;
+    for (int i = 0; i < x265_cli_csps[colorSpace].planes; i++)
+    {
+        uint32_t rows = height >> x265_cli_csps[colorSpace].height[i];
+        uint32_t rowBytes = (width >> x265_cli_csps[colorSpace].width[i]) * sizeof(pixel);
+        uint32_t bytes = (rows - 1) * p.stride[i] + rowBytes;
+
+        if (planeBufSize[slot][i] < bytes)
+        {
+            X265_FREE(planeBuf[slot][i]);
+            planeBuf[slot][i] = X265_MALLOC(char, bytes);
+            planeBufSize[slot][i] = planeBuf[slot][i] ? bytes : 0;
+            if (!planeBuf[slot][i])
+            {
+                x265_log(NULL, X265_LOG_ERROR, "unable to allocate recon write buffer\n");
+                return false;
+            }
+        }
+
+        memcpy(planeBuf[slot][i], p.planes[i], bytes);
+        pic[slot].planes[i] = planeBuf[slot][i];
+    }
+
+    commitSlot();
+    return true;
+}
+
+void ReconWriter::writeEntries(int first, int count)
+{
+    for (int i = 0; i < count; i++)
+        out->writePicture(pic[(first + i) % QUEUE_DEPTH]);
+}
@@ -0,0 +1,146 @@
+/*****************************************************************************
+ * Copyright (C) 2013 x265 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@multicorewareinc.com.
+ *****************************************************************************/
+
+#ifndef X265_WRITER_H
+#define X265_WRITER_H
+
+#include "output.h"
+#include "threading.h"
+
+namespace x265 {
+// private x265 namespace
+
+/* Bounded queue of entries which a background thread writes out in order, so
+ * the CLI thread which drives the encoder does not wait for file I/O unless
+ * the queue is full. Entries are counted, entry n uses slot n % QUEUE_DEPTH,
+ * and the buffers of the slots are recycled */
+class WriterThread : public Thread
+{
+protected:
+
+    enum { QUEUE_DEPTH = 16 };
+
+    ThreadSafeInteger written; // count of entries written out by the thread
+
+    ThreadSafeInteger queued;  // count of entries queued by the CLI thread
+
+    volatile int endEntry;     // entry which ends the queue, or -1
+
+    bool bThreaded;            // false if the thread could not be started
+
+    WriterThread();
+
+    /* start the thread, the entries are written synchronously if it fails */
+    void startWriter()       { bThreaded = start(); }
+
+    virtual ~WriterThread() {}
+
+    /* block until the next entry's slot is free, returns the slot */
+    int acquireSlot();
+
+    /* the slot returned by acquireSlot() is filled, queue it */
+    void commitSlot();
+
+    /* queue the end of the stream and wait for the thread to write out all
+     * entries before it */
+    void finish();
+
+    /* write out count entries, starting with entry first */
+    virtual void writeEntries(int first, int count) = 0;
+
+    void threadMain();
+};
+
+/* Writes the Annex-B bitstream. The NAL units of each call are copied into
+ * one buffer, the thread writes all the buffers it finds queued with one
+ * gathered write */
+class BitstreamWriter : public WriterThread
+{
+protected:
+
+    int fd;
+
+    volatile bool bFail;
+
+    uint8_t *buf[QUEUE_DEPTH];
+
+    uint32_t bufSize[QUEUE_DEPTH];
+
+    uint32_t used[QUEUE_DEPTH];
+
+    void writeEntries(int first, int count);
+
+    virtual ~BitstreamWriter();
+
+public:
+
+    BitstreamWriter(const char *filename);
+
+    bool isFail() const     { return fd < 0 || bFail; }
+
+    /* queue the NAL units, returns their size in bytes */
+    uint32_t write(const x265_nal *nal, uint32_t nalcount);
+
+    /* write out the queued NAL units and close the file */
+    void release();
+};
+
+/* Writes reconstructed pictures through another Output. The planes of each
+ * picture are copied into the buffers of a queue slot, since the encoder
+ * reuses the recon pictures once x265_encoder_encode() is called again */
+class ReconWriter : public Output, public WriterThread
+{
+protected:
+
+    Output *out;
+
+    int width;
+
+    int height;
+
+    int colorSpace;
+
+    x265_picture pic[QUEUE_DEPTH];
+
+    char *planeBuf[QUEUE_DEPTH][3];
+
+    uint32_t planeBufSize[QUEUE_DEPTH][3];
+
+    void writeEntries(int first, int count);
+
+    virtual ~ReconWriter();
+
+public:
+
+    /* takes ownership of out */
+    ReconWriter(Output *out, int width, int height, int csp);
+
+    bool isFail() const     { return out->isFail(); }
+
+    void release();
+
+    bool writePicture(const x265_picture& pic);
+
+    const char *getName() const { return out->getName(); }
+};
+}
+
+#endif // ifndef X265_WRITER_H
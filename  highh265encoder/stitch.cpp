@@ -0,0 +1,338 @@
+/*****************************************************************************
+ * Copyright (C) 2013 x265 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@multicorewareinc.com.
+ *****************************************************************************/
+
+/* x265-stitch concatenates the Annex-B streams of the chunks of a parallel
+ * encode (x265 --chunk-start/--chunk-end) into one stream.
+ *
+ * Every chunk starts with an IDR picture, so no picture of a chunk references
+ * a picture of another chunk and the POC and reference picture sets of each
+ * chunk are already correct, the IDR resets them. The chunks must have been
+ * encoded with identical parameter sets, which is verified, and the parameter
+ * sets leading each chunk after the first are dropped since the decoder
+ * already holds them */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+namespace {
+
+enum
+{
+    NAL_UNIT_CODED_SLICE_IDR_W_RADL = 19,
+    NAL_UNIT_CODED_SLICE_IDR_N_LP = 20,
+    NAL_UNIT_VPS = 32,
+    NAL_UNIT_SPS = 33,
+    NAL_UNIT_PPS = 34,
+    MAX_PARAM_SETS = 16,
+    READ_SIZE = 1 << 20
+};
+
+const size_t NOT_FOUND = (size_t)-1;
+
+/* Splits an Annex-B stream into NAL units, each returned with its start code */
+class NalReader
+{
+public:
+
+    NalReader()
+    {
+        fp = NULL;
+        buf = NULL;
+        bufSize = used = pos = 0;
+        bEof = false;
+    }
+
+    ~NalReader()
+    {
+        if (fp)
+            fclose(fp);
+        free(buf);
+    }
+
+    bool open(const char *filename)
+    {
+        fp = fopen(filename, "rb");
+        return fp != NULL;
+    }
+
+    bool isFail() const { return !fp || ferror(fp); }
+
+    /* returns false at the end of the stream */
+    bool next(const uint8_t*& nal, size_t& size)
+    {
+        size_t start = findStartCode(0);
+        if (start == NOT_FOUND)
+            return false;
+
+        size_t end = findStartCode(start + 3);
+        if (end == NOT_FOUND)
+            end = used - pos;
+        else if (!buf[pos + end - 1])
+            end--; /* the zero byte of a four byte start code */
+
+        /* a four byte start code at the very start of the stream */
+        if (start && !buf[pos + start - 1])
+            start--;
+
+        nal = buf + pos + start;
+        size = end - start;
+        pos += end;
+        return true;
+    }
+
+protected:
+
+    FILE    *fp;
+    uint8_t *buf;
+    size_t   bufSize;
+    size_t   used;
+    size_t   pos;
+    bool     bEof;
+
+    /* returns the offset, relative to pos, of the first three byte start code
+     * at or after offset from, reading more of the file as needed */
+    size_t findStartCode(size_t from)
+    {
+        while (true)
+        {
+            size_t i = pos + from;
+            for (; i + 3 <= used; i++)
+            {
+                if (!buf[i] && !buf[i + 1] && buf[i + 2] == 1)
+                    return i - pos;
+            }
+
+            if (bEof)
+                return NOT_FOUND;
+
+            /* resume with the bytes which may begin a split start code */
+            from = i - pos;
+
+            /* drop the NAL units which were returned already */
+            if (pos)
+            {
+                memmove(buf, buf + pos, used - pos);
+                used -= pos;
+                pos = 0;
+            }
+            if (used + READ_SIZE > bufSize)
+            {
+                uint8_t *grown = (uint8_t*)realloc(buf, used + READ_SIZE);
+                if (!grown)
+                {
+                    bEof = true;
+                    return NOT_FOUND;
+                }
+                buf = grown;
+                bufSize = used + READ_SIZE;
+            }
+
+            size_t bytes = fread(buf + used, 1, READ_SIZE, fp);
+            used += bytes;
+            bEof = bytes < READ_SIZE;
+        }
+    }
+};
+
+struct ParamSet
+{
+    uint8_t *data;
+    size_t   size;
+};
+
+/* the NAL unit without its start code */
+const uint8_t *nalPayload(const uint8_t *nal, size_t& size)
+{
+    size_t skip = nal[2] == 1 ? 3 : 4;
+    size -= skip;
+    return nal + skip;
+}
+
+void printUsage()
+{
+    fprintf(stderr, "Syntax: x265-stitch [--repeat-headers] -o <output> <chunk> [<chunk> ...]\n");
+    fprintf(stderr, "\nConcatenates the streams of chunks encoded with x265 --chunk-start/--chunk-end\n");
+    fprintf(stderr, "   -o/--output <filename>        Stitched Annex-B stream\n");
+    fprintf(stderr, "   --repeat-headers              Keep the VPS, SPS and PPS at the start of each chunk\n");
+}
+}
+
+int main(int argc, char **argv)
+{
+    const char *outputfn = NULL;
+    bool bRepeatHeaders = false;
+    int firstChunk = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output"))
+        {
+            if (++i < argc)
+                outputfn = argv[i];
+        }
+        else if (!strcmp(argv[i], "--repeat-headers"))
+            bRepeatHeaders = true;
+        else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+        {
+            printUsage();
+            return 0;
+        }
+        else
+        {
+            firstChunk = i;
+            break;
+        }
+    }
+
+    if (!outputfn || !firstChunk)
+    {
+        printUsage();
+        return 1;
+    }
+
+    FILE *out = fopen(outputfn, "wb");
+    if (!out)
+    {
+        fprintf(stderr, "x265-stitch [error]: unable to open <%s> for writing\n", outputfn);
+        return 1;
+    }
+
+    ParamSet paramSets[MAX_PARAM_SETS];
+    int numParamSets = 0;
+    bool bError = false;
+
+    for (int c = firstChunk; c < argc && !bError; c++)
+    {
+        const char *chunkfn = argv[c];
+        bool bFirstChunk = c == firstChunk;
+        NalReader reader;
+        if (!reader.open(chunkfn))
+        {
+            fprintf(stderr, "x265-stitch [error]: unable to open chunk <%s>\n", chunkfn);
+            bError = true;
+            break;
+        }
+
+        int paramSetIdx = 0;
+        bool bLeading = true;
+        const uint8_t *nal;
+        size_t size;
+
+        while (reader.next(nal, size))
+        {
+            size_t payloadSize = size;
+            const uint8_t *payload = nalPayload(nal, payloadSize);
+            if (!payloadSize)
+                continue;
+            int type = (payload[0] >> 1) & 0x3f;
+
+            if (bLeading && type < NAL_UNIT_VPS)
+            {
+                /* the first picture of the chunk */
+                if (type != NAL_UNIT_CODED_SLICE_IDR_W_RADL && type != NAL_UNIT_CODED_SLICE_IDR_N_LP)
+                {
+                    fprintf(stderr, "x265-stitch [error]: chunk <%s> does not start with an IDR picture\n", chunkfn);
+                    bError = true;
+                    break;
+                }
+                if (!bFirstChunk && paramSetIdx != numParamSets)
+                {
+                    fprintf(stderr, "x265-stitch [error]: chunk <%s> has different parameter sets than <%s>\n",
+                            chunkfn, argv[firstChunk]);
+                    bError = true;
+                    break;
+                }
+                bLeading = false;
+            }
+            else if (bLeading && type >= NAL_UNIT_VPS && type <= NAL_UNIT_PPS)
+            {
+                if (bFirstChunk)
+                {
+                    if (numParamSets == MAX_PARAM_SETS)
+                    {
+                        fprintf(stderr, "x265-stitch [error]: too many parameter sets in chunk <%s>\n", chunkfn);
+                        bError = true;
+                        break;
+                    }
+                    ParamSet& ps = paramSets[numParamSets++];
+                    ps.data = (uint8_t*)malloc(payloadSize);
+                    if (!ps.data)
+                    {
+                        numParamSets--;
+                        bError = true;
+                        break;
+                    }
+                    memcpy(ps.data, payload, payloadSize);
+                    ps.size = payloadSize;
+                }
+                else
+                {
+                    if (paramSetIdx >= numParamSets ||
+                        paramSets[paramSetIdx].size != payloadSize ||
+                        memcmp(paramSets[paramSetIdx].data, payload, payloadSize))
+                    {
+                        fprintf(stderr, "x265-stitch [error]: chunk <%s> has different parameter sets than <%s>\n",
+                                chunkfn, argv[firstChunk]);
+                        bError = true;
+                        break;
+                    }
+                    paramSetIdx++;
+                    if (!bRepeatHeaders)
+                        continue;
+                }
+            }
+
+            if (fwrite(nal, 1, size, out) != size)
+            {
+                fprintf(stderr, "x265-stitch [error]: failed to write <%s>\n", outputfn);
+                bError = true;
+                break;
+            }
+        }
+
+        if (!bError && reader.isFail())
+        {
+            fprintf(stderr, "x265-stitch [error]: failed to read chunk <%s>\n", chunkfn);
+            bError = true;
+        }
+        else if (!bError && bLeading)
+        {
+            fprintf(stderr, "x265-stitch [error]: chunk <%s> contains no pictures\n", chunkfn);
+            bError = true;
+        }
+    }
+
+    for (int i = 0; i < numParamSets; i++)
+        free(paramSets[i].data);
+
+    if (fclose(out))
+        bError = true;
+    if (bError)
+    {
+        remove(outputfn);
+        return 1;
+    }
+
+    fprintf(stderr, "x265-stitch [info]: stitched %d chunks into <%s>\n", argc - firstChunk, outputfn);
+    return 0;
+}
@@ -36,6 +36,8 @@ using namespace x265;
 #define SMAX (1 << 12)
 #define SMIN (-1 << 12)
 
+static const char * const rgbCspStr[NUM_RGB_CSPS] = { "bgr", "bgra", "rgb" };
+
 PixelHarness::PixelHarness()
 {
     int bufsize = STRIDE * (MAX_HEIGHT + PAD_ROWS) + INCR * ITERS;
@@ -987,6 +989,134 @@ bool PixelHarness::check_planecopy_cp(planecopy_cp_t ref, planecopy_cp_t opt)
     return true;
 }
 
+bool PixelHarness::check_plane_copy_deinterleave(plane_copy_deinterleave_t ref, plane_copy_deinterleave_t opt)
+{
+    ALIGN_VAR_16(pixel, ref_u[64 * 32]);
+    ALIGN_VAR_16(pixel, ref_v[64 * 32]);
+    ALIGN_VAR_16(pixel, opt_u[64 * 32]);
+    ALIGN_VAR_16(pixel, opt_v[64 * 32]);
+
+    int j = 0;
+
+    for (int i = 0; i < ITERS; i++)
+    {
+        int index = i % TEST_CASES;
+        int width = 1 + rand() % 64;
+        int height = 1 + rand() % 32;
+
+        memset(ref_u, 0xCD, sizeof(ref_u));
+        memset(ref_v, 0xCD, sizeof(ref_v));
+        memset(opt_u, 0xCD, sizeof(opt_u));
+        memset(opt_v, 0xCD, sizeof(opt_v));
+
+        ref(ref_u, 64, ref_v, 64, pixel_test_buff[index] + j, 128, width, height);
+        opt(opt_u, 64, opt_v, 64, pixel_test_buff[index] + j, 128, width, height);
+
+        if (memcmp(ref_u, opt_u, sizeof(ref_u)) || memcmp(ref_v, opt_v, sizeof(ref_v)))
+            return false;
+
+        j += INCR;
+    }
+
+    return true;
+}
+
+bool PixelHarness::check_rgb2yuv(rgb2yuv_t ref, rgb2yuv_t opt)
+{
+    ALIGN_VAR_16(pixel, ref_y[64 * 32]);
+    ALIGN_VAR_16(pixel, ref_u[64 * 32]);
+    ALIGN_VAR_16(pixel, ref_v[64 * 32]);
+    ALIGN_VAR_16(pixel, opt_y[64 * 32]);
+    ALIGN_VAR_16(pixel, opt_u[64 * 32]);
+    ALIGN_VAR_16(pixel, opt_v[64 * 32]);
+
+    int j = 0;
+
+    for (int i = 0; i < ITERS; i++)
+    {
+        /* odd sizes exercise the scalar edges, 4 bytes per pixel covers all packings */
+        int index = i % TEST_CASES;
+        int width = 1 + rand() % 64;
+        int height = 1 + rand() % 32;
+
+        memset(ref_y, 0xCD, sizeof(ref_y));
+        memset(ref_u, 0xCD, sizeof(ref_u));
+        memset(ref_v, 0xCD, sizeof(ref_v));
+        memset(opt_y, 0xCD, sizeof(opt_y));
+        memset(opt_u, 0xCD, sizeof(opt_u));
+        memset(opt_v, 0xCD, sizeof(opt_v));
+
+        ref(ref_y, 64, ref_u, ref_v, 64, uchar_test_buff[index] + j, 256, width, height);
+        opt(opt_y, 64, opt_u, opt_v, 64, uchar_test_buff[index] + j, 256, width, height);
+
+        if (memcmp(ref_y, opt_y, sizeof(ref_y)) || memcmp(ref_u, opt_u, sizeof(ref_u)) || memcmp(ref_v, opt_v, sizeof(ref_v)))
+            return false;
+
+        j += INCR;
+    }
+
+    return true;
+}
+
+/* RBSP-like test payload, dense with zero runs and small values so every
+ * emulation prevention case (and long runs without any) is exercised */
+static void fill_nal_payload(uint8_t *buf, int size)
+{
+    int mode = rand() % 3;
+
+    for (int i = 0; i < size; i++)
+    {
+        switch (mode)
+        {
+        case 0:  buf[i] = (uint8_t)(rand() & 0xff); break;
+        case 1:  buf[i] = (rand() & 1) ? 0 : (uint8_t)(rand() % 5); break;
+        default: buf[i] = (rand() % 64) ? (uint8_t)(rand() & 0xff) : 0; break;
+        }
+    }
+}
+
+bool PixelHarness::check_nal_escape(nal_escape_t ref, nal_escape_t opt)
+{
+    const int maxSize = 1024;
+    uint8_t src[maxSize];
+    uint8_t ref_dest[maxSize * 2];
+    uint8_t opt_dest[maxSize * 2];
+
+    for (int i = 0; i < ITERS; i++)
+    {
+        int size = rand() % maxSize;
+        fill_nal_payload(src, size);
+
+        memset(ref_dest, 0xCD, sizeof(ref_dest));
+        memset(opt_dest, 0xCD, sizeof(opt_dest));
+
+        uint32_t ref_size = ref(ref_dest, src, size);
+        uint32_t opt_size = opt(opt_dest, src, size);
+
+        if (ref_size != opt_size || memcmp(ref_dest, opt_dest, sizeof(ref_dest)))
+            return false;
+    }
+
+    return true;
+}
+
+bool PixelHarness::check_nal_count_escapes(nal_count_escapes_t ref, nal_count_escapes_t opt)
+{
+    const int maxSize = 1024;
+    uint8_t src[maxSize];
+
+    for (int i = 0; i < ITERS; i++)
+    {
+        int size = rand() % maxSize;
+        fill_nal_payload(src, size);
+
+        if (ref(src, size) != opt(src, size))
+            return false;
+    }
+
+    return true;
+}
+
 bool PixelHarness::testPartition(int part, const EncoderPrimitives& ref, const EncoderPrimitives& opt)
 {
     if (opt.satd[part])
@@ -1414,6 +1544,48 @@ bool PixelHarness::testCorrectness(const EncoderPrimitives& ref, const EncoderPr
         }
     }
 
+    if (opt.plane_copy_deinterleave_c)
+    {
+        if (!check_plane_copy_deinterleave(ref.plane_copy_deinterleave_c, opt.plane_copy_deinterleave_c))
+        {
+            printf("plane_copy_deinterleave_c failed\n");
+            return false;
+        }
+    }
+
+    for (int i = 0; i < NUM_RGB_CSPS; i++)
+    {
+        for (int csp = X265_CSP_I420; csp < X265_CSP_COUNT; csp++)
+        {
+            if (opt.rgb2yuv[i][csp])
+            {
+                if (!check_rgb2yuv(ref.rgb2yuv[i][csp], opt.rgb2yuv[i][csp]))
+                {
+                    printf("rgb2yuv[%s][%s] failed\n", rgbCspStr[i], x265_source_csp_names[csp]);
+                    return false;
+                }
+            }
+        }
+    }
+
+    if (opt.nal_escape)
+    {
+        if (!check_nal_escape(ref.nal_escape, opt.nal_escape))
+        {
+            printf("nal_escape failed\n");
+            return false;
+        }
+    }
+
+    if (opt.nal_count_escapes)
+    {
+        if (!check_nal_count_escapes(ref.nal_count_escapes, opt.nal_count_escapes))
+        {
+            printf("nal_count_escapes failed\n");
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -1721,4 +1893,35 @@ void PixelHarness::measureSpeed(const EncoderPrimitives& ref, const EncoderPrimi
         HEADER0("planecopy_cp");
         REPORT_SPEEDUP(opt.planecopy_cp, ref.planecopy_cp, uchar_test_buff[0], 64, pbuf1, 64, 64, 64, 2);
     }
+
+    if (opt.plane_copy_deinterleave_c)
+    {
+        HEADER0("plane_copy_deinterleave_c");
+        REPORT_SPEEDUP(opt.plane_copy_deinterleave_c, ref.plane_copy_deinterleave_c, pbuf2, 64, pbuf3, 64, pbuf1, 128, 64, 32);
+    }
+
+    for (int i = 0; i < NUM_RGB_CSPS; i++)
+    {
+        for (int csp = X265_CSP_I420; csp < X265_CSP_COUNT; csp++)
+        {
+            if (opt.rgb2yuv[i][csp])
+            {
+                HEADER("rgb2yuv[%s][%s]", rgbCspStr[i], x265_source_csp_names[csp]);
+                REPORT_SPEEDUP(opt.rgb2yuv[i][csp], ref.rgb2yuv[i][csp], pbuf1, 64, pbuf2, pbuf3, 64, uchar_test_buff[0], 256, 64, 32);
+            }
+        }
+    }
+
+    if (opt.nal_escape)
+    {
+        // uchar_test_buff[0] is random bytes, the common case of CABAC payload
+        HEADER0("nal_escape");
+        REPORT_SPEEDUP(opt.nal_escape, ref.nal_escape, (uint8_t*)ushort_test_buff[0], uchar_test_buff[0], 4096);
+    }
+
+    if (opt.nal_count_escapes)
+    {
+        HEADER0("nal_count_escapes");
+        REPORT_SPEEDUP(opt.nal_count_escapes, ref.nal_count_escapes, uchar_test_buff[0], 4096);
+    }
 }
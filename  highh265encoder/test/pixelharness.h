@@ -69,6 +69,10 @@ protected:
     bool check_saoCuOrgE0_t(saoCuOrgE0_t ref, saoCuOrgE0_t opt);
     bool check_planecopy_sp(planecopy_sp_t ref, planecopy_sp_t opt);
     bool check_planecopy_cp(planecopy_cp_t ref, planecopy_cp_t opt);
+    bool check_plane_copy_deinterleave(plane_copy_deinterleave_t ref, plane_copy_deinterleave_t opt);
+    bool check_rgb2yuv(rgb2yuv_t ref, rgb2yuv_t opt);
+    bool check_nal_escape(nal_escape_t ref, nal_escape_t opt);
+    bool check_nal_count_escapes(nal_count_escapes_t ref, nal_count_escapes_t opt);
 public:
 
     PixelHarness();
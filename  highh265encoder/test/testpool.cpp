@@ -67,11 +67,14 @@ private:
     RowData *row;
     int      numrows;
     int      numcols;
+    int      cuWork;
     Event    complete;
 
 public:
 
-    MD5Frame(ThreadPool *pool) : WaveFront(pool), cu(0), row(0) {}
+    int64_t  finishTime;
+
+    MD5Frame(ThreadPool *pool) : WaveFront(pool), cu(0), row(0), cuWork(0), finishTime(0) {}
 
     virtual ~MD5Frame()
     {
@@ -83,19 +86,26 @@ public:
         delete[] this->row;
     }
 
-    void initialize(int cols, int rows);
+    void initialize(int cols, int rows, int work = 0);
 
     void encode();
 
+    void startEncode();
+
+    void enableEncode();
+
+    bool finishEncode();
+
     void processRow(int row);
 };
 
-void MD5Frame::initialize(int cols, int rows)
+void MD5Frame::initialize(int cols, int rows, int work)
 {
     this->cu = new CUData[rows * cols];
     this->row = new RowData[rows];
     this->numrows = rows;
     this->numcols = cols;
+    this->cuWork = work;
 
     if (!this->WaveFront::init(rows))
     {
@@ -104,15 +114,28 @@ void MD5Frame::initialize(int cols, int rows)
 }
 
 void MD5Frame::encode()
+{
+    startEncode();
+    enableEncode();
+    finishEncode();
+}
+
+void MD5Frame::startEncode()
 {
     this->JobProvider::enqueue();
 
     this->WaveFront::enqueueRow(0);
+}
 
+void MD5Frame::enableEncode()
+{
     // NOTE: When EnableRow after enqueueRow at first row, we'd better call pokeIdleThread, it will release a thread to do job
     this->WaveFront::enableRow(0);
     this->m_pool->pokeIdleThread();
+}
 
+bool MD5Frame::finishEncode()
+{
     this->complete.wait();
 
     this->JobProvider::dequeue();
@@ -127,7 +150,12 @@ void MD5Frame::encode()
     }
 
     if (ss.str().compare("da667b741a7a9d0ee862158da2dd1882"))
+    {
         std::cout << "Bad hash: " << ss.str() << std::endl;
+        return false;
+    }
+
+    return true;
 }
 
 void MD5Frame::processRow(int rownum)
@@ -162,6 +190,16 @@ void MD5Frame::processRow(int rownum)
         }
 
         hash.finalize(curCTU.digest);
+
+        // optional synthetic load, does not contribute to the digest
+        for (int i = 0; i < this->cuWork; i++)
+        {
+            unsigned char scratch[16];
+            MD5 busy;
+            busy.update(curCTU.digest, sizeof(curCTU.digest));
+            busy.finalize(scratch);
+        }
+
         PPAStopCpuEventFunc(encode_block);
 
         curRow.curCol++;
@@ -196,7 +234,199 @@ void MD5Frame::processRow(int rownum)
     // * Row completed *
 
     if (rownum == this->numrows - 1)
+    {
+        this->finishTime = x265_mdate();
         this->complete.trigger();
+    }
+}
+
+// Encode several frames concurrently through one pool. The last frame is
+// given lookahead priority and is enabled first, with a single worker thread
+// it must complete before any of the frames which were enqueued ahead of it.
+// Returns the elapsed time in microseconds, or -1 on failure
+static int64_t benchmarkPool(int numThreads, int numFrames, int work)
+{
+    ThreadPool *pool = ThreadPool::allocThreadPool(numThreads);
+    MD5Frame **frames = new MD5Frame *[numFrames];
+    bool ok = true;
+
+    for (int i = 0; i < numFrames; i++)
+    {
+        frames[i] = new MD5Frame(pool);
+        frames[i]->initialize(60, 40, work);
+    }
+
+    frames[numFrames - 1]->setPriority(JobProvider::PRIORITY_LOOKAHEAD);
+
+    int64_t start = x265_mdate();
+    for (int i = 0; i < numFrames; i++)
+    {
+        frames[i]->startEncode();
+    }
+
+    for (int i = numFrames - 1; i >= 0; i--)
+    {
+        frames[i]->enableEncode();
+    }
+
+    for (int i = 0; i < numFrames; i++)
+    {
+        ok &= frames[i]->finishEncode();
+    }
+
+    int64_t elapsed = x265_mdate() - start;
+
+    if (numThreads == 1)
+    {
+        for (int i = 0; i < numFrames - 1; i++)
+        {
+            if (frames[i]->finishTime < frames[numFrames - 1]->finishTime)
+            {
+                std::cout << "Priority inversion: frame " << i << " completed before the high priority frame" << std::endl;
+                ok = false;
+            }
+        }
+    }
+
+    for (int i = 0; i < numFrames; i++)
+    {
+        delete frames[i];
+    }
+
+    delete [] frames;
+    pool->release();
+
+    return ok ? elapsed : -1;
+}
+
+// Fair share between the clients of a pool, with a single worker thread so
+// the order in which frames complete is deterministic. A small frame must
+// complete before a much larger frame of another client which was enqueued
+// and enabled ahead of it, and of two equal frames the one of the client
+// with the larger weight must complete first
+static bool testClientShares()
+{
+    static const int work[2][2] = { { 100, 5 }, { 20, 20 } };
+    static const int weight[2][2] = { { 1, 1 }, { 1, 4 } };
+    bool ok = true;
+
+    ThreadPool *pool = ThreadPool::createThreadPool(1);
+    if (!pool)
+        return false;
+
+    for (int test = 0; test < 2; test++)
+    {
+        ThreadPool *client[2];
+        MD5Frame *frame[2];
+        for (int i = 0; i < 2; i++)
+        {
+            client[i] = pool->attachClient(weight[test][i]);
+            frame[i] = new MD5Frame(client[i]);
+            frame[i]->initialize(60, 40, work[test][i]);
+        }
+
+        for (int i = 0; i < 2; i++)
+            frame[i]->startEncode();
+
+        for (int i = 0; i < 2; i++)
+            frame[i]->enableEncode();
+
+        for (int i = 0; i < 2; i++)
+            ok &= frame[i]->finishEncode();
+
+        if (frame[1]->finishTime > frame[0]->finishTime)
+        {
+            std::cout << "Client share " << test << ": the second client's frame completed last" << std::endl;
+            ok = false;
+        }
+
+        for (int i = 0; i < 2; i++)
+        {
+            delete frame[i];
+            client[i]->release();
+        }
+    }
+
+    pool->release();
+    return ok;
+}
+
+// One encoder instance of the multi-instance benchmark, encodes its frames
+// one after the other from its own thread
+class InstanceThread : public Thread
+{
+public:
+
+    ThreadPool *pool;
+    int         numFrames;
+    int         work;
+    int64_t     elapsed;
+    bool        ok;
+
+    InstanceThread() : pool(0), numFrames(0), work(0), elapsed(0), ok(true) {}
+
+    void threadMain()
+    {
+        int64_t start = x265_mdate();
+        for (int i = 0; i < numFrames; i++)
+        {
+            MD5Frame frame(pool);
+            frame.initialize(60, 40, work);
+            frame.encode();
+            ok &= frame.finishTime > 0;
+        }
+
+        elapsed = x265_mdate() - start;
+    }
+};
+
+// Encode one large and several small streams concurrently, like the rungs of
+// an encoding ladder, either as clients of one shared pool or each with a
+// pool of its own. Reports the time each instance took to complete
+static bool benchmarkInstances(int numInstances, bool bShared)
+{
+    ThreadPool *shared = bShared ? ThreadPool::createThreadPool(0) : NULL;
+    if (bShared && !shared)
+        return false;
+
+    InstanceThread *inst = new InstanceThread[numInstances];
+    bool ok = true;
+
+    int64_t start = x265_mdate();
+    for (int i = 0; i < numInstances; i++)
+    {
+        inst[i].pool = bShared ? shared->attachClient() : ThreadPool::createThreadPool(0);
+        inst[i].numFrames = i ? 8 : 4;
+        inst[i].work = i ? 5 : 100;
+        ok &= inst[i].pool && inst[i].start();
+    }
+
+    int64_t smallSum = 0;
+    for (int i = 0; i < numInstances; i++)
+    {
+        inst[i].stop();
+        ok &= inst[i].ok;
+        if (i)
+            smallSum += inst[i].elapsed;
+    }
+
+    int64_t total = x265_mdate() - start;
+
+    std::cout << (bShared ? "shared pool: " : "own pools:   ") << numInstances << " instances " << total / 1000
+              << "ms, large " << inst[0].elapsed / 1000 << "ms, small (avg) "
+              << smallSum / X265_MAX(numInstances - 1, 1) / 1000 << "ms" << std::endl;
+
+    for (int i = 0; i < numInstances; i++)
+    {
+        if (inst[i].pool)
+            inst[i].pool->release();
+    }
+
+    delete [] inst;
+    if (shared)
+        shared->release();
+
+    return ok;
 }
 
 int main(int, char **)
@@ -234,5 +464,30 @@ int main(int, char **)
     }
     pool->release();
 
+    // scaling benchmark: four concurrent frames with a synthetic CTU load
+    int64_t base = 0;
+    int maxThreads = X265_MAX(getCpuCount(), 8);
+    for (int threads = 1; threads <= maxThreads; threads <<= 1)
+    {
+        int64_t elapsed = benchmarkPool(threads, 4, 50);
+        if (elapsed < 0)
+            return 1;
+        if (threads == 1)
+            base = elapsed;
+
+        std::cout << "threads " << threads << ": " << elapsed / 1000 << "ms, speedup "
+                  << (double)base / X265_MAX(elapsed, 1) << std::endl;
+    }
+
+    if (!testClientShares())
+        return 1;
+
+    // multi-instance benchmark
+    for (int instances = 2; instances <= 8; instances <<= 1)
+    {
+        if (!benchmarkInstances(instances, true) || !benchmarkInstances(instances, false))
+            return 1;
+    }
+
     return 0;
 }
@@ -27,6 +27,7 @@
 
 #include "input/input.h"
 #include "output/output.h"
+#include "output/writer.h"
 #include "filters/filters.h"
 #include "common.h"
 #include "param.h"
@@ -46,7 +47,6 @@
 
 #include <string>
 #include <ostream>
-#include <fstream>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -65,9 +65,12 @@ static const struct option long_options[] =
     { "asm",            required_argument, NULL, 0 },
     { "no-asm",               no_argument, NULL, 0 },
     { "threads",        required_argument, NULL, 0 },
+    { "numa-pools",     required_argument, NULL, 0 },
     { "preset",         required_argument, NULL, 'p' },
     { "tune",           required_argument, NULL, 't' },
     { "frame-threads",  required_argument, NULL, 'F' },
+    { "ctu-ref-sync",         no_argument, NULL, 0 },
+    { "no-ctu-ref-sync",      no_argument, NULL, 0 },
     { "log-level",      required_argument, NULL, 0 },
     { "csv",            required_argument, NULL, 0 },
     { "y4m",                  no_argument, NULL, 0 },
@@ -81,17 +84,37 @@ static const struct option long_options[] =
     { "no-interlace",         no_argument, NULL, 0 },
     { "fps",            required_argument, NULL, 0 },
     { "seek",           required_argument, NULL, 0 },
+    { "input-prefetch", required_argument, NULL, 0 },
+    { "input-mmap",           no_argument, NULL, 0 },
+    { "no-input-mmap",        no_argument, NULL, 0 },
     { "frame-skip",     required_argument, NULL, 0 },
     { "frames",         required_argument, NULL, 'f' },
+    { "chunk-start",    required_argument, NULL, 0 },
+    { "chunk-end",      required_argument, NULL, 0 },
     { "recon",          required_argument, NULL, 'r' },
     { "recon-depth",    required_argument, NULL, 0 },
     { "no-wpp",               no_argument, NULL, 0 },
     { "wpp",                  no_argument, NULL, 0 },
+    { "slices",         required_argument, NULL, 0 },
+    { "tile-columns",   required_argument, NULL, 0 },
+    { "tile-rows",      required_argument, NULL, 0 },
+    { "tile-column-widths", required_argument, NULL, 0 },
+    { "tile-row-heights", required_argument, NULL, 0 },
+    { "no-loop-filter-across-tiles", no_argument, NULL, 0 },
+    { "loop-filter-across-tiles", no_argument, NULL, 0 },
     { "ctu",            required_argument, NULL, 's' },
     { "tu-intra-depth", required_argument, NULL, 0 },
     { "tu-inter-depth", required_argument, NULL, 0 },
     { "me",             required_argument, NULL, 0 },
     { "subme",          required_argument, NULL, 'm' },
+    { "hpel-cache",           no_argument, NULL, 0 },
+    { "no-hpel-cache",        no_argument, NULL, 0 },
+    { "lowres-mvc",           no_argument, NULL, 0 },
+    { "no-lowres-mvc",        no_argument, NULL, 0 },
+    { "ref-early-exit",       no_argument, NULL, 0 },
+    { "no-ref-early-exit",    no_argument, NULL, 0 },
+    { "adaptive-merange",     no_argument, NULL, 0 },
+    { "no-adaptive-merange",  no_argument, NULL, 0 },
     { "merange",        required_argument, NULL, 0 },
     { "max-merge",      required_argument, NULL, 0 },
     { "rdpenalty",      required_argument, NULL, 0 },
@@ -132,6 +155,7 @@ static const struct option long_options[] =
     { "vbv-maxrate",    required_argument, NULL, 0 },
     { "vbv-bufsize",    required_argument, NULL, 0 },
     { "vbv-init",       required_argument, NULL, 0 },
+    { "vbv-end",        required_argument, NULL, 0 },
     { "bitrate",        required_argument, NULL, 0 },
     { "qp",             required_argument, NULL, 'q' },
     { "aq-mode",        required_argument, NULL, 0 },
@@ -151,6 +175,7 @@ static const struct option long_options[] =
     { "ssim",                 no_argument, NULL, 0 },
     { "no-psnr",              no_argument, NULL, 0 },
     { "psnr",                 no_argument, NULL, 0 },
+    { "metrics-interval", required_argument, NULL, 0 },
     { "hash",           required_argument, NULL, 0 },
     { "no-strong-intra-smoothing", no_argument, NULL, 0 },
     { "strong-intra-smoothing",    no_argument, NULL, 0 },
@@ -185,12 +210,14 @@ struct CLIOptions
 {
     Input*  input;
     Output* recon;
-    std::fstream bitstreamFile;
+    BitstreamWriter* bitstream;
     bool bProgress;
     bool bForceY4m;
 
     uint32_t seek;              // number of frames to skip from the beginning
     uint32_t framesToBeEncoded; // number of frames to encode
+    int  inputPrefetch;         // frames read ahead of the encoder from a mapped input file
+    bool bInputMmap;
     uint64_t totalbytes;
 
     bool dither;
@@ -206,7 +233,10 @@ struct CLIOptions
     {
         input = NULL;
         recon = NULL;
+        bitstream = NULL;
         framesToBeEncoded = seek = 0;
+        inputPrefetch = 5;
+        bInputMmap = true;
         totalbytes = 0;
         bProgress = true;
         bForceY4m = false;
@@ -231,17 +261,15 @@ void CLIOptions::destroy()
     if (recon)
         recon->release();
     recon = NULL;
+    if (bitstream)
+        bitstream->release();
+    bitstream = NULL;
 }
 
 void CLIOptions::writeNALs(const x265_nal* nal, uint32_t nalcount)
 {
     PPAScopeEvent(bitstream_write);
-    for (uint32_t i = 0; i < nalcount; i++)
-    {
-        bitstreamFile.write((const char*)nal->payload, nal->sizeBytes);
-        totalbytes += nal->sizeBytes;
-        nal++;
-    }
+    totalbytes += bitstream->write(nal, nalcount);
 }
 
 void CLIOptions::printStatus(uint32_t frameNum, x265_param *param)
@@ -293,7 +321,9 @@ void CLIOptions::showHelp(x265_param *param)
     H0("-V/--version                     Show version info and exit\n");
     H0("   --[no-]asm <bool|int|string>  Override CPU detection. Default: auto\n");
     H0("   --threads <integer>           Number of threads for thread pool (0: detect CPU core count, default)\n");
+    H0("   --numa-pools <integer>        Split the thread pool into per NUMA node worker groups. Default %d\n", param->numaPools);
     H0("-F/--frame-threads <integer>     Number of concurrently encoded frames. 0: auto-determined by core count\n");
+    H0("   --[no-]ctu-ref-sync           Track reference frame progress per CTU, clamps motion search to the right. Default %s\n", OPT(param->bEnableCtuRefSync));
     H0("   --log-level <string>          Logging level: none error warning info debug full. Default %s\n", logLevelNames[param->logLevel+1]);
     H0("   --csv <filename>              Comma separated log file, log level >= 3 frame log, else one line per run\n");
     H0("   --no-progress                 Disable CLI progress reports\n");
@@ -304,10 +334,14 @@ void CLIOptions::showHelp(x265_param *param)
     H0("   --input-depth <integer>       Bit-depth of input file. Default 8\n");
     H0("   --dither                      Enable dither if downscaling to 8 bit pixels. Default disabled\n");
     H0("   --input-res WxH               Source picture size [w x h], auto-detected if Y4M\n");
-    H0("   --input-csp <string>          Source color space: i420 or i444, auto-detected if Y4M. Default: i420\n");
+    H0("   --input-csp <string>          Source color space: i420, i444 or nv12, auto-detected if Y4M. Default: i420\n");
     H0("   --fps <float|rational>        Source frame rate (float or num/denom), auto-detected if Y4M\n");
     H0("   --[no-]interlace <bff|tff>    Indicate input pictures are interlace fields in temporal order. Default progressive\n");
     H0("   --seek <integer>              First frame to encode\n");
+    H0("   --chunk-start <integer>       First frame of a chunk of a parallel encode, see x265-stitch\n");
+    H0("   --chunk-end <integer>         Last frame of a chunk of a parallel encode. Default last frame of the input\n");
+    H0("   --[no-]input-mmap             Read input files in place from a memory mapping. Default %s\n", OPT(true));
+    H0("   --input-prefetch <integer>    Frames to read ahead of the encoder from a memory mapped input. Default 5\n");
     H0("\nPresets:\n");
     H0("-f/--frames <integer>            Maximum number of frames to encode. Default all\n");
     H0("-p/--preset <string>             Trade off performance for compression efficiency. Default medium\n");
@@ -317,15 +351,26 @@ void CLIOptions::showHelp(x265_param *param)
     H0("\nQuality reporting metrics:\n");
     H0("   --[no-]ssim                   Enable reporting SSIM metric scores. Default %s\n", OPT(param->bEnableSsim));
     H0("   --[no-]psnr                   Enable reporting PSNR metric scores. Default %s\n", OPT(param->bEnablePsnr));
+    H0("   --metrics-interval <integer>  Measure PSNR and SSIM only on frames whose POC is a multiple of N. Default %d\n", param->metricsInterval);
     H0("\nQuad-Tree analysis:\n");
     H0("   --[no-]wpp                    Enable Wavefront Parallel Processing. Default %s\n", OPT(param->bEnableWavefront));
+    H0("   --slices <integer>            Number of slices per picture, each a whole number of CU rows. Default %d\n", param->maxSlices);
+    H0("   --tile-columns <integer>      Number of uniformly spaced tile columns. Default %d\n", param->tileColumns);
+    H0("   --tile-rows <integer>         Number of uniformly spaced tile rows. Default %d\n", param->tileRows);
+    H0("   --tile-column-widths <list>   Comma separated widths in CUs of all but the last tile column\n");
+    H0("   --tile-row-heights <list>     Comma separated heights in CUs of all but the last tile row\n");
+    H0("   --[no-]loop-filter-across-tiles Deblock across tile boundaries, SAO requires it. Default %s\n", OPT(param->bLoopFilterAcrossTiles));
     H0("-s/--ctu <64|32|16>              Maximum CU size (default: 64x64). Default %d\n", param->maxCUSize);
     H0("   --tu-intra-depth <integer>    Max TU recursive depth for intra CUs. Default %d\n", param->tuQTMaxIntraDepth);
     H0("   --tu-inter-depth <integer>    Max TU recursive depth for inter CUs. Default %d\n", param->tuQTMaxInterDepth);
     H0("\nTemporal / motion search options:\n");
     H0("   --me <string>                 Motion search method dia hex umh star full. Default %d\n", param->searchMethod);
     H0("-m/--subme <integer>             Amount of subpel refinement to perform (0:least .. 7:most). Default %d \n", param->subpelRefine);
+    H0("   --[no-]hpel-cache             Cache half-pel interpolated planes of reference pictures. Default %s\n", OPT(param->bEnableHpelCache));
+    H0("   --[no-]lowres-mvc             Use lookahead motion vectors as motion search candidates. Default %s\n", OPT(param->bEnableLowresMvc));
+    H0("   --[no-]ref-early-exit         Skip subpel refinement of references far worse than the best. Default %s\n", OPT(param->bEnableRefEarlyExit));
     H0("   --merange <integer>           Motion search range. Default %d\n", param->searchRange);
+    H0("   --[no-]adaptive-merange       Shrink the search range of each CTU to the lookahead motion. Default %s\n", OPT(param->bEnableAdaptiveMeRange));
     H0("   --[no-]rect                   Enable rectangular motion partitions Nx2N and 2NxN. Default %s\n", OPT(param->bEnableRectInter));
     H0("   --[no-]amp                    Enable asymmetric motion partitions, requires --rect. Default %s\n", OPT(param->bEnableAMP));
     H0("   --max-merge <1..5>            Maximum number of merge candidates. Default %d\n", param->maxNumMergeCand);
@@ -359,6 +404,7 @@ void CLIOptions::showHelp(x265_param *param)
     H0("   --vbv-maxrate <integer>       Max local bitrate (kbit/s). Default %d\n", param->rc.vbvMaxBitrate);
     H0("   --vbv-bufsize <integer>       Set size of the VBV buffer (kbit). Default %d\n", param->rc.vbvBufferSize);
     H0("   --vbv-init <float>            Initial VBV buffer occupancy (fraction of bufsize or in kbits). Default %f\n", param->rc.vbvBufferInit);
+    H0("   --vbv-end <float>             Final VBV buffer occupancy (fraction of bufsize or in kbits). Default %f, chunks use vbv-init\n", param->rc.vbvBufferEnd);
     H0("-q/--qp <integer>                Base QP for CQP mode. Default %d\n", param->rc.qp);
     H0("   --aq-mode <integer>           Mode for Adaptive Quantization - 0:none 1:uniform AQ 2:auto variance. Default %d\n", param->rc.aqMode);
     H0("   --aq-strength <float>         Reduces blocking and blurring in flat and textured areas.(0 to 3.0). Default %f\n", param->rc.aqStrength);
@@ -414,6 +460,8 @@ bool CLIOptions::parse(int argc, char **argv, x265_param* param)
     const char *bitstreamfn = NULL;
     const char *preset = "medium";
     const char *tune = "ssim";
+    int chunkStart = -1;
+    int chunkEnd = -1;
 
     if (argc <= 1)
     {
@@ -495,6 +543,11 @@ bool CLIOptions::parse(int argc, char **argv, x265_param* param)
             if (0) ;
             OPT2("frame-skip", "seek") this->seek = (uint32_t)x265_atoi(optarg, bError);
             OPT("frames") this->framesToBeEncoded = (uint32_t)x265_atoi(optarg, bError);
+            OPT("chunk-start") chunkStart = x265_atoi(optarg, bError);
+            OPT("chunk-end") chunkEnd = x265_atoi(optarg, bError);
+            OPT("input-prefetch") this->inputPrefetch = x265_atoi(optarg, bError);
+            OPT("input-mmap") this->bInputMmap = true;
+            OPT("no-input-mmap") this->bInputMmap = false;
             OPT("no-progress") this->bProgress = false;
             OPT("output") bitstreamfn = optarg;
             OPT("input") inputfn = optarg;
@@ -538,6 +591,27 @@ bool CLIOptions::parse(int argc, char **argv, x265_param* param)
         return true;
     }
 
+    /* A chunk is a closed part of the stream, the encoder starts it with an
+     * IDR picture, so chunks encoded in parallel can be concatenated */
+    bool bChunk = chunkStart >= 0 || chunkEnd >= 0;
+    if (bChunk)
+    {
+        if (seek || framesToBeEncoded)
+        {
+            x265_log(param, X265_LOG_ERROR, "--chunk-start and --chunk-end can not be combined with --seek or --frames\n");
+            return true;
+        }
+        chunkStart = X265_MAX(chunkStart, 0);
+        if (chunkEnd >= 0 && chunkEnd < chunkStart)
+        {
+            x265_log(param, X265_LOG_ERROR, "chunk end %d is before chunk start %d\n", chunkEnd, chunkStart);
+            return true;
+        }
+        seek = chunkStart;
+        if (chunkEnd >= 0)
+            framesToBeEncoded = chunkEnd - chunkStart + 1;
+    }
+
 #if HIGH_BIT_DEPTH
     if (param->internalBitDepth != 10)
     {
@@ -563,6 +637,8 @@ bool CLIOptions::parse(int argc, char **argv, x265_param* param)
     info.sarWidth = param->vui.sarWidth;
     info.sarHeight = param->vui.sarHeight;
     info.skipFrames = seek;
+    info.prefetchFrames = X265_MAX(inputPrefetch, 0);
+    info.bMemoryMap = bInputMmap;
     info.frameCount = 0;
     getParamAspectRatio(param, info.sarWidth, info.sarHeight);
 
@@ -572,9 +648,9 @@ bool CLIOptions::parse(int argc, char **argv, x265_param* param)
         x265_log(param, X265_LOG_ERROR, "unable to open input file <%s>\n", inputfn);
         return true;
     }
-    if (info.csp != X265_CSP_I420 && info.csp != X265_CSP_I444)
+    if (info.csp != X265_CSP_I420 && info.csp != X265_CSP_I444 && info.csp != X265_CSP_NV12)
     {
-        x265_log(param, X265_LOG_ERROR, "Only i420 and i444 color spaces are supported in this build\n");
+        x265_log(param, X265_LOG_ERROR, "Only i420, i444 and nv12 color spaces are supported in this build\n");
         return true;
     }
     if (info.depth < 8 || info.depth > 16)
@@ -586,7 +662,7 @@ bool CLIOptions::parse(int argc, char **argv, x265_param* param)
     /* Unconditionally accept height/width/csp from file info */
     param->sourceWidth = info.width;
     param->sourceHeight = info.height;
-    param->internalCsp = info.csp;
+    param->internalCsp = info.csp == X265_CSP_NV12 ? X265_CSP_I420 : info.csp;
 
     /* Accept fps and sar from file info if not specified by user */
     if (param->fpsDenom == 0 || param->fpsNum == 0)
@@ -599,6 +675,13 @@ bool CLIOptions::parse(int argc, char **argv, x265_param* param)
 
     if (this->framesToBeEncoded == 0 && info.frameCount > (int)seek)
         this->framesToBeEncoded = info.frameCount - seek;
+    else if (info.frameCount > (int)seek)
+        this->framesToBeEncoded = X265_MIN(this->framesToBeEncoded, (uint32_t)info.frameCount - seek);
+    param->totalFrames = this->framesToBeEncoded;
+
+    /* hand the VBV over to the next chunk, which assumes the initial fill */
+    if (bChunk && !param->rc.vbvBufferEnd)
+        param->rc.vbvBufferEnd = param->rc.vbvBufferInit;
     if (param->logLevel >= X265_LOG_INFO)
     {
         char buf[128];
@@ -633,13 +716,17 @@ bool CLIOptions::parse(int argc, char **argv, x265_param* param)
             this->recon = 0;
         }
         else
+        {
+            /* write the pictures from a background thread */
+            this->recon = new ReconWriter(this->recon, param->sourceWidth, param->sourceHeight, param->internalCsp);
             fprintf(stderr, "%s  [info]: reconstructed images %dx%d fps %d/%d %s\n", this->recon->getName(),
                     param->sourceWidth, param->sourceHeight, param->fpsNum, param->fpsDenom,
                     x265_source_csp_names[param->internalCsp]);
+        }
     }
 
-    this->bitstreamFile.open(bitstreamfn, std::fstream::binary | std::fstream::out);
-    if (!this->bitstreamFile)
+    this->bitstream = new BitstreamWriter(bitstreamfn);
+    if (this->bitstream->isFail())
     {
         x265_log(NULL, X265_LOG_ERROR, "failed to open bitstream file <%s> for writing\n", bitstreamfn);
         return true;
@@ -775,7 +862,8 @@ fail:
     if (param->csvfn && !b_ctrl_c)
         x265_encoder_log(encoder, argc, argv);
     x265_encoder_close(encoder);
-    cliopt.bitstreamFile.close();
+    cliopt.bitstream->release();
+    cliopt.bitstream = NULL;
 
     if (b_ctrl_c)
         fprintf(stderr, "aborted at input frame %d, output frame %d\n",
@@ -35,6 +35,10 @@ extern "C" {
  *      opaque handler for encoder */
 typedef struct x265_encoder x265_encoder;
 
+/* x265_thread_pool:
+ *      opaque handler for a thread pool which may be shared by encoders */
+typedef struct x265_thread_pool x265_thread_pool;
+
 /* Application developers planning to link against a shared library version of
  * libx265 from a Microsoft Visual Studio or similar development environment
  * will need to define X265_API_IMPORTS before including this header.
@@ -116,8 +120,12 @@ typedef struct x265_picture
     int     poc;
 
     /* Must be specified on input pictures: X265_CSP_I420 or other. It must
-     * match the internal color space of the encoder. x265_picture_init() will
-     * initialize this value to the internal color space */
+     * match the internal color space of the encoder, or be X265_CSP_NV12 (for
+     * an i420 encoder), X265_CSP_NV16 (for i422) or one of the 8bit packed RGB
+     * color spaces, which are converted on input. Semi-planar pictures carry
+     * the interleaved u+v samples in planes[1], packed RGB pictures use only
+     * planes[0]. x265_picture_init() will initialize this value to the internal
+     * color space */
     int     colorSpace;
 
     /* presentation time stamp: user-specified, returned on output */
@@ -131,6 +139,21 @@ typedef struct x265_picture
      * output */
     void*   userData;
 
+    /* Zero-copy input buffer, set along with planes, stride and bitDepth by
+     * x265_picture_alloc_planes(). When non-NULL on input, the encoder takes
+     * ownership of the buffer and encodes directly from its planes, extending
+     * the picture into its margins in place, instead of copying the pixels.
+     * The pixels must not be modified until the buffer is released. Ignored
+     * on output */
+    void*   planesBuffer;
+
+    /* Called with planesBuffer and userData once the encoder no longer
+     * references a zero-copy input buffer, from within x265_encoder_encode()
+     * or x265_encoder_close(). The buffer may then be reused for another
+     * input picture or freed with x265_picture_free_planes(). If NULL, the
+     * encoder frees the buffer itself */
+    void    (*releasePlanes)(void *planesBuffer, void *userData);
+
     /* new data members to this structure must be added to the end so that
      * users of x265_picture_alloc/free() can be assured of future safety */
 } x265_picture;
@@ -202,6 +225,9 @@ typedef enum
 
 #define X265_BFRAME_MAX         16
 
+#define X265_MAX_TILE_COLUMNS   20
+#define X265_MAX_TILE_ROWS      22
+
 #define X265_TYPE_AUTO          0x0000  /* Let x265 choose the right type */
 #define X265_TYPE_IDR           0x0001
 #define X265_TYPE_I             0x0002
@@ -224,12 +250,12 @@ typedef enum
 #define X265_CSP_I444           3  /* yuv 4:4:4 planar */
 #define X265_CSP_COUNT          4  /* Number of supported internal color spaces */
 
-/* These color spaces will eventually be supported as input pictures. The pictures will
- * be converted to the appropriate planar color spaces at ingest */
+/* Semi-planar input pictures, converted to the planar internal color space at ingest */
 #define X265_CSP_NV12           4  /* yuv 4:2:0, with one y plane and one packed u+v */
 #define X265_CSP_NV16           5  /* yuv 4:2:2, with one y plane and one packed u+v */
 
-/* Interleaved color-spaces may eventually be supported as input pictures */
+/* Packed 8bit RGB input pictures, converted to the internal color space at ingest
+ * (BT.601 limited range), subsampled chroma is taken from the averaged RGB */
 #define X265_CSP_BGR            6  /* packed bgr 24bits   */
 #define X265_CSP_BGRA           7  /* packed bgr 32bits   */
 #define X265_CSP_RGB            8  /* packed rgb 24bits   */
@@ -278,6 +304,10 @@ typedef struct x265_stats
     uint64_t  accBits;              /* total bits output thus far */
 
     /* new statistic member variables must be added below this line */
+    double    vbvRestartWaitTime;   /* wall time VBV row restarts spent waiting for busy rows to stop */
+    double    poolIdleWaitTime;     /* wall time spent waiting for all thread pool workers to go idle */
+    double    poolFlushWaitTime;    /* wall time spent waiting for thread pool job provider flushes */
+    uint32_t  metricPictureCount;   /* number of output pictures with measured PSNR and SSIM */
 } x265_stats;
 
 /* String values accepted by x265_param_parse() (and CLI) for various parameters */
@@ -314,11 +344,62 @@ typedef struct x265_param
      * less than 1% compression efficiency loss */
     int       bEnableWavefront;
 
+    /* Number of slices per picture. The picture is split into this many
+     * independent slices of whole CU rows, each coded into its own NAL unit.
+     * CU analysis does not predict across slice boundaries, and the entropy
+     * coding of each slice is a separate job for the thread pool. At most 64
+     * slices are allowed, values greater than the number of CU rows are
+     * clamped. Default 1 */
+    int       maxSlices;
+
+    /* Number of tile columns and tile rows per picture. Tiles are rectangular
+     * regions of CUs which are coded independently of each other, so all the
+     * tiles of a picture are compressed in parallel by the thread pool while
+     * the CU rows within a tile are coded in order; WPP entropy sync is not
+     * used with tiles, as the Main profile forbids it. Tile columns must be
+     * at least 256 luma samples wide and tile rows at least 64 luma samples
+     * high, the encoder reduces the counts as needed. With tiles, each slice
+     * is made of whole tile rows. Default 1 (no tiles) */
+    int       tileColumns;
+    int       tileRows;
+
+    /* Explicit tile column widths and tile row heights in CUs, for all but
+     * the last column and row which cover the remainder of the picture. When
+     * the first entry is 0 the tiles are spaced uniformly */
+    int       tileColumnWidth[X265_MAX_TILE_COLUMNS];
+    int       tileRowHeight[X265_MAX_TILE_ROWS];
+
+    /* Enable the deblocking filter across tile boundaries. When disabled, SAO
+     * is also disabled since it would cross tile boundaries. Default enabled */
+    int       bLoopFilterAcrossTiles;
+
     /* Number of threads to allocate for the process global thread pool, if no
      * thread pool has yet been created. 0 implies auto-detection. By default
      * x265 will try to allocate one worker thread per CPU core */
     int       poolNumThreads;
 
+    /* Number of worker groups the process global thread pool is split into,
+     * one per NUMA node. Each frame encoder and its CU row jobs are serviced
+     * by a single group, and the picture buffers of each frame are migrated
+     * to the node which encodes it. When the system has at least this many
+     * NUMA nodes the groups are bound to the CPUs of their node, else the
+     * groups are formed without any CPU affinity. Like poolNumThreads, this
+     * only has an effect if no thread pool has yet been created. 0 or 1
+     * implies a single group. Default is 0 */
+    int       numaPools;
+
+    /* Thread pool to run the encoder's jobs on, created by
+     * x265_thread_pool_alloc(). NULL uses the process global thread pool,
+     * sized by poolNumThreads and numaPools. Default NULL */
+    x265_thread_pool *threadPool;
+
+    /* Share of the thread pool's worker time the encoder receives when other
+     * encoders using the same pool also have work queued, relative to their
+     * poolWeight. The encoder which has received the least worker time for
+     * its weight is serviced first, so one large encode cannot starve the
+     * smaller encodes of a ladder. Range 1 to 256, default 1 */
+    int       poolWeight;
+
     /* Number of concurrently encoded frames, 0 implies auto-detection. By
      * default x265 will use a number of frame threads emperically determined to
      * be optimal for your CPU core count, between 2 and 6.  Using more than one
@@ -332,6 +413,14 @@ typedef struct x265_param
      * is generally limited by the the number of CU rows */
     int       frameNumThreads;
 
+    /* When frame threads are in use, let motion search of a CU row begin as
+     * soon as the reference frames have reconstructed, filtered and extended
+     * the CTUs it may reference, instead of waiting for whole CU rows. Motion
+     * search to the right is clamped to the search range like motion search
+     * in the down direction, so it does change encode behavior. The output is
+     * still deterministic. Default disabled */
+    int       bEnableCtuRefSync;
+
     /* The level of logging detail emitted by the encoder. X265_LOG_NONE to
      * X265_LOG_FULL, default is X265_LOG_INFO */
     int       logLevel;
@@ -342,6 +431,11 @@ typedef struct x265_param
     /* Enable the measurement and reporting of SSIM. Default is disabled */
     int       bEnableSsim;
 
+    /* Measure PSNR and SSIM only on frames whose POC is a multiple of this
+     * interval, the reported means are averaged over the measured frames.
+     * Decoded picture hashes are always computed for every frame. Default 1 */
+    int       metricsInterval;
+
     /* filename of CSV log. If logLevel is X265_LOG_DEBUG, the encoder will emit
      * per-slice statistics to this log file in encode order. Otherwise the
      * encoder will emit per-stream statistics into the log file when
@@ -372,6 +466,10 @@ typedef struct x265_param
     uint32_t  fpsNum;
     uint32_t  fpsDenom;
 
+    /* Number of pictures which will be passed to the encoder, 0 if it is not
+     * known. Only used by rc.vbvBufferEnd. Default 0 */
+    int       totalFrames;
+
     /* Width (in pixels) of the source pictures. If this width is not an even
      * multiple of 4, the encoder will pad the pictures internally to meet this
      * minimum requirement. All valid HEVC widths are supported */
@@ -396,6 +494,23 @@ typedef struct x265_param
      * NAL at the start of every access unit. Default false */
     int       bEnableAccessUnitDelimiters;
 
+    /* Low latency output. When set, the NAL units of encoded pictures are not
+     * returned by x265_encoder_encode() but passed to this function as soon
+     * as they are written, in decode order: the leading NAL units and each
+     * slice NAL unit of a picture once that slice is entropy coded, then the
+     * trailing SEI. With a thread pool and WPP (and SAO either disabled or
+     * CTU based) each slice is entropy coded as soon as its CU rows are
+     * reconstructed, while the rows below are still being compressed, so
+     * pictures split into many slices are output a few CU rows after their
+     * rows are encoded. The function is called by the frame encoder threads,
+     * never concurrently. The payloads are only valid during the call.
+     * x265_encoder_encode() still returns the output pictures, with no NAL
+     * units. Default NULL */
+    void    (*nalOutput)(void *opaque, const x265_nal *nals, uint32_t numNals);
+
+    /* Opaque pointer passed to nalOutput */
+    void*     nalOutputOpaque;
+
     /*== Coding Unit (CU) definitions ==*/
 
     /* Maxiumum CU width and height in pixels.  The size must be 64, 32, or 16.
@@ -502,8 +617,12 @@ typedef struct x265_param
      * (methods) are sorted in increasing complexity, with diamond being the
      * simplest and fastest and full being the slowest.  DIA, HEX, and UMH were
      * adapted from x264 directly. STAR is an adaption of the HEVC reference
-     * encoder's three step search, while full is a naive exhaustive search. The
-     * default is the star search, it has a good balance of performance and
+     * encoder's three step search, while full is an exhaustive search. It
+     * skips the candidates which a lower bound of their SAD, taken from a
+     * summed area table of each reference picture, rules out. The tables are
+     * allocated when the encoder is opened with the full search, when it is
+     * only selected by x265_encoder_reconfig() every candidate is measured.
+     * The default is the star search, it has a good balance of performance and
      * compression efficiecy */
     int       searchMethod;
 
@@ -511,6 +630,30 @@ typedef struct x265_param
      * effort performed during subpel refine. Default is 5 */
     int       subpelRefine;
 
+    /* Enable a cache of the three half-pel interpolated luma planes of each
+     * reconstructed picture, filtered a CTU row at a time as the picture is
+     * reconstructed. Sub-pel refinement and motion compensation then read
+     * half-pel positions directly instead of interpolating them for every
+     * candidate. Costs three luma planes per picture, so it is enabled by the
+     * presets which use subpelRefine of 3 and more. It is not used with
+     * bEnableCtuRefSync. Default disabled */
+    int       bEnableHpelCache;
+
+    /* Add the motion vectors which the lookahead estimated for the lowres
+     * blocks under each PU, scaled to full resolution, to the candidates of
+     * the full resolution motion search. Like all candidates they may seed
+     * the integer search, so large motion is found by the cheaper search
+     * methods. Default enabled */
+    int       bEnableLowresMvc;
+
+    /* Skip the subpel refinement of the references whose integer motion
+     * search cost, including the bits of signaling the reference, exceeds the
+     * best reference of the same list by more than an eighth. Subpel
+     * refinement is the most expensive part of the search of a reference, so
+     * this saves most of the cost of the references which will not be chosen.
+     * Default disabled, enabled by the fast preset */
+    int       bEnableRefEarlyExit;
+
     /* The maximum distance from the motion prediction that the full pel motion
      * search is allowed to progress before terminating. This value can have an
      * effect on frame parallelism, as referenced frames must be at least this
@@ -521,6 +664,20 @@ typedef struct x265_param
      * smaller CU size is used, the search range should be similarly reduced */
     int       searchRange;
 
+    /* Bound the motion searched in each CTU by the motion which the lookahead
+     * estimated for its lowres blocks, scaled to the distance of the farthest
+     * reference, plus a margin. The window around each MVP is widened by the
+     * MVP's own length so it always reaches that motion, and never exceeds
+     * searchRange. Static areas are searched much faster, the exhaustive
+     * search about twice as fast on a static 352x288 clip with an identical
+     * bitstream. Motion the lookahead did not find may be missed: on a moving
+     * 352x288 clip the bitrate changed by -0.6% to +0.9% and PSNR by -0.03 to
+     * +0.03 dB. The largest range of the CTUs of a frame bounds the reference
+     * lag of frame parallelism, but a single fast moving CTU keeps it at
+     * searchRange, so frames rarely start earlier in practice. Frames without
+     * lookahead motion use searchRange. Default disabled */
+    int       bEnableAdaptiveMeRange;
+
     /* The maximum number of merge candidates that are considered during inter
      * analysis.  This number (between 1 and 5) is signaled in the stream
      * headers and determines the number of bits required to signal a merge so
@@ -692,6 +849,13 @@ typedef struct x265_param
          * interpreted as the initial fill in kbits. Default is 0.9 */
         double    vbvBufferInit;
 
+        /* Sets how full the VBV buffer should be after the last frame, so the
+         * stream can be followed by another stream (a chunk of a parallel
+         * encode) which starts with vbvBufferInit. Interpreted like
+         * vbvBufferInit. The final frames are planned to reach it, which
+         * requires totalFrames and the lookahead. Default is 0, disabled */
+        double    vbvBufferEnd;
+
         /* Enable CUTree ratecontrol. This keeps track of the CUs that propagate temporally
          * across frames and assigns more bits to these CUs. Improves encode efficiency.
          * Default: enabled */
@@ -889,6 +1053,18 @@ void x265_picture_free(x265_picture *);
  */
 void x265_picture_init(x265_param *param, x265_picture *pic);
 
+/* x265_picture_alloc_planes:
+ *  Allocates a zero-copy input buffer with the padded and aligned layout of the
+ *  encoder's internal source pictures, and sets the planes, stride, bitDepth,
+ *  colorSpace and planesBuffer fields of pic. Pixels must be written at the
+ *  encoder's internal bit depth. Returns 0 on success, negative on failure */
+int x265_picture_alloc_planes(x265_encoder *encoder, x265_picture *pic);
+
+/* x265_picture_free_planes:
+ *  Frees a buffer allocated by x265_picture_alloc_planes() which is not owned
+ *  by an encoder */
+void x265_picture_free_planes(void *planesBuffer);
+
 /* x265_max_bit_depth:
  *      Specifies the maximum number of bits per pixel that x265 can input. This
  *      is also the max bit depth that x265 encodes in.  When x265_max_bit_depth
@@ -917,6 +1093,19 @@ X265_API extern const char *x265_build_info_str;
  *      create a new encoder handler, all parameters from x265_param_t are copied */
 x265_encoder* x265_encoder_open(x265_param *);
 
+/* x265_thread_pool_alloc:
+ *      create a thread pool with numThreads worker threads (0 implies one per
+ *      CPU core) split into numNodes NUMA worker groups, see numaPools. Any
+ *      number of encoders may be opened with the pool in x265_param.threadPool,
+ *      they share its worker threads according to their x265_param.poolWeight.
+ *      returns NULL if the worker threads could not be started */
+x265_thread_pool* x265_thread_pool_alloc(int numThreads, int numNodes);
+
+/* x265_thread_pool_free:
+ *      release the caller's reference to the thread pool. The pool is
+ *      destroyed once the encoders which use it are closed as well */
+void x265_thread_pool_free(x265_thread_pool *);
+
 /* x265_encoder_headers:
  *      return the SPS and PPS that will be used for the whole stream.
  *      *pi_nal is the number of NAL units outputted in pp_nal.
@@ -931,6 +1120,32 @@ int x265_encoder_headers(x265_encoder *, x265_nal **pp_nal, uint32_t *pi_nal);
  *      the payloads of all output NALs are guaranteed to be sequential in memory. */
 int x265_encoder_encode(x265_encoder *encoder, x265_nal **pp_nal, uint32_t *pi_nal, x265_picture *pic_in, x265_picture *pic_out);
 
+/* x265_encoder_reconfig:
+ *      change the parameters of an open encoder, without an IDR or any
+ *      reallocation. Only these fields of param are used, all others are
+ *      ignored: rc.bitrate, rc.rfConstant, rc.vbvMaxBitrate, rc.vbvBufferSize,
+ *      searchMethod, subpelRefine and rdLevel. The rate control mode cannot be
+ *      changed and VBV cannot be enabled or disabled. The changes apply from
+ *      the next picture which x265_encoder_encode() hands to a frame encoder,
+ *      pictures already being encoded keep their settings. The HRD parameters
+ *      of the SPS are not updated. Must be called from the thread which calls
+ *      x265_encoder_encode(). returns 0 on success, negative if the new
+ *      parameters are invalid, in which case none of them are applied. */
+int x265_encoder_reconfig(x265_encoder *, x265_param *);
+
+/* x265_encoder_output_ring:
+ *      register a caller owned buffer into which the NAL units returned by later
+ *      x265_encoder_headers() and x265_encoder_encode() calls are written, start
+ *      codes and emulation prevention bytes included, so their payloads point
+ *      into this buffer and no further copy is made by the encoder. The NAL
+ *      units of each call follow those of the previous call, wrapping to the
+ *      start of the buffer when the remaining space is less than the worst case
+ *      size of the call's NAL units (1.5 times their RBSP size, plus headers).
+ *      Payloads therefore stay valid until the buffer wraps around over them.
+ *      Calls whose NAL units cannot fit in the whole buffer are written to the
+ *      encoder's internal buffer, as is all output when buffer is NULL. */
+void x265_encoder_output_ring(x265_encoder *encoder, uint8_t *buffer, uint32_t sizeBytes);
+
 /* x265_encoder_get_stats:
  *       returns encoder statistics */
 void x265_encoder_get_stats(x265_encoder *encoder, x265_stats *, uint32_t statsSizeBytes);